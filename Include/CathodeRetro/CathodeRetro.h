@@ -1,12 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <vector>
 
 #include "CathodeRetro/Internal/RGBToCRT.h"
 #include "CathodeRetro/Internal/SignalDecoder.h"
 #include "CathodeRetro/Internal/SignalGenerator.h"
+#include "CathodeRetro/Internal/StaticFrameDetector.h"
 #include "CathodeRetro/GraphicsDevice.h"
+#include "CathodeRetro/ScreenTextureCache.h"
 #include "CathodeRetro/Settings.h"
+#include "CathodeRetro/TransientTargetPool.h"
 
 
 namespace CathodeRetro
@@ -15,14 +21,35 @@ namespace CathodeRetro
   class CathodeRetro
   {
   public:
+    // sharedTransientPool is an optional pool (which must be using the same graphics device) to get the intermediate
+    //  textures from, so that multiple instances can share them. If it is null, this instance gets a pool of its own.
+    // sharedScreenTextureCache is likewise an optional cache to keep the generated screen textures in (which can also
+    //  persist them to disk, see ScreenTextureCache.h). If it is null, this instance gets a cache of its own. The CRT
+    //  mask textures are always shared between every instance that uses the same graphics device.
     CathodeRetro(
       IGraphicsDevice *graphicsDevice,
       SignalType sigType,
       uint32_t inputWidth,
       uint32_t inputHeight,
-      const SourceSettings &sourceSettings)
+      const SourceSettings &sourceSettings,
+      TransientTargetPool *sharedTransientPool = nullptr,
+      ScreenTextureCache *sharedScreenTextureCache = nullptr)
       : device(graphicsDevice)
+      , transientPool(sharedTransientPool)
+      , screenTextureCache(sharedScreenTextureCache)
     {
+      if (transientPool == nullptr)
+      {
+        ownedTransientPool = std::make_unique<TransientTargetPool>(device);
+        transientPool = ownedTransientPool.get();
+      }
+
+      if (screenTextureCache == nullptr)
+      {
+        ownedScreenTextureCache = std::make_unique<ScreenTextureCache>(device);
+        screenTextureCache = ownedScreenTextureCache.get();
+      }
+
       UpdateSourceSettings(sigType, inputWidth, inputHeight, sourceSettings);
     }
 
@@ -47,6 +74,7 @@ namespace CathodeRetro
 
       signalType = sigType;
       cachedSourceSettings = sourceSettings;
+      staticFrameDetector.Reset();
       inWidth = inputWidth;
       inHeight = inputHeight;
 
@@ -59,7 +87,8 @@ namespace CathodeRetro
           inputWidth,
           inputWidth,
           inputHeight,
-          sourceSettings.inputPixelAspectRatio);
+          sourceSettings.inputPixelAspectRatio,
+          screenTextureCache);
       }
       else
       {
@@ -70,16 +99,24 @@ namespace CathodeRetro
           inputHeight,
           sourceSettings);
         signalGenerator->SetArtifactSettings(cachedArtifactSettings);
+        signalGenerator->SetSignalPrecision(signalPrecision);
+        if (!cachedPalette.empty())
+        {
+          signalGenerator->SetPalette(cachedPalette.data(), uint32_t(cachedPalette.size() / 4));
+        }
 
         signalDecoder = std::make_unique<SignalDecoder>(device, signalGenerator->SignalProperties());
         signalDecoder->SetKnobSettings(cachedKnobSettings);
+        signalDecoder->SetSignalPrecision(signalPrecision);
+        signalDecoder->SetChromaResolution(chromaResolution);
 
         rgbToCRT = std::make_unique<RGBToCRT>(
           device,
           inputWidth,
           signalDecoder->OutputTextureWidth(),
           inputHeight,
-          signalGenerator->SignalProperties().inputPixelAspectRatio);
+          signalGenerator->SignalProperties().inputPixelAspectRatio,
+          screenTextureCache);
       }
 
       if (outWidth != 0 && outHeight != 0)
@@ -88,10 +125,13 @@ namespace CathodeRetro
       }
 
       rgbToCRT->SetSettings(cachedOverscanSettings, cachedScreenSettings);
+      rgbToCRT->SetUseDistortionTexture(useDistortionTexture);
     }
 
 
-    // Call this to change any other settings. No reallocations or texture re-creations are necessary here.
+    // Call this to change any other settings. Nothing gets reallocated here: every texture whose size or format
+    //  depends on these settings comes from the transient pool at render time, which recycles render targets by size
+    //  and format (so, for instance, toggling temporal artifact reduction just swaps between two sets of targets).
     void UpdateSettings(
       const ArtifactSettings &artifactSettings,
       const TVKnobSettings &knobSettings,
@@ -122,8 +162,8 @@ namespace CathodeRetro
     }
 
 
-    // Call this to change the output size (i.e. the size of the texture we'll be rendering to). This will reallocate
-    //  any screen-sized textures that might exist.
+    // Call this to change the output size (i.e. the size of the texture we'll be rendering to). The screen texture for
+    //  the new size gets created (or found in the screen texture cache) at the next render.
     void SetOutputSize(uint32_t outputWidth, uint32_t outputHeight)
     {
       assert(outputWidth > 0 && outputHeight > 0);
@@ -143,35 +183,368 @@ namespace CathodeRetro
     }
 
 
-    // Call this to actually render
+    // Call this to change the storage precision of the generated signal and the intermediate decode textures (the RGB
+    //  textures are always RGBA_Unorm8 regardless). SignalPrecision::Float16 halves the memory use and bandwidth of
+    //  those textures at a small cost in quality. It's Float32 by default. Like UpdateSettings, this doesn't create
+    //  anything itself: the textures in the new format come from the transient pool at the next render.
+    void SetSignalPrecision(SignalPrecision precision)
+    {
+      signalPrecision = precision;
+      if (signalGenerator != nullptr)
+      {
+        signalGenerator->SetSignalPrecision(precision);
+        signalDecoder->SetSignalPrecision(precision);
+      }
+    }
+
+
+    // Call this to change how finely the decoder filters the chroma out of an S-Video or composite signal (this has no
+    //  effect on RGB input). ChromaResolution::Decimated decodes the chroma once per color cycle and interpolates it in
+    //  between, which skips most of the chroma filtering work and one full-resolution intermediate texture, for a very
+    //  small difference in the output. It's Full by default, and like SetSignalPrecision it takes effect at the next
+    //  render.
+    void SetChromaResolution(ChromaResolution resolution)
+    {
+      chromaResolution = resolution;
+      if (signalDecoder != nullptr)
+      {
+        signalDecoder->SetChromaResolution(resolution);
+      }
+    }
+
+
+    // Call this to bake the screen distortion into a texture (regenerated only when the output size or the screen
+    //  settings change) rather than calculating it for every pixel of every frame. This saves a lot of math per pixel
+    //  at the cost of a float texture read (and the texture's memory), so whether it's a win depends on the device -
+    //  it generally is for CPUGraphicsDevice. It only does anything if the screen is distorted, and only on devices
+    //  whose IGraphicsDevice::SupportsShaderPermutations returns true. It's off by default.
+    void SetUseDistortionTexture(bool use)
+    {
+      useDistortionTexture = use;
+      if (rgbToCRT != nullptr)
+      {
+        rgbToCRT->SetUseDistortionTexture(use);
+      }
+    }
+
+
+    // Call this to switch to palette-indexed input (or, with a colorCount of 0, back to RGB input). The input texture
+    //  given to Render is then an R_Unorm8 texture of indices into this palette of colorCount (at most 256)
+    //  RGBA_Unorm8 colors (with the alpha ignored), a quarter of the size of the equivalent RGBA input. Since every
+    //  input texel is one of at most 256 colors, the signal for each color gets generated once (at the start of the
+    //  next Render, for every phase that the signal can have) rather than converting every texel from RGB every
+    //  frame. This is the natural input for emulators of consoles that have a fixed palette. Any index of colorCount or
+    //  more uses the last color of the palette.
+    // Indices can't be blended, so the input is point sampled instead of bilinearly filtered the way RGB input is,
+    //  which makes the signal very slightly different (the signal is sampled at a higher resolution than the input,
+    //  so RGB input blends neighboring pixels together at their edges). The palette is kept across any
+    //  UpdateSourceSettings calls. This can only be used with a Composite or SVideo signal type, and it can create
+    //  textures, so it can't be called in the middle of rendering.
+    void SetPalette(const uint8_t *rgbaColors, uint32_t colorCount)
+    {
+      assert(colorCount <= 256);
+      cachedPalette.assign(rgbaColors, rgbaColors + size_t(colorCount) * 4);
+      if (signalGenerator != nullptr)
+      {
+        signalGenerator->SetPalette(rgbaColors, colorCount);
+      }
+      else
+      {
+        assert(colorCount == 0); // RGB input has no signal to generate, so it can't be palette-indexed.
+      }
+    }
+
+
+    // Counters for static frame detection (see SetStaticFrameDetection).
+    struct StaticFrameStats
+    {
+      uint64_t checkedFrameCount = 0;     // Frames whose input was fingerprinted.
+      uint64_t reusedFrameCount = 0;      // How many of those reused an earlier frame's decoded output.
+      uint64_t changedScanlineCount = 0;  // Total input scanlines (over every checked frame) that had changed.
+    };
+
+
+    // The default number of decoded frames that static frame detection keeps (see SetStaticFrameDetection).
+    static constexpr uint32_t k_defaultDecodedFrameCacheSize = 4;
+
+
+    // Call this to turn static frame detection on or off (it's off by default). While it's on, any frame whose input
+    //  texels are given to Render is fingerprinted (with a hash per scanline), and the last decodedFrameCacheSize
+    //  decoded frames (at least 2) are kept, along with the fingerprint and everything else that the generated signal
+    //  depended on (the phase of the frame, and of the previous frame if temporal artifact reduction is on, plus the
+    //  artifact and knob settings, signal precision and chroma resolution). If a frame matches one of them exactly,
+    //  the signal generation and decoding are skipped entirely and that frame's decoded output is used again. This is
+    //  for things like emulator menus and pause screens, which hand over the same picture frame after frame. Only the
+    //  screen emulation still runs, and the results are identical to running everything.
+    // Sources whose phase changes from frame to frame (like the NES/SNES presets) cycle through a handful of phases
+    //  (at most the source's denominator), so a static picture decodes to the same few frames over and over, and the
+    //  cache just needs to be big enough to hold all of them for the phase flicker to come out of the cache too. A
+    //  frame can never be reused if there is noise or instability, since those are different every frame. Each kept
+    //  frame costs an RGBA_Unorm8 texture of the decoded size, plus a copy of its input texels in CPU memory (a frame
+    //  is only reused when its input is byte-for-byte the same, not just when the hashes match). This does nothing
+    //  for RGB input, which has no signal to skip.
+    void SetStaticFrameDetection(bool enable, uint32_t decodedFrameCacheSize = k_defaultDecodedFrameCacheSize)
+    {
+      useStaticFrameDetection = enable;
+      cachedDecodedFrameCount = std::max(decodedFrameCacheSize, 2U);
+      staticFrameDetector.Reset();
+    }
+
+
+    const StaticFrameStats &StaticFrameDetectionStats() const
+      { return staticFrameStats; }
+
+
+    void ResetStaticFrameDetectionStats()
+      { staticFrameStats = {}; }
+
+
+    // Call this to actually render. inputTexels is optional: it's the texels that currentFrameInputRGB was filled with
+    //  (rows inputRowPitch bytes apart, in the texture's format), which static frame detection fingerprints. If it's
+    //  null, the frame is rendered in full.
     void Render(
       const ITexture *currentFrameInputRGB,
       ScanlineType scanlineType,
-      IRenderTarget *output)
+      IRenderTarget *output,
+      const void *inputTexels = nullptr,
+      size_t inputRowPitch = 0)
+    {
+      BatchStream stream = { this, currentFrameInputRGB, scanlineType, output, inputTexels, inputRowPitch };
+      RenderBatch(&stream, 1);
+    }
+
+
+    // One stream of a RenderBatch call: the instance to render it with, along with what would be passed to its Render.
+    struct BatchStream
+    {
+      CathodeRetro *instance;
+      const ITexture *currentFrameInputRGB;
+      ScanlineType scanlineType;
+      IRenderTarget *output;
+      const void *inputTexels = nullptr;
+      size_t inputRowPitch = 0;
+    };
+
+
+    // Render a frame for each of a set of (distinct) instances, which must all use the same graphics device, in a
+    //  single BeginRendering/EndRendering pair. Every stream's intermediate textures are planned together (per
+    //  transient pool, as separate streams), so no two streams share an intermediate within the batch and a device
+    //  that defers its work (like CPUGraphicsDevice, which interleaves every stream's passes across its worker
+    //  threads) is free to run the streams at the same time. Instances that share a screen texture cache and have the
+    //  same screen settings and output size also share a single screen texture. The results are the same as calling
+    //  Render on each instance in turn.
+    static void RenderBatch(const BatchStream *streams, uint32_t streamCount)
     {
+      assert(streamCount > 0);
+      IGraphicsDevice *device = streams[0].instance->device;
+
+      // Whether stream i is the first one in the batch that uses the given pool/cache (so that each gets its
+      //  once-per-frame work done once).
+      auto isFirstUser = [&](uint32_t i, auto member)
+      {
+        for (uint32_t j = 0; j < i; j++)
+        {
+          assert(streams[j].instance != streams[i].instance);
+          if (streams[j].instance->*member == streams[i].instance->*member)
+          {
+            return false;
+          }
+        }
+
+        return true;
+      };
+
+      // Work out which intermediate textures the frame needs (and for how long) before rendering starts, since getting
+      //  them can mean creating new render targets (which depends on whether the frame can skip the signal entirely).
+      for (uint32_t i = 0; i < streamCount; i++)
+      {
+        assert(streams[i].instance->device == device);
+        streams[i].instance->DetectStaticFrame(
+          streams[i].currentFrameInputRGB,
+          streams[i].inputTexels,
+          streams[i].inputRowPitch);
+
+        if (isFirstUser(i, &CathodeRetro::transientPool))
+        {
+          streams[i].instance->transientPool->BeginPlan();
+        }
+        else
+        {
+          streams[i].instance->transientPool->BeginStream();
+        }
+
+        streams[i].instance->PlanTransients();
+      }
+
+      for (uint32_t i = 0; i < streamCount; i++)
+      {
+        CathodeRetro *instance = streams[i].instance;
+        if (isFirstUser(i, &CathodeRetro::transientPool))
+        {
+          instance->transientPool->EndPlan();
+          if (instance->ownedTransientPool != nullptr)
+          {
+            // Nobody else is using this pool, so anything that hasn't been needed for a while can go.
+            instance->transientPool->ReleaseUnused(k_ownedPoolKeepUnusedFrameCount);
+          }
+        }
+      }
+
+      // Save anything that the previous frame generated (if a cache persists textures) and then get this frame's
+      //  screen textures, both of which need to happen outside of rendering.
+      for (uint32_t i = 0; i < streamCount; i++)
+      {
+        if (isFirstUser(i, &CathodeRetro::screenTextureCache))
+        {
+          streams[i].instance->screenTextureCache->SavePending();
+        }
+      }
+
+      for (uint32_t i = 0; i < streamCount; i++)
+      {
+        streams[i].instance->rgbToCRT->PrepareScreenTexture();
+      }
+
       device->BeginRendering();
+      for (uint32_t i = 0; i < streamCount; i++)
+      {
+        streams[i].instance->RenderFrame(streams[i].currentFrameInputRGB, streams[i].scanlineType, streams[i].output);
+      }
+
+      device->EndRendering();
+    }
+
+  private:
+    // How many frames a render target in an instance's own transient pool can go unused before it's destroyed.
+    static constexpr uint32_t k_ownedPoolKeepUnusedFrameCount = 60;
 
-      if (signalType != SignalType::RGB)
+
+    // Everything that a frame's decoded output depends on (including which part of it got decoded), which the decoder
+    //  keeps with each decoded frame so that a later frame with exactly the same key can reuse its output. The input
+    //  texels themselves follow this in the key that the decoder gets (see DetectStaticFrame), so a frame whose input
+    //  only hashes the same as a kept frame's can never reuse it: the hash just makes a mismatch quick to find.
+    struct DecodedFrameKey
+    {
+      uint64_t inputHash;
+      Internal::SignalGenerator::FrameKey signal;
+      TVKnobSettings knobSettings;
+      SignalPrecision signalPrecision;
+      ChromaResolution chromaResolution;
+      TexelRect region;
+    };
+
+
+    // Work out whether this frame can reuse an earlier frame's decoded output (see SetStaticFrameDetection).
+    void DetectStaticFrame(const ITexture *currentFrameInputRGB, const void *inputTexels, size_t inputRowPitch)
+    {
+      reuseDecodedFrame = false;
+      hasDecodedFrameKey = false;
+      if (!useStaticFrameDetection || signalType == SignalType::RGB || inputTexels == nullptr)
+      {
+        return;
+      }
+
+      uint32_t changedScanlineCount;
+      DecodedFrameKey key = {};
+      key.inputHash = staticFrameDetector.Update(
+        inputTexels,
+        inputRowPitch,
+        size_t(currentFrameInputRGB->Width()) * TexelByteCount(currentFrameInputRGB->Format()),
+        currentFrameInputRGB->Height(),
+        &changedScanlineCount);
+      key.signal = signalGenerator->NextFrameKey();
+      key.knobSettings = cachedKnobSettings;
+      key.signalPrecision = signalPrecision;
+      key.chromaResolution = chromaResolution;
+      key.region = rgbToCRT->InputRegion();
+
+      decodedFrameKey.resize(sizeof(key) + staticFrameDetector.FrameByteCount());
+      memcpy(decodedFrameKey.data(), &key, sizeof(key));
+      memcpy(
+        decodedFrameKey.data() + sizeof(key),
+        staticFrameDetector.FrameBytes(),
+        staticFrameDetector.FrameByteCount());
+      hasDecodedFrameKey = true;
+
+      staticFrameStats.checkedFrameCount++;
+      staticFrameStats.changedScanlineCount += changedScanlineCount;
+      if (signalDecoder->FindFrame(decodedFrameKey.data(), decodedFrameKey.size()))
+      {
+        reuseDecodedFrame = true;
+        staticFrameStats.reusedFrameCount++;
+      }
+    }
+
+
+    // Request this frame's intermediate textures from the transient pool (which must be planning).
+    void PlanTransients()
+    {
+      // The decoder keeps the previous frame's output around for us if it's needed (along with any older ones that
+      //  might get reused), otherwise (with RGB input) RGBToCRT has to keep a copy of its own.
+      if (signalType != SignalType::RGB && !reuseDecodedFrame)
+      {
+        uint32_t historyFrameCount = rgbToCRT->NeedsPreviousFrame() ? 2 : 0;
+        if (useStaticFrameDetection)
+        {
+          historyFrameCount = cachedDecodedFrameCount;
+        }
+
+        // Only the part of the decoded output that the screen can show (see RGBToCRT::InputRegion) needs decoding, and
+        //  only the part of the signal that that decodes from needs generating, so the decoder has to plan first.
+        signalDecoder->SetOutputRegion(rgbToCRT->InputRegion());
+        signalDecoder->PlanTransients(
+          transientPool,
+          historyFrameCount,
+          cachedArtifactSettings.temporalArtifactReduction > 0.0f);
+        signalGenerator->SetOutputRegion(signalDecoder->InputRegion());
+        signalGenerator->PlanTransients(transientPool);
+      }
+
+      rgbToCRT->PlanTransients(transientPool, signalType == SignalType::RGB);
+    }
+
+
+    // Issue this frame's passes (between the device's BeginRendering and EndRendering).
+    void RenderFrame(
+      const ITexture *currentFrameInputRGB,
+      ScanlineType scanlineType,
+      IRenderTarget *output)
+    {
+      const ITexture *previousFrameInputRGB = nullptr;
+      if (signalType != SignalType::RGB && reuseDecodedFrame)
+      {
+        signalGenerator->SkipFrame();
+        signalDecoder->ReuseFrame();
+        currentFrameInputRGB = signalDecoder->CurrentFrameRGBOutput();
+        previousFrameInputRGB = signalDecoder->PreviousFrameRGBOutput();
+      }
+      else if (signalType != SignalType::RGB)
       {
         signalGenerator->Generate(currentFrameInputRGB);
         signalDecoder->Decode(
           signalGenerator->SignalTexture(),
           signalGenerator->PhasesTexture(),
-          signalGenerator->SignalLevels());
+          signalGenerator->SignalLevels(),
+          hasDecodedFrameKey ? decodedFrameKey.data() : nullptr,
+          hasDecodedFrameKey ? decodedFrameKey.size() : 0);
 
         currentFrameInputRGB = signalDecoder->CurrentFrameRGBOutput();
+        previousFrameInputRGB = signalDecoder->PreviousFrameRGBOutput();
       }
 
       rgbToCRT->Render(
         currentFrameInputRGB,
+        previousFrameInputRGB,
         output,
         scanlineType);
-
-      device->EndRendering();
     }
 
-  private:
+
     IGraphicsDevice *device;
+    TransientTargetPool *transientPool;
+    std::unique_ptr<TransientTargetPool> ownedTransientPool;
+    ScreenTextureCache *screenTextureCache;
+    std::unique_ptr<ScreenTextureCache> ownedScreenTextureCache;
     SignalType signalType;
     SourceSettings cachedSourceSettings;
     ArtifactSettings cachedArtifactSettings;
@@ -183,6 +556,18 @@ namespace CathodeRetro
     uint32_t inHeight = 0;
     uint32_t outWidth = 0;
     uint32_t outHeight = 0;
+    bool useDistortionTexture = false;
+    SignalPrecision signalPrecision = SignalPrecision::Float32;
+    ChromaResolution chromaResolution = ChromaResolution::Full;
+    std::vector<uint8_t> cachedPalette;
+
+    bool useStaticFrameDetection = false;
+    uint32_t cachedDecodedFrameCount = k_defaultDecodedFrameCacheSize;
+    bool reuseDecodedFrame = false;
+    bool hasDecodedFrameKey = false;
+    std::vector<uint8_t> decodedFrameKey;
+    Internal::StaticFrameDetector staticFrameDetector;
+    StaticFrameStats staticFrameStats;
 
     std::unique_ptr<Internal::SignalGenerator> signalGenerator;
     std::unique_ptr<Internal::SignalDecoder> signalDecoder;
@@ -3,6 +3,7 @@
 // Note that most of these things use D3D terminology, since that's my standard reference frame.
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
 namespace CathodeRetro
@@ -30,7 +31,8 @@ namespace CathodeRetro
 
 
   // Cathode Retro has shaders with these identifiers, it can ask for shaders with these IDs, and it is up to the
-  //  graphics device to define how these IDs get translated into the actual loaded shader.
+  //  graphics device to define how these IDs get translated into the actual loaded shader. Shaders added since the
+  //  first release are appended after CRT_RGBToCRT, so that the values of the existing IDs never change.
   enum class ShaderID
   {
     Util_Copy,                                      // cathode-retro-util-copy.hlsl
@@ -52,21 +54,124 @@ namespace CathodeRetro
     CRT_GenerateShadowMask,                         // cathode-retro-crt-generate-shadow-mask.hlsl
     CRT_GenerateApertureGrille,                     // cathode-retro-crt-generate-aperture-grille.hlsl
     CRT_RGBToCRT,                                   // cathode-retro-crt-rgb-to-crt.hlsl
+
+    CRT_GenerateDistortionTexture,                  // cathode-retro-crt-generate-distortion-texture.hlsl
+
+    Generator_IndexedToSVideoOrComposite,           // cathode-retro-generator-indexed-to-svideo-or-composite.hlsl
+    Generator_GeneratePaletteSignalTable,           // cathode-retro-generator-gen-palette-signal-table.hlsl
+
+    Decoder_SVideoToDecimatedIQ,                    // cathode-retro-decoder-svideo-to-decimated-iq.hlsl
+    Decoder_SVideoAndDecimatedIQToRGB,              // cathode-retro-decoder-svideo-and-decimated-iq-to-rgb.hlsl
+  };
+
+
+  // The features of the CRT_RGBToCRT shader that can be compiled out of it. A permutation of that shader is a set of
+  //  these (OR'd together), and is the shader compiled with the matching CRT_NO_* define for every feature that is NOT
+  //  in the set (see cathode-retro-crt-rgb-to-crt.hlsl). Cathode Retro only leaves out features whose settings are
+  //  0, so every permutation renders the same thing that the full shader would, just with less work.
+  // DistortionTexture is the exception: it is compiled in (CRT_DISTORTION_TEXTURE) when it IS in the set, and means
+  //  that the distorted coordinates get read out of a fifth input texture (rendered by CRT_GenerateDistortionTexture)
+  //  rather than being calculated. That's also the same result as the full shader.
+  enum class RGBToCRTFeature : uint32_t
+  {
+    Distortion = 0x01,                              // CRT_NO_DISTORTION
+    PhosphorPersistence = 0x02,                     // CRT_NO_PHOSPHOR_PERSISTENCE
+    Diffusion = 0x04,                               // CRT_NO_DIFFUSION
+    Mask = 0x08,                                    // CRT_NO_MASK
+    Scanlines = 0x10,                               // CRT_NO_SCANLINES
+    DistortionTexture = 0x20,                       // CRT_DISTORTION_TEXTURE
   };
 
+  static constexpr uint32_t k_rgbToCRTPermutationCount = 0x40;
+
+  // The full shader: every feature, with the distortion calculated in the shader.
+  static constexpr uint32_t k_rgbToCRTAllFeatures = 0x1f;
+
+
+  // The logical stages of the Cathode Retro pipeline, each of which is one or more RenderQuad calls. Cathode Retro
+  //  brackets every stage with IGraphicsDevice::BeginStage/EndStage so that a device can time them (see
+  //  StageTimings.h for a way to collect those timings).
+  // These are listed in the order that they run within a frame, which TransientTargetPool relies on to describe how
+  //  long each intermediate texture stays alive.
+  enum class StageID
+  {
+    GeneratePhasesTexture,
+    GenerateCleanSignal,
+    ApplyArtifacts,
+    CompositeToSVideo,
+    SVideoToRGB,                                    // Both the chroma demodulation and the RGB conversion passes.
+    FilterRGB,
+    RenderMaskTexture,
+    RenderScreenTexture,
+    RenderDistortionTexture,
+    RenderBlur,
+    RGBToCRT,
+    CopyPreviousFrame,                              // Saving RGB input for the next frame (phosphor persistence).
+
+    Count,
+  };
+
+
+  inline const char *StageName(StageID stage)
+  {
+    switch (stage)
+    {
+      case StageID::GeneratePhasesTexture: return "GeneratePhasesTexture";
+      case StageID::GenerateCleanSignal: return "GenerateCleanSignal";
+      case StageID::ApplyArtifacts: return "ApplyArtifacts";
+      case StageID::CompositeToSVideo: return "CompositeToSVideo";
+      case StageID::SVideoToRGB: return "SVideoToRGB";
+      case StageID::FilterRGB: return "FilterRGB";
+      case StageID::RenderMaskTexture: return "RenderMaskTexture";
+      case StageID::RenderScreenTexture: return "RenderScreenTexture";
+      case StageID::RenderDistortionTexture: return "RenderDistortionTexture";
+      case StageID::RenderBlur: return "RenderBlur";
+      case StageID::RGBToCRT: return "RGBToCRT";
+      case StageID::CopyPreviousFrame: return "CopyPreviousFrame";
+      case StageID::Count: break;
+    }
+
+    return "Unknown";
+  }
+
 
   // Cathode Retro uses standard RGBA_Unorm8 textures (the component ordering doesn't matter so if an API/platform
   //  needs it to be BGRA or the like, that is totally fine), as well as 1- 2- and 4-component float textures (for the
-  //  generated signal data)
+  //  generated signal data). The 16-bit float formats are only used if CathodeRetro::SetSignalPrecision asks for them.
+  //  R_Unorm8 is only used for palette-indexed input (see CathodeRetro::SetPalette), which Cathode Retro never renders
+  //  to.
   enum class TextureFormat
   {
     RGBA_Unorm8,
     R_Float32,
     RG_Float32,
     RGBA_Float32,
+    R_Float16,
+    RG_Float16,
+    RGBA_Float16,
+    R_Unorm8,
   };
 
 
+  // The size, in bytes, of a single texel of the given format.
+  inline uint32_t TexelByteCount(TextureFormat format)
+  {
+    switch (format)
+    {
+      case TextureFormat::RGBA_Unorm8: return 4;
+      case TextureFormat::R_Float32: return 4;
+      case TextureFormat::RG_Float32: return 8;
+      case TextureFormat::RGBA_Float32: return 16;
+      case TextureFormat::R_Float16: return 2;
+      case TextureFormat::RG_Float16: return 4;
+      case TextureFormat::RGBA_Float16: return 8;
+      case TextureFormat::R_Unorm8: return 1;
+    }
+
+    return 4;
+  }
+
+
   // This interface represents a wrapper around a texture, as you might have guessed. It exposes a few metrics for
   //  Cathode Retro to query.
   class ITexture
@@ -123,8 +228,28 @@ namespace CathodeRetro
   };
 
 
-  // This represents a view output of a shader. It has a texture and an optional target mipmap level. If no mipmap
-  //  level is specified, it will render to the largest mip level.
+  // A rectangle of texels: columns [left, right) of rows [top, bottom), where row 0 is the row at the top of the
+  //  texture (the one a shader sees at texture coordinate y = 0). The default rectangle covers any size of texture.
+  struct TexelRect
+  {
+    bool operator==(const TexelRect &other) const
+      { return left == other.left && top == other.top && right == other.right && bottom == other.bottom; }
+    bool operator!=(const TexelRect &other) const
+      { return !(*this == other); }
+
+    uint32_t left = 0;
+    uint32_t top = 0;
+    uint32_t right = ~0U;
+    uint32_t bottom = ~0U;
+  };
+
+
+  // This represents a view output of a shader. It has a texture, an optional target mipmap level, and an optional
+  //  region. If no mipmap level is specified, it will render to the largest mip level.
+  // The region is the only part of the output that anything will read afterwards (it's clamped to the size of the
+  //  mip level), so a device can skip rendering the rest of it (with a scissor rectangle, say), and what ends up in the
+  //  rest of the output doesn't matter. Rendering the whole output regardless is also fine. Cathode Retro uses this to
+  //  skip the parts of the signal that are hidden by overscan.
   struct RenderTargetView
   {
     RenderTargetView(IRenderTarget *tex, uint32_t mip = 0)
@@ -132,8 +257,15 @@ namespace CathodeRetro
       , mipLevel(int32_t(mip))
       { }
 
+    RenderTargetView(IRenderTarget *tex, const TexelRect &regionIn, uint32_t mip = 0)
+      : texture(tex)
+      , mipLevel(int32_t(mip))
+      , region(regionIn)
+      { }
+
     IRenderTarget *texture;
     uint32_t mipLevel = 0;
+    TexelRect region;
   };
 
 
@@ -168,9 +300,59 @@ namespace CathodeRetro
       std::initializer_list<ShaderResourceView> inputs,
       IConstantBuffer *constantBuffer = nullptr) = 0;
 
+    // Render a quad using a specific permutation of the given shader (currently only ShaderID::CRT_RGBToCRT has
+    //  permutations, and for it the permutation is a set of RGBToCRTFeature bits). This is optional: since every
+    //  permutation renders the same thing as the full shader, by default this just renders with the full shader.
+    virtual void RenderQuadPermutation(
+      ShaderID shaderID,
+      uint32_t permutation,
+      RenderTargetView output,
+      std::initializer_list<ShaderResourceView> inputs,
+      IConstantBuffer *constantBuffer = nullptr)
+    {
+      static_cast<void>(permutation);
+      RenderQuad(shaderID, output, inputs, constantBuffer);
+    }
+
+    // Whether RenderQuadPermutation actually renders the permutation it's given, rather than falling back to the full
+    //  shader like the default implementation does. Cathode Retro uses this to skip work that only a permutation can
+    //  make use of (like generating the distortion texture, see RGBToCRTFeature::DistortionTexture).
+    virtual bool SupportsShaderPermutations() const
+      { return false; }
+
     // This is called when Cathode Retro is done rendering, and is a good spot for render state to be restored back to
     //  whatever the enclosing app expects (i.e. if it's a game, the game probably has its own standard state setup).
     virtual void EndRendering() = 0;
+
+    // These are optional profiling markers: every stage of the pipeline is bracketed by a BeginStage/EndStage pair
+    //  (stages never nest, and only happen between BeginRendering and EndRendering). A device can turn these into
+    //  timestamps (GPU timestamp queries, CPU clock reads, debugger markers, etc.) - by default they do nothing.
+    virtual void BeginStage(StageID stage)
+      { static_cast<void>(stage); }
+
+    virtual void EndStage(StageID stage)
+      { static_cast<void>(stage); }
+
+    // These are optional, and only used by ScreenTextureCache (see ScreenTextureCache.h) to save generated textures to
+    //  disk and load them back in again: copy the texels of a single mip level of a render target out (or in), tightly
+    //  packed in the texture's format, returning false if that isn't possible. They are never called between
+    //  BeginRendering and EndRendering. By default they do nothing (and return false), in which case textures just
+    //  never get saved or loaded.
+    virtual bool ReadTexels(const IRenderTarget *texture, uint32_t mipLevel, void *texelsOut)
+    {
+      static_cast<void>(texture);
+      static_cast<void>(mipLevel);
+      static_cast<void>(texelsOut);
+      return false;
+    }
+
+    virtual bool WriteTexels(IRenderTarget *texture, uint32_t mipLevel, const void *texels)
+    {
+      static_cast<void>(texture);
+      static_cast<void>(mipLevel);
+      static_cast<void>(texels);
+      return false;
+    }
   };
 }
 
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+#include "CathodeRetro/Internal/ScopedStage.h"
+#include "CathodeRetro/Settings.h"
+
+
+namespace CathodeRetro
+{
+  namespace Internal
+  {
+    // MaskTextures holds the CRT mask textures (and their mip chains), which depend on nothing but the mask type. There
+    //  is a single instance per graphics device, shared by every RGBToCRT that renders with that device, so no matter
+    //  how many CathodeRetro instances there are, each type of mask is generated once and exists in memory once. The
+    //  instance (and with it every mask) goes away along with the last RGBToCRT using it.
+    class MaskTextures
+    {
+    public:
+      static constexpr uint32_t k_maskSize = 512;
+
+      // Get the instance for the given device, creating it if nothing is using one for that device yet.
+      static std::shared_ptr<MaskTextures> ForDevice(IGraphicsDevice *device)
+      {
+        static std::mutex mutex;
+        static std::vector<std::pair<IGraphicsDevice *, std::weak_ptr<MaskTextures>>> instances;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::shared_ptr<MaskTextures> result;
+        for (size_t i = 0; i < instances.size();)
+        {
+          std::shared_ptr<MaskTextures> instance = instances[i].second.lock();
+          if (instance == nullptr)
+          {
+            // Nobody is using this one anymore.
+            instances.erase(instances.begin() + ptrdiff_t(i));
+            continue;
+          }
+
+          if (instances[i].first == device)
+          {
+            result = std::move(instance);
+          }
+
+          i++;
+        }
+
+        if (result == nullptr)
+        {
+          result = std::make_shared<MaskTextures>(device);
+          instances.emplace_back(device, result);
+        }
+
+        return result;
+      }
+
+
+      explicit MaskTextures(IGraphicsDevice *deviceIn)
+        : device(deviceIn)
+      {
+        generateMaskConstantBuffer = device->CreateConstantBuffer(sizeof(Vec2));
+        maskDownsampleConstantBufferH = device->CreateConstantBuffer(sizeof(Vec2));
+        maskDownsampleConstantBufferV = device->CreateConstantBuffer(sizeof(Vec2));
+      }
+
+
+      MaskTextures(const MaskTextures &) = delete;
+      void operator=(const MaskTextures &) = delete;
+
+
+      // Make sure that the texture for the given mask type exists (along with the scratch texture needed to generate
+      //  its mips, if it hasn't been generated yet). This can create render targets, so it must be called before
+      //  rendering starts.
+      void Prepare(MaskType maskType)
+      {
+        Mask &mask = masks[uint32_t(maskType)];
+        if (mask.texture == nullptr)
+        {
+          mask.texture = device->CreateRenderTarget(k_maskSize, k_maskSize / 2, 0, TextureFormat::RGBA_Unorm8);
+        }
+
+        bool anyNeedGenerate = false;
+        for (const Mask &m : masks)
+        {
+          anyNeedGenerate = anyNeedGenerate || (m.texture != nullptr && !m.isGenerated);
+        }
+
+        if (!anyNeedGenerate)
+        {
+          halfWidthMaskTexture = nullptr;
+        }
+        else if (halfWidthMaskTexture == nullptr)
+        {
+          halfWidthMaskTexture = device->CreateRenderTarget(
+            k_maskSize / 2,
+            k_maskSize / 2,
+            0,
+            TextureFormat::RGBA_Unorm8);
+        }
+      }
+
+
+      // Get the texture for the given mask type (which must have been prepared), generating its contents first if no
+      //  one has needed them yet. This must be called during rendering.
+      const ITexture *Texture(MaskType maskType)
+      {
+        Mask &mask = masks[uint32_t(maskType)];
+        assert(mask.texture != nullptr);
+        if (!mask.isGenerated)
+        {
+          Generate(maskType, mask.texture.get());
+          mask.isGenerated = true;
+        }
+
+        return mask.texture.get();
+      }
+
+    private:
+      static constexpr uint32_t k_maskTypeCount = uint32_t(MaskType::ApertureGrille) + 1;
+
+      struct Mask
+      {
+        std::unique_ptr<IRenderTarget> texture;
+        bool isGenerated = false;
+      };
+
+
+      // Generate a mask texture for the CRT emulation
+      void Generate(MaskType maskType, IRenderTarget *maskTexture)
+      {
+        ScopedStage stage(device, StageID::RenderMaskTexture);
+
+        assert(halfWidthMaskTexture != nullptr);
+
+        ShaderID shader;
+        switch (maskType)
+        {
+        case MaskType::SlotMask:
+          shader = ShaderID::CRT_GenerateSlotMask;
+          break;
+
+        case MaskType::ShadowMask:
+          shader = ShaderID::CRT_GenerateShadowMask;
+          break;
+
+        case MaskType::ApertureGrille:
+        default:
+          shader = ShaderID::CRT_GenerateApertureGrille;
+          break;
+        }
+
+        // First step is the generate the texture at the largest mip level
+        generateMaskConstantBuffer->Update(Vec2{ float(k_maskSize), float(k_maskSize / 2) });
+        device->RenderQuad(
+          shader,
+          maskTexture,
+          {},
+          generateMaskConstantBuffer.get());
+
+        // Now it's generated so we need to generate the mips by using our lanczos downsample
+        maskDownsampleConstantBufferH->Update(Vec2{ 1.0f, 0.0f });
+        maskDownsampleConstantBufferV->Update(Vec2{ 0.0f, 1.0f });
+        for (uint32_t destMip = 1; destMip < maskTexture->MipCount(); destMip++)
+        {
+          device->RenderQuad(
+            ShaderID::Util_Downsample2X,
+            {halfWidthMaskTexture.get(), destMip - 1},
+            {{maskTexture, destMip - 1, SamplerType::LinearWrap}},
+            maskDownsampleConstantBufferH.get());
+
+          device->RenderQuad(
+            ShaderID::Util_Downsample2X,
+            {maskTexture, destMip},
+            {{halfWidthMaskTexture.get(), destMip - 1, SamplerType::LinearWrap}},
+            maskDownsampleConstantBufferV.get());
+        }
+      }
+
+
+      IGraphicsDevice *device;
+
+      std::unique_ptr<IConstantBuffer> generateMaskConstantBuffer;
+      std::unique_ptr<IConstantBuffer> maskDownsampleConstantBufferH;
+      std::unique_ptr<IConstantBuffer> maskDownsampleConstantBufferV;
+
+      Mask masks[k_maskTypeCount];
+
+      // Scratch space for generating the mips of a mask, only kept around while there's a mask left to generate.
+      std::unique_ptr<IRenderTarget> halfWidthMaskTexture;
+    };
+  }
+}
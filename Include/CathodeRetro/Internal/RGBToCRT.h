@@ -7,7 +7,11 @@
 #include <utility>
 
 #include "CathodeRetro/GraphicsDevice.h"
+#include "CathodeRetro/Internal/MaskTextures.h"
+#include "CathodeRetro/Internal/ScopedStage.h"
+#include "CathodeRetro/ScreenTextureCache.h"
 #include "CathodeRetro/Settings.h"
+#include "CathodeRetro/TransientTargetPool.h"
 
 
 namespace CathodeRetro
@@ -24,97 +28,286 @@ namespace CathodeRetro
         uint32_t originalInputImageWidthIn,
         uint32_t processedRGBTextureWidthIn,
         uint32_t scanlineCountIn,
-        float pixelAspectIn)
+        float pixelAspectIn,
+        ScreenTextureCache *screenTextureCacheIn)
       : device(deviceIn)
       , originalInputImageWidth(originalInputImageWidthIn)
       , processedRGBTextureWidth(processedRGBTextureWidthIn)
       , scanlineCount(scanlineCountIn)
       , pixelAspect(pixelAspectIn)
+      , screenTextureCache(screenTextureCacheIn)
+      , maskTextures(MaskTextures::ForDevice(deviceIn))
       {
         screenTextureConstantBuffer = device->CreateConstantBuffer(sizeof(ScreenTextureConstants));
+        distortionTextureConstantBuffer = device->CreateConstantBuffer(sizeof(CommonConstants));
         rgbToScreenConstantBuffer = device->CreateConstantBuffer(sizeof(RGBToScreenConstants));
         toneMapConstantBuffer = device->CreateConstantBuffer(sizeof(ToneMapConstants));
         blurDownsampleConstantBuffer = device->CreateConstantBuffer(sizeof(Vec2));
         gaussianBlurConstantBufferH = device->CreateConstantBuffer(sizeof(GaussianBlurConstants));
         gaussianBlurConstantBufferV = device->CreateConstantBuffer(sizeof(GaussianBlurConstants));
-        generateMaskConstantBuffer = device->CreateConstantBuffer(sizeof(Vec2));
-        maskDownsampleConstantBufferH = device->CreateConstantBuffer(sizeof(Vec2));
-        maskDownsampleConstantBufferV = device->CreateConstantBuffer(sizeof(Vec2));
 
-        prevRGBInput = device->CreateRenderTarget(
-          processedRGBTextureWidth,
-          scanlineCount,
-          1,
-          TextureFormat::RGBA_Unorm8);
-        maskTexture = device->CreateRenderTarget(k_maskSize, k_maskSize / 2, 0, TextureFormat::RGBA_Unorm8);
-        halfWidthMaskTexture = device->CreateRenderTarget(
-          k_maskSize / 2,
-          k_maskSize / 2,
-          0,
-          TextureFormat::RGBA_Unorm8);
-
-        needsRenderMaskTexture = true;
-        UpdateBlurTextures();
+        UpdateBlurTextureSizes();
+        rgbToCRTFeatures = CalculateRGBToCRTFeatures();
       }
 
+      ~RGBToCRT()
+        { ReturnPrevRGBInput(); }
+
+      RGBToCRT(const RGBToCRT &) = delete;
+      void operator=(const RGBToCRT &) = delete;
+
 
+      // Only the settings that a cached texture actually depends on cause it to be looked up (or rebuilt) again:
+      //  - overscan: the aspect ratio, which sizes the blur textures and shapes the screen texture.
+      //  - distortion, screenEdgeRounding, cornerRounding, maskType, maskScale: the screen texture (and, for maskType,
+      //    the mask texture that it's generated from).
+      //  - maskStrength, maskDepth, phosphorPersistence, scanlineStrength, diffusionStrength, borderColor: nothing,
+      //    these only go into the per-frame constants, so they can be changed every frame for free.
+      //  - distortion also goes into the distortion texture, if that's in use (see SetUseDistortionTexture).
+      // Additionally, any of distortion, phosphorPersistence, diffusionStrength, maskStrength, or scanlineStrength that
+      //  is 0 picks a permutation of the CRT shader that leaves that feature out entirely.
       void SetSettings(const OverscanSettings &overscan, const ScreenSettings &screen)
       {
-        if (screen != screenSettings || overscan != overscanSettings)
+        bool overscanChanged = (overscan != overscanSettings);
+        bool screenTextureChanged = overscanChanged
+          || screen.distortion.x != screenSettings.distortion.x
+          || screen.distortion.y != screenSettings.distortion.y
+          || screen.screenEdgeRounding.x != screenSettings.screenEdgeRounding.x
+          || screen.screenEdgeRounding.y != screenSettings.screenEdgeRounding.y
+          || screen.cornerRounding != screenSettings.cornerRounding
+          || screen.maskType != screenSettings.maskType
+          || screen.maskScale != screenSettings.maskScale;
+
+        overscanSettings = overscan;
+        screenSettings = screen;
+
+        if (overscanChanged)
         {
-          if (screen.maskType != screenSettings.maskType)
-          {
-            needsRenderMaskTexture = true;
-          }
+          UpdateBlurTextureSizes();
+        }
+
+        if (screenTextureChanged)
+        {
+          needsScreenTextureLookup = true;
+        }
+
+        rgbToCRTFeatures = CalculateRGBToCRTFeatures();
+      }
+
+
+      void SetOutputSize(uint32_t outputWidthIn, uint32_t outputHeightIn)
+      {
+        if (outputWidthIn != outputWidth || outputHeightIn != outputHeight)
+        {
+          outputWidth = outputWidthIn;
+          outputHeight = outputHeightIn;
+          needsScreenTextureLookup = true;
+        }
+      }
+
+
+      // Whether to bake the distorted texture coordinates that the CRT shader needs into a texture (which gets
+      //  regenerated, or found in the screen texture cache, whenever the output size or the settings that feed into it
+      //  change) and have the CRT shader read them out of that every frame, rather than calculating them per pixel.
+      //  Whether that's faster depends on the device: it saves a lot of math but costs a 4-component float texture
+      //  read (and the texture) at the output resolution. It only has an effect when there is distortion, and only on
+      //  devices whose IGraphicsDevice::SupportsShaderPermutations returns true (on any other device the full CRT
+      //  shader ignores the texture, so it isn't generated at all).
+      void SetUseDistortionTexture(bool use)
+      {
+        if (use != useDistortionTexture)
+        {
+          useDistortionTexture = use;
+          needsScreenTextureLookup = true;
+          rgbToCRTFeatures = CalculateRGBToCRTFeatures();
+        }
+      }
+
+
+      // Get the screen texture (and distortion texture, if it's in use) for the current settings and output size out
+      //  of the screen texture cache (and make sure the mask texture that the screen texture gets generated from
+      //  exists, if it needs to be generated). This can create render targets, so it needs to happen before rendering
+      //  starts.
+      void PrepareScreenTexture()
+      {
+        assert(outputWidth != 0 && outputHeight != 0);
+        if (!needsScreenTextureLookup)
+        {
+          return;
+        }
+
+        needsScreenTextureLookup = false;
+
+        // The screen texture depends on nothing but its generation constants, its size, and the mask that it's built
+        //  from, so those are its key (any settings that don't affect those constants don't matter).
+        ScreenTextureKey screenKey;
+        screenKey.maskType = uint32_t(screenSettings.maskType);
+        screenKey.width = outputWidth;
+        screenKey.height = outputHeight;
+        screenKey.constants = CalculateScreenTextureConstants();
+        screenTextureEntry = screenTextureCache->Acquire(
+          &screenKey,
+          sizeof(screenKey),
+          outputWidth,
+          outputHeight,
+          1,
+          TextureFormat::RGBA_Unorm8);
+
+        if (screenTextureEntry->NeedsGenerate())
+        {
+          maskTextures->Prepare(screenSettings.maskType);
+        }
+
+        distortionTextureEntry = nullptr;
+        if ((rgbToCRTFeatures & uint32_t(RGBToCRTFeature::DistortionTexture)) != 0)
+        {
+          // The distortion texture depends on nothing but the common constants and its size (its key's kind keeps it
+          //  from ever being mistaken for a screen texture in the cache).
+          DistortionTextureKey distortionKey;
+          distortionKey.width = outputWidth;
+          distortionKey.height = outputHeight;
+          distortionKey.constants = CalculateCommonConstants(CalculateAspectData());
+          distortionTextureEntry = screenTextureCache->Acquire(
+            &distortionKey,
+            sizeof(distortionKey),
+            outputWidth,
+            outputHeight,
+            1,
+            TextureFormat::RGBA_Float32);
+        }
+      }
+
+
+      // Whether the previous frame is used at all (it's only needed for phosphor persistence).
+      bool NeedsPreviousFrame() const
+        { return screenSettings.phosphorPersistence > 0.0f; }
 
-          overscanSettings = overscan;
-          screenSettings = screen;
 
-          UpdateBlurTextures();
-          needsRenderScreenTexture = true;
+      // The part of the (processed) RGB input that can affect the output with the current settings. Anything outside
+      //  of it is hidden by overscan, so whatever renders the input doesn't need to render it (see
+      //  RenderTargetView::region). With no overscan this is the whole input.
+      TexelRect InputRegion() const
+      {
+        // The screen shows input texture coordinates from overscanLeft / originalInputImageWidth to
+        //  1 - overscanRight / originalInputImageWidth (and the same for y), and the screen mask blacks out anything
+        //  past that (the distortion moves things around on the screen, but whatever is visible still comes from
+        //  within that range).
+        float left = float(overscanSettings.overscanLeft) / float(originalInputImageWidth);
+        float right = 1.0f - float(overscanSettings.overscanRight) / float(originalInputImageWidth);
+        float top = float(overscanSettings.overscanTop) / float(scanlineCount);
+        float bottom = 1.0f - float(overscanSettings.overscanBottom) / float(scanlineCount);
+
+        // The CRT shader's bilinear samples (offset by up to a half scanline for interlacing, and for the previous
+        //  frame's interlacing) reach a little past that.
+        float apronX = k_crtApronTexelCount / float(processedRGBTextureWidth);
+        float apronY = k_crtApronTexelCount / float(scanlineCount);
+
+        // The diffusion is a blur of the whole input, so it reaches much further: the Gaussian blur's taps (and the
+        //  CRT shader's bilinear sample of its output) at the blur texture's resolution, plus the taps of the two
+        //  downsamples that come before it (see RenderBlur).
+        if (screenSettings.diffusionStrength > 0.0f)
+        {
+          apronX += k_blurApronTexelCount / float(blurTextureWidth)
+            + k_downsampleApronTexelCount / float(toneMapTexWidth)
+            + downsampleDirX * k_downsampleApronTexelCount / float(processedRGBTextureWidth);
+          apronY += k_blurApronTexelCount / float(toneMapTexHeight)
+            + downsampleDirY * k_downsampleApronTexelCount / float(scanlineCount);
         }
+
+        // Round outwards (with an extra texel for any rounding error) and clamp to the texture.
+        float width = float(processedRGBTextureWidth);
+        float height = float(scanlineCount);
+        auto toTexel = [](float texel, float size)
+          { return uint32_t(std::min(std::max(texel, 0.0f), size)); };
+
+        TexelRect region;
+        region.left = toTexel(std::floor((left - apronX) * width) - 1.0f, width);
+        region.right = toTexel(std::ceil((right + apronX) * width) + 1.0f, width);
+        region.top = toTexel(std::floor((top - apronY) * height) - 1.0f, height);
+        region.bottom = toTexel(std::ceil((bottom + apronY) * height) + 1.0f, height);
+        return region;
       }
 
 
-      void SetOutputSize(uint32_t outputWidth, uint32_t outputHeight)
+      // Request this frame's transient textures (the diffusion blur chain) from the given pool. This can create render
+      //  targets, so it needs to happen before rendering starts. keepOwnPreviousFrame is whether this instance needs to
+      //  keep its own copy of each frame's input for the next frame to use, because the caller has no way to give it
+      //  the previous frame (which is the case when the input comes straight from the user rather than the decoder).
+      void PlanTransients(TransientTargetPool *pool, bool keepOwnPreviousFrame)
       {
-        if (screenTexture == nullptr
-          || screenTexture->Width() != outputWidth
-          || screenTexture->Height() != outputHeight)
+        if (pool != transientPool)
+        {
+          ReturnPrevRGBInput();
+          transientPool = pool;
+        }
+
+        // The copy of the previous frame lasts from frame to frame, but it still comes from (and goes back to) the pool
+        //  so that turning phosphor persistence off and on again doesn't create a new one.
+        if (!keepOwnPreviousFrame || !NeedsPreviousFrame())
+        {
+          ReturnPrevRGBInput();
+        }
+        else if (prevRGBInput == nullptr)
+        {
+          prevRGBInput = pool->TakeTarget(processedRGBTextureWidth, scanlineCount, TextureFormat::RGBA_Unorm8);
+        }
+
+        if (screenSettings.diffusionStrength > 0.0f)
         {
-          // Rebuild the texture at the correct resolution
-          screenTexture = device->CreateRenderTarget(outputWidth, outputHeight, 1, TextureFormat::RGBA_Unorm8);
-          needsRenderScreenTexture = true;
+          toneMapTarget = pool->Request(
+            toneMapTexWidth,
+            toneMapTexHeight,
+            TextureFormat::RGBA_Unorm8,
+            StageID::RenderBlur,
+            StageID::RenderBlur);
+          blurScratchTarget = pool->Request(
+            blurTextureWidth,
+            toneMapTexHeight,
+            TextureFormat::RGBA_Unorm8,
+            StageID::RenderBlur,
+            StageID::RenderBlur);
+          blurTarget = pool->Request(
+            blurTextureWidth,
+            toneMapTexHeight,
+            TextureFormat::RGBA_Unorm8,
+            StageID::RenderBlur,
+            StageID::RGBToCRT);
         }
       }
 
 
+      // previousFrameRGBInput is the previous frame's input, if the caller keeps it around. Otherwise it should be
+      //  null, in which case our own copy of it is used (or, if there isn't one, the current frame).
       void Render(
         const ITexture *currentFrameRGBInput,
+        const ITexture *previousFrameRGBInput,
         IRenderTarget *outputTexture,
         ScanlineType scanType)
       {
-        assert(screenTexture != nullptr);
+        assert(screenTextureEntry != nullptr && !needsScreenTextureLookup);
 
-        if (needsRenderMaskTexture)
+        if (screenTextureEntry->NeedsGenerate())
         {
-          RenderMaskTexture();
-          needsRenderMaskTexture = false;
+          RenderScreenTexture();
+          screenTextureEntry->MarkGenerated();
         }
 
-        if (needsRenderScreenTexture)
+        if (distortionTextureEntry != nullptr && distortionTextureEntry->NeedsGenerate())
         {
-          RenderScreenTexture();
-          needsRenderScreenTexture = false;
+          RenderDistortionTexture();
+          distortionTextureEntry->MarkGenerated();
         }
 
-        if (isFirstFrame)
+        // With no previous frame (or no phosphor persistence, in which case the previous frame doesn't contribute
+        //  anything) bind the current frame in its place.
+        const ITexture *previousFrameTexture = currentFrameRGBInput;
+        if (previousFrameRGBInput != nullptr)
         {
-          isFirstFrame = false;
-          device->RenderQuad(
-            ShaderID::Util_Copy,
-            prevRGBInput.get(),
-            { { currentFrameRGBInput, SamplerType::LinearClamp } });
+          previousFrameTexture = previousFrameRGBInput;
+        }
+        else if (hasPrevRGBInput)
+        {
+          previousFrameTexture = prevRGBInput.get();
         }
 
         // Between 4k and 2k (2160p and 1080p vertical resolution) we want to scale up the effect of the scanlines
@@ -123,7 +316,7 @@ namespace CathodeRetro
         //  one.
         float resolutionEffectScale = std::max(
           0.0f,
-          std::min(1.0f, 1.0f - (float(screenTexture->Height()) - 1080.0f) / 1080.0f));
+          std::min(1.0f, 1.0f - (float(outputHeight) - 1080.0f) / 1080.0f));
 
         rgbToScreenConstantBuffer->Update(
           RGBToScreenConstants{
@@ -141,32 +334,82 @@ namespace CathodeRetro
             screenSettings.maskDepth,
           });
 
+        // With no diffusion the shader still samples the diffusion texture (it just doesn't contribute anything), so
+        //  bind the input in its place rather than keeping a blur texture around for nothing.
+        const ITexture *diffusionTexture = currentFrameRGBInput;
         if (screenSettings.diffusionStrength > 0.0f)
         {
           RenderBlur(currentFrameRGBInput);
+          diffusionTexture = transientPool->Target(blurTarget);
         }
 
-        device->RenderQuad(
-          ShaderID::CRT_RGBToCRT,
-          outputTexture,
+        {
+          ScopedStage stage(device, StageID::RGBToCRT);
+          if (distortionTextureEntry != nullptr)
           {
-            {currentFrameRGBInput, SamplerType::LinearClamp},
-            {prevRGBInput.get(), SamplerType::LinearClamp},
-            {screenTexture.get(), SamplerType::NearestClamp},
-            {blurTexture.get(), SamplerType::LinearClamp},
-          },
-          rgbToScreenConstantBuffer.get());
+            device->RenderQuadPermutation(
+              ShaderID::CRT_RGBToCRT,
+              rgbToCRTFeatures,
+              outputTexture,
+              {
+                {currentFrameRGBInput, SamplerType::LinearClamp},
+                {previousFrameTexture, SamplerType::LinearClamp},
+                {screenTextureEntry->Texture(), SamplerType::NearestClamp},
+                {diffusionTexture, SamplerType::LinearClamp},
+                {distortionTextureEntry->Texture(), SamplerType::NearestClamp},
+              },
+              rgbToScreenConstantBuffer.get());
+          }
+          else
+          {
+            device->RenderQuadPermutation(
+              ShaderID::CRT_RGBToCRT,
+              rgbToCRTFeatures,
+              outputTexture,
+              {
+                {currentFrameRGBInput, SamplerType::LinearClamp},
+                {previousFrameTexture, SamplerType::LinearClamp},
+                {screenTextureEntry->Texture(), SamplerType::NearestClamp},
+                {diffusionTexture, SamplerType::LinearClamp},
+              },
+              rgbToScreenConstantBuffer.get());
+          }
+        }
 
-        device->RenderQuad(
-          ShaderID::Util_Copy,
-          prevRGBInput.get(),
-          { { currentFrameRGBInput, SamplerType::LinearClamp } });
+        if (prevRGBInput != nullptr)
+        {
+          ScopedStage stage(device, StageID::CopyPreviousFrame);
+          device->RenderQuad(
+            ShaderID::Util_Copy,
+            prevRGBInput.get(),
+            { { currentFrameRGBInput, SamplerType::LinearClamp } });
+          hasPrevRGBInput = true;
+        }
 
         prevScanlineType = scanType;
       }
 
     private:
-      static constexpr uint32_t k_maskSize = 512;
+      // How far past the visible area (in texels of the texture being sampled) InputRegion needs to reach for the CRT
+      //  shader's samples, for the Gaussian blur's (plus the bilinear sample of its output), and for the Lanczos
+      //  downsamples' (see cathode-retro-util-gaussian-blur.hlsl and cathode-retro-util-lanczos.hlsli). Each includes
+      //  a texel for the bilinear filtering of the furthest tap.
+      static constexpr float k_crtApronTexelCount = 2.0f;
+      static constexpr float k_blurApronTexelCount = 8.0f;
+      static constexpr float k_downsampleApronTexelCount = 4.0f;
+
+
+      void ReturnPrevRGBInput()
+      {
+        if (transientPool != nullptr)
+        {
+          transientPool->ReturnTarget(std::move(prevRGBInput));
+        }
+
+        prevRGBInput = nullptr;
+        hasPrevRGBInput = false;
+      }
+
 
       struct AspectData
       {
@@ -195,6 +438,34 @@ namespace CathodeRetro
       };
 
 
+      // Which texture a screen texture cache key is for. Every key starts with one of these, so that keys for
+      //  different textures can never match each other.
+      enum class CachedTextureKind : uint32_t
+      {
+        Screen,
+        Distortion,
+      };
+
+
+      struct ScreenTextureKey
+      {
+        CachedTextureKind kind = CachedTextureKind::Screen;
+        uint32_t maskType;
+        uint32_t width;
+        uint32_t height;
+        ScreenTextureConstants constants;
+      };
+
+
+      struct DistortionTextureKey
+      {
+        CachedTextureKind kind = CachedTextureKind::Distortion;
+        uint32_t width;
+        uint32_t height;
+        CommonConstants constants;
+      };
+
+
       struct RGBToScreenConstants
       {
         CommonConstants common;
@@ -252,17 +523,17 @@ namespace CathodeRetro
 
         // Figure out the aspect ratio of the output, given both our dimensions as well as the pixel aspect ratio in
         //  the screen settings.
-        if (float(screenTexture->Width()) > aspectData.aspect * float(screenTexture->Height()))
+        if (float(outputWidth) > aspectData.aspect * float(outputHeight))
         {
-          float desiredWidth = aspectData.aspect * float(screenTexture->Height());
-          data.viewScale.x = float(screenTexture->Width()) / desiredWidth;
+          float desiredWidth = aspectData.aspect * float(outputHeight);
+          data.viewScale.x = float(outputWidth) / desiredWidth;
           data.viewScale.y = 1.0f;
         }
         else
         {
-          float desiredHeight = float(screenTexture->Width()) / aspectData.aspect;
+          float desiredHeight = float(outputWidth) / aspectData.aspect;
           data.viewScale.x = 1.0f;
-          data.viewScale.y = float(screenTexture->Height()) / desiredHeight;
+          data.viewScale.y = float(outputHeight) / desiredHeight;
         }
 
         // Taking the square root of the distortion gives us a little more change at smaller values.
@@ -273,10 +544,50 @@ namespace CathodeRetro
       }
 
 
-      void RenderScreenTexture()
+      // Figure out which of the CRT shader's features have any effect with the current settings (see RGBToCRTFeature).
+      uint32_t CalculateRGBToCRTFeatures() const
       {
-        assert(screenTexture != nullptr);
+        uint32_t features = 0;
+        if (screenSettings.distortion.x != 0.0f || screenSettings.distortion.y != 0.0f)
+        {
+          features |= uint32_t(RGBToCRTFeature::Distortion);
+        }
+
+        if (screenSettings.phosphorPersistence > 0.0f)
+        {
+          features |= uint32_t(RGBToCRTFeature::PhosphorPersistence);
+        }
+
+        if (screenSettings.diffusionStrength > 0.0f)
+        {
+          features |= uint32_t(RGBToCRTFeature::Diffusion);
+        }
 
+        if (screenSettings.maskStrength != 0.0f)
+        {
+          features |= uint32_t(RGBToCRTFeature::Mask);
+        }
+
+        if (screenSettings.scanlineStrength != 0.0f)
+        {
+          features |= uint32_t(RGBToCRTFeature::Scanlines);
+        }
+
+        // Without distortion the coordinates are cheap enough to calculate that there's no point in a texture, and a
+        //  device that always renders with the full shader would never read it.
+        if (useDistortionTexture
+          && (features & uint32_t(RGBToCRTFeature::Distortion)) != 0
+          && device->SupportsShaderPermutations())
+        {
+          features |= uint32_t(RGBToCRTFeature::DistortionTexture);
+        }
+
+        return features;
+      }
+
+
+      ScreenTextureConstants CalculateScreenTextureConstants()
+      {
         ScreenTextureConstants data;
 
         auto aspectData = CalculateAspectData();
@@ -311,35 +622,53 @@ namespace CathodeRetro
         //  version look reasonably consistent with the 4k one.
         float resolutionEffectScale = std::max(
           0.0f,
-          std::min(1.0f, 1.0f - (float(screenTexture->Height()) - 1080.0f) / 1080.0f));
+          std::min(1.0f, 1.0f - (float(outputHeight) - 1080.0f) / 1080.0f));
         data.maskScale.x *= (1.0f - 0.1f * resolutionEffectScale);
         data.maskScale.y *= (1.0f - 0.1f * resolutionEffectScale);
 
         data.screenAspect = aspectData.aspect;
+        return data;
+      }
 
-        screenTextureConstantBuffer->Update(data);
+
+      void RenderScreenTexture()
+      {
+        ScopedStage stage(device, StageID::RenderScreenTexture);
+
+        screenTextureConstantBuffer->Update(CalculateScreenTextureConstants());
 
         device->RenderQuad(
           ShaderID::CRT_GenerateScreenTexture,
-          screenTexture.get(),
-          {{maskTexture.get(), SamplerType::LinearWrap}},
+          screenTextureEntry->Texture(),
+          {{maskTextures->Texture(screenSettings.maskType), SamplerType::LinearWrap}},
           screenTextureConstantBuffer.get());
       }
 
 
-      void UpdateBlurTextures()
+      void RenderDistortionTexture()
+      {
+        ScopedStage stage(device, StageID::RenderDistortionTexture);
+
+        distortionTextureConstantBuffer->Update(CalculateCommonConstants(CalculateAspectData()));
+
+        device->RenderQuad(
+          ShaderID::CRT_GenerateDistortionTexture,
+          distortionTextureEntry->Texture(),
+          {},
+          distortionTextureConstantBuffer.get());
+      }
+
+
+      void UpdateBlurTextureSizes()
       {
         auto aspectData = CalculateAspectData();
-        uint32_t tonemapTexWidth;
-        uint32_t tonemapTexHeight;
-        uint32_t blurTextureWidth;
         if (float(processedRGBTextureWidth) > aspectData.aspect * float(scanlineCount))
         {
           // the tonemap texture is going to scale down to 2x the actual aspect we want (we'll downsample farther from
           //  there)
-          tonemapTexHeight = scanlineCount;
-          tonemapTexWidth = uint32_t(std::round(aspectData.aspect * float(scanlineCount))) * 2;
-          blurTextureWidth = tonemapTexWidth / 2;
+          toneMapTexHeight = scanlineCount;
+          toneMapTexWidth = uint32_t(std::round(aspectData.aspect * float(scanlineCount))) * 2;
+          blurTextureWidth = toneMapTexWidth / 2;
           downsampleDirX = 1.0f;
           downsampleDirY = 0.0f;
         }
@@ -347,89 +676,19 @@ namespace CathodeRetro
         {
           // This is an unlikely case (the signal already has a massive stretch), in this case we'll keep things the
           //  same and the blur texture will be scaled up slightly.
-          tonemapTexWidth = originalInputImageWidth;
-          tonemapTexHeight = scanlineCount;
+          toneMapTexWidth = originalInputImageWidth;
+          toneMapTexHeight = scanlineCount;
           blurTextureWidth = uint32_t(std::round(aspectData.aspect * float(scanlineCount)));
           downsampleDirX = 0.0f;
           downsampleDirY = 1.0f;
         }
-
-        if (toneMapTexture == nullptr
-          || toneMapTexture->Width() != tonemapTexWidth
-          || toneMapTexture->Height() != tonemapTexHeight)
-        {
-          // Rebuild our blur textures.
-          toneMapTexture = device->CreateRenderTarget(
-            tonemapTexWidth,
-            tonemapTexHeight,
-            1,
-            TextureFormat::RGBA_Unorm8);
-
-          blurTexture = device->CreateRenderTarget(
-            blurTextureWidth,
-            tonemapTexHeight,
-            1,
-            TextureFormat::RGBA_Unorm8);
-
-          blurScratchTexture = device->CreateRenderTarget(
-            blurTextureWidth,
-            tonemapTexHeight,
-            1,
-            TextureFormat::RGBA_Unorm8);
-        }
-      }
-
-
-      // Generate the mask texture we use for the CRT emulation
-      void RenderMaskTexture()
-      {
-        ShaderID shader;
-        switch (screenSettings.maskType)
-        {
-        case MaskType::SlotMask:
-          shader = ShaderID::CRT_GenerateSlotMask;
-          break;
-
-        case MaskType::ShadowMask:
-          shader = ShaderID::CRT_GenerateShadowMask;
-          break;
-
-        case MaskType::ApertureGrille:
-        default:
-          shader = ShaderID::CRT_GenerateApertureGrille;
-          break;
-        }
-
-        // First step is the generate the texture at the largest mip level
-        generateMaskConstantBuffer->Update(Vec2{ float(k_maskSize), float(k_maskSize / 2) });
-        device->RenderQuad(
-          shader,
-          maskTexture.get(),
-          {},
-          generateMaskConstantBuffer.get());
-
-        // Now it's generated so we need to generate the mips by using our lanczos downsample
-        maskDownsampleConstantBufferH->Update(Vec2{ 1.0f, 0.0f });
-        maskDownsampleConstantBufferV->Update(Vec2{ 0.0f, 1.0f });
-        for (uint32_t destMip = 1; destMip < maskTexture->MipCount(); destMip++)
-        {
-          device->RenderQuad(
-            ShaderID::Util_Downsample2X,
-            {halfWidthMaskTexture.get(), destMip - 1},
-            {{maskTexture.get(), destMip - 1, SamplerType::LinearWrap}},
-            maskDownsampleConstantBufferH.get());
-
-          device->RenderQuad(
-            ShaderID::Util_Downsample2X,
-            {maskTexture.get(), destMip},
-            {{halfWidthMaskTexture.get(), destMip - 1, SamplerType::LinearWrap}},
-            maskDownsampleConstantBufferV.get());
-        }
       }
 
 
       void RenderBlur(const ITexture *inputTexture)
       {
+        ScopedStage stage(device, StageID::RenderBlur);
+
         // $TODO: This is slightly inaccurate, we should really be using the max of inputTexture and
         //  prevFrameTexture * phosphorPersistence, but for now, this is fine.
         toneMapConstantBuffer->Update(
@@ -447,28 +706,28 @@ namespace CathodeRetro
 
         device->RenderQuad(
           ShaderID::Util_TonemapAndDownsample,
-          toneMapTexture.get(),
+          transientPool->Target(toneMapTarget),
           {{inputTexture, SamplerType::LinearClamp}},
           toneMapConstantBuffer.get());
 
         device->RenderQuad(
           ShaderID::Util_Downsample2X,
-          blurTexture.get(),
-          {{toneMapTexture.get(), SamplerType::LinearClamp}},
+          transientPool->Target(blurTarget),
+          {{transientPool->Target(toneMapTarget), SamplerType::LinearClamp}},
           blurDownsampleConstantBuffer.get());
 
         gaussianBlurConstantBufferH->Update(GaussianBlurConstants{1.0f, 0.0f});
         device->RenderQuad(
           ShaderID::Util_GaussianBlur13,
-          blurScratchTexture.get(),
-          {{blurTexture.get(), SamplerType::LinearClamp}},
+          transientPool->Target(blurScratchTarget),
+          {{transientPool->Target(blurTarget), SamplerType::LinearClamp}},
           gaussianBlurConstantBufferH.get());
 
         gaussianBlurConstantBufferV->Update(GaussianBlurConstants{0.0f, 1.0f});
         device->RenderQuad(
           ShaderID::Util_GaussianBlur13,
-          blurTexture.get(),
-          {{blurScratchTexture.get(), SamplerType::LinearClamp}},
+          transientPool->Target(blurTarget),
+          {{transientPool->Target(blurScratchTarget), SamplerType::LinearClamp}},
           gaussianBlurConstantBufferV.get());
       }
 
@@ -479,32 +738,46 @@ namespace CathodeRetro
       uint32_t processedRGBTextureWidth;
       uint32_t scanlineCount;
       float pixelAspect;
-      bool isFirstFrame = true;
 
       std::unique_ptr<IConstantBuffer> screenTextureConstantBuffer;
+      std::unique_ptr<IConstantBuffer> distortionTextureConstantBuffer;
       std::unique_ptr<IConstantBuffer> rgbToScreenConstantBuffer;
       std::unique_ptr<IConstantBuffer> toneMapConstantBuffer;
       std::unique_ptr<IConstantBuffer> blurDownsampleConstantBuffer;
       std::unique_ptr<IConstantBuffer> gaussianBlurConstantBufferH;
       std::unique_ptr<IConstantBuffer> gaussianBlurConstantBufferV;
-      std::unique_ptr<IConstantBuffer> generateMaskConstantBuffer;
-      std::unique_ptr<IConstantBuffer> maskDownsampleConstantBufferH;
-      std::unique_ptr<IConstantBuffer> maskDownsampleConstantBufferV;
 
+      // Our own copy of the previous frame's input, only when the caller doesn't keep the previous frame itself and
+      //  there's phosphor persistence.
       std::unique_ptr<IRenderTarget> prevRGBInput;
-
-      std::unique_ptr<IRenderTarget> maskTexture;
-      std::unique_ptr<IRenderTarget> halfWidthMaskTexture;
-      std::unique_ptr<IRenderTarget> screenTexture;
-
-      std::unique_ptr<IRenderTarget> toneMapTexture;
-      std::unique_ptr<IRenderTarget> blurScratchTexture;
-      std::unique_ptr<IRenderTarget> blurTexture;
+      bool hasPrevRGBInput = false;
+
+      // The screen texture (and distortion texture) come out of the (possibly shared) screen texture cache, and the
+      //  mask that the screen texture is generated from out of the mask textures shared by everything rendering with
+      //  our device.
+      ScreenTextureCache *screenTextureCache;
+      std::shared_ptr<ScreenTextureCache::Entry> screenTextureEntry;
+      std::shared_ptr<ScreenTextureCache::Entry> distortionTextureEntry;
+      bool useDistortionTexture = false;
+      std::shared_ptr<MaskTextures> maskTextures;
+      uint32_t outputWidth = 0;
+      uint32_t outputHeight = 0;
+
+      // The diffusion blur textures are transient (and only requested when there is diffusion to render).
+      TransientTargetPool *transientPool = nullptr;
+      TransientTargetPool::Handle toneMapTarget = 0;
+      TransientTargetPool::Handle blurScratchTarget = 0;
+      TransientTargetPool::Handle blurTarget = 0;
+      uint32_t toneMapTexWidth;
+      uint32_t toneMapTexHeight;
+      uint32_t blurTextureWidth;
 
       ScreenSettings screenSettings;
       OverscanSettings overscanSettings;
-      bool needsRenderScreenTexture = false;
-      bool needsRenderMaskTexture = false;
+      bool needsScreenTextureLookup = true;
+
+      // The set of RGBToCRTFeature bits that the CRT shader permutation needs for the current settings.
+      uint32_t rgbToCRTFeatures = k_rgbToCRTAllFeatures;
 
       ScanlineType prevScanlineType = ScanlineType::Progressive;
       float downsampleDirX;
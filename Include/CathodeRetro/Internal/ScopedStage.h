@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+namespace CathodeRetro
+{
+  namespace Internal
+  {
+    // Calls IGraphicsDevice::BeginStage on construction and EndStage on destruction, so that a stage's profiling
+    //  markers always match up.
+    class ScopedStage
+    {
+    public:
+      ScopedStage(IGraphicsDevice *deviceIn, StageID stageIn)
+        : device(deviceIn)
+        , stage(stageIn)
+        { device->BeginStage(stage); }
+
+      ~ScopedStage()
+        { device->EndStage(stage); }
+
+      ScopedStage(const ScopedStage &) = delete;
+      void operator=(const ScopedStage &) = delete;
+
+    private:
+      IGraphicsDevice *device;
+      StageID stage;
+    };
+  }
+}
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
 #include "CathodeRetro/Internal/Constants.h"
+#include "CathodeRetro/Internal/ScopedStage.h"
 #include "CathodeRetro/Internal/SignalLevels.h"
 #include "CathodeRetro/Internal/SignalProperties.h"
+#include "CathodeRetro/Internal/TexelRegion.h"
 #include "CathodeRetro/Settings.h"
+#include "CathodeRetro/TransientTargetPool.h"
 
 
 namespace CathodeRetro
@@ -21,69 +31,227 @@ namespace CathodeRetro
         {
           // We need a Composite -> SVideo step (luma/chroma separation), so run that
           compositeToSVideoConstantBuffer = device->CreateConstantBuffer(sizeof(CompositeToSVideoConstantData));
-
-          decodedSVideoTextureSingle = device->CreateRenderTarget(
-            signalProps.scanlineWidth,
-            signalProps.scanlineCount,
-            1,
-            TextureFormat::RG_Float32);
-          decodedSVideoTextureDouble = device->CreateRenderTarget(
-            signalProps.scanlineWidth,
-            signalProps.scanlineCount,
-            1,
-            TextureFormat::RGBA_Float32);
         }
 
-        modulatedChromaTextureSingle = device->CreateRenderTarget(
-          signalProps.scanlineWidth,
-          signalProps.scanlineCount,
-          1,
-          TextureFormat::RG_Float32);
-        modulatedChromaTextureDouble = device->CreateRenderTarget(
-          signalProps.scanlineWidth,
-          signalProps.scanlineCount,
-          1,
-          TextureFormat::RGBA_Float32);
-
         // the output RGB image is narrower by totalSidePaddingTexelCount, since we're removing the padding as part of
         //  the decode process.
-        uint32_t rgbWidth = signalProps.scanlineWidth - signalProps.totalSidePaddingTexelCount;
+        rgbWidth = signalProps.scanlineWidth - signalProps.totalSidePaddingTexelCount;
 
         // Now initialise the SVideo -> RGB elements
-        sVideoToRGBConstantBuffer = device->CreateConstantBuffer(sizeof(SVideoToRGBConstantData));
-        sVideoToModulatedChromaConstantBuffer =
-          device->CreateConstantBuffer(sizeof(SVideoToModulatedChromaConstantData));
-        rgbTexture = device->CreateRenderTarget(
-          rgbWidth,
-          signalProps.scanlineCount,
-          1,
-          TextureFormat::RGBA_Unorm8);
-        scratchRGBTexture = device->CreateRenderTarget(
-          rgbWidth,
-          signalProps.scanlineCount,
-          1,
-          TextureFormat::RGBA_Unorm8);
+        sVideoToRGBConstantBuffer = device->CreateConstantBuffer(
+          std::max(sizeof(SVideoToRGBConstantData), sizeof(SVideoAndDecimatedIQToRGBConstantData)));
+        sVideoToModulatedChromaConstantBuffer = device->CreateConstantBuffer(
+          std::max(sizeof(SVideoToModulatedChromaConstantData), sizeof(SVideoToDecimatedIQConstantData)));
 
         // Finally, the RGB filtering portions
         filterRGBConstantBuffer = device->CreateConstantBuffer(sizeof(FilterRGBConstantData));
       }
 
+      ~SignalDecoder()
+        { ReturnHistoryTextures(); }
+
+      SignalDecoder(const SignalDecoder &) = delete;
+      void operator=(const SignalDecoder &) = delete;
+
       void SetKnobSettings(const TVKnobSettings &settings)
         { knobSettings = settings; }
 
+      // Change the storage precision of the intermediate (decoded S-Video and modulated chroma) textures. This takes
+      //  effect starting with the next PlanTransients call.
+      void SetSignalPrecision(SignalPrecision precision)
+        { signalPrecision = precision; }
+
+      // Change how finely the chroma gets filtered out of the signal (see ChromaResolution). This also takes effect
+      //  starting with the next PlanTransients call.
+      void SetChromaResolution(ChromaResolution resolution)
+        { chromaResolution = resolution; }
+
+      // Set the part of the RGB output that will be used (see RenderTargetView::region). Decoding only renders what it
+      //  needs to for that part (see InputRegion for how much of the input signal that is). This also takes effect
+      //  starting with the next PlanTransients call.
+      void SetOutputRegion(const TexelRect &region)
+        { outputRegion = region; }
+
+      // The part of the input signal that the next decode will read, given the output region (only valid once
+      //  PlanTransients has been called).
+      const TexelRect &InputRegion() const
+        { return inputRegion; }
+
+      // Request this frame's intermediate and output textures from the given pool. This can create render targets,
+      //  so it needs to happen before rendering starts. isDoubled is whether the incoming signal has two phases (i.e.
+      //  whether temporal artifact reduction is enabled), and historyFrameCount is how many frames of RGB output to
+      //  keep around: 0 for none, 2 to keep the previous frame's output for this frame (see PreviousFrameRGBOutput),
+      //  or more to also keep older frames that might be decoded again (see FindFrame).
+      void PlanTransients(TransientTargetPool *pool, uint32_t historyFrameCount, bool isDoubled)
+      {
+        assert(historyFrameCount != 1);
+        if (pool != transientPool)
+        {
+          ReturnHistoryTextures();
+          transientPool = pool;
+        }
+
+        // The history textures last from frame to frame, but they still come from (and go back to) the pool so that
+        //  turning the history off and on again doesn't create new ones.
+        if (historyFrameCount != history.size())
+        {
+          ReturnHistoryTextures();
+          history.resize(historyFrameCount);
+          for (HistoryFrame &frame : history)
+          {
+            frame.texture = pool->TakeTarget(rgbWidth, signalProps.scanlineCount, TextureFormat::RGBA_Unorm8);
+          }
+        }
+
+        bool keepPreviousFrame = !history.empty();
+
+        bool isHalf = (signalPrecision == SignalPrecision::Float16);
+        TextureFormat sVideoFormat = isDoubled
+          ? (isHalf ? TextureFormat::RGBA_Float16 : TextureFormat::RGBA_Float32)
+          : (isHalf ? TextureFormat::RG_Float16 : TextureFormat::RG_Float32);
+
+        if (signalProps.type == SignalType::Composite)
+        {
+          decodedSVideoTarget = pool->Request(
+            signalProps.scanlineWidth,
+            signalProps.scanlineCount,
+            sVideoFormat,
+            StageID::CompositeToSVideo,
+            StageID::SVideoToRGB);
+        }
+
+        // The decimated chroma decode skips the full-resolution modulated chroma entirely, and instead has a texture of
+        //  decoded IQ values with one texel per color cycle (plus one, so that every signal texel has a decimated texel
+        //  on either side of it to interpolate between).
+        isChromaDecimated = (chromaResolution == ChromaResolution::Decimated);
+        if (isChromaDecimated)
+        {
+          decimatedIQTarget = pool->Request(
+            signalProps.scanlineWidth / k_signalSamplesPerColorCycle + 1,
+            signalProps.scanlineCount,
+            sVideoFormat,
+            StageID::SVideoToRGB,
+            StageID::SVideoToRGB);
+        }
+        else
+        {
+          modulatedChromaTarget = pool->Request(
+            signalProps.scanlineWidth,
+            signalProps.scanlineCount,
+            sVideoFormat,
+            StageID::SVideoToRGB,
+            StageID::SVideoToRGB);
+        }
+
+        // When keeping history, the final RGB output goes straight into a history texture rather than a transient
+        //  one (so there's no transient at all for it if there's no filtering to do), otherwise it's used by RGBToCRT
+        //  until the end of the frame.
+        bool hasFilter = (knobSettings.sharpness != 0.0f);
+        if (hasFilter || !keepPreviousFrame)
+        {
+          decodedRGBTarget = pool->Request(
+            rgbWidth,
+            signalProps.scanlineCount,
+            TextureFormat::RGBA_Unorm8,
+            StageID::SVideoToRGB,
+            hasFilter ? StageID::FilterRGB : StageID::RGBToCRT);
+        }
+
+        rgbOutputTarget = decodedRGBTarget;
+        if (hasFilter && !keepPreviousFrame)
+        {
+          rgbOutputTarget = pool->Request(
+            rgbWidth,
+            signalProps.scanlineCount,
+            TextureFormat::RGBA_Unorm8,
+            StageID::FilterRGB,
+            StageID::RGBToCRT);
+        }
+
+        UpdateRegions(hasFilter);
+      }
+
+      // The decoded RGB output for the current frame (only valid during the frame that PlanTransients was last called
+      //  for).
       const ITexture *CurrentFrameRGBOutput() const
-        { return rgbTexture.get(); }
+        { return const_cast<SignalDecoder *>(this)->RGBOutput(); }
+
+      // The decoded RGB output for the previous frame, if the previous frame was also decoded (or reused) while
+      //  keeping history, otherwise the current frame's (which is what the previous frame should look like when there
+      //  isn't one). Keeping history never copies anything: each frame's output goes into a different history texture
+      //  than the previous frame's, so that the previous frame's output is still intact. The previous frame also counts
+      //  as missing if it was decoded for a smaller output region than the current frame (see SetOutputRegion), since
+      //  then part of what the current frame needs from it was never rendered.
+      const ITexture *PreviousFrameRGBOutput() const
+      {
+        if (previousIndex == k_noFrame || !ContainsRegion(history[previousIndex].region, history[currentIndex].region))
+        {
+          return CurrentFrameRGBOutput();
+        }
+
+        return history[previousIndex].texture.get();
+      }
 
-      void Decode(const ITexture *inputSignal, const ITexture *inputPhases, const SignalLevels &levels)
+      // Look for a kept frame that was decoded with the given key (see Decode), returning whether there is one. If so,
+      //  the next ReuseFrame call will use it.
+      bool FindFrame(const void *key, size_t keySize)
       {
+        foundIndex = k_noFrame;
+        for (uint32_t i = 0; i < history.size(); i++)
+        {
+          const std::vector<uint8_t> &frameKey = history[i].key;
+          if (!frameKey.empty() && frameKey.size() == keySize && memcmp(frameKey.data(), key, keySize) == 0)
+          {
+            foundIndex = i;
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      // Skip decoding, and use the frame that FindFrame found as this frame's output, for when the caller knows that
+      //  this frame would decode to exactly the same thing. PlanTransients does not need to be called for a reused
+      //  frame.
+      void ReuseFrame()
+      {
+        assert(foundIndex < history.size());
+        StartFrame(foundIndex);
+        foundIndex = k_noFrame;
+      }
+
+      // Decode a frame. key (which can be null) identifies everything that the output depends on, so that a later
+      //  frame with the same key can reuse this output (see FindFrame) for as long as it stays in the history.
+      void Decode(
+        const ITexture *inputSignal,
+        const ITexture *inputPhases,
+        const SignalLevels &levels,
+        const void *key = nullptr,
+        size_t keySize = 0)
+      {
+        if (!history.empty())
+        {
+          // The output goes into whichever history texture was used the longest ago, other than the previous frame's
+          //  (which needs to stay intact for this frame).
+          uint32_t index = k_noFrame;
+          for (uint32_t i = 0; i < history.size(); i++)
+          {
+            if (i != currentIndex && (index == k_noFrame || history[i].lastUsedFrame < history[index].lastUsedFrame))
+            {
+              index = i;
+            }
+          }
+
+          StartFrame(index);
+          history[index].key.assign(static_cast<const uint8_t *>(key), static_cast<const uint8_t *>(key) + keySize);
+          history[index].region = rgbOutputRegion;
+        }
+
         const ITexture *sVideoTexture;
         if (signalProps.type == SignalType::Composite)
         {
-          ITexture *outTex = (levels.temporalArtifactReduction > 0.0f)
-            ? decodedSVideoTextureDouble.get()
-            : decodedSVideoTextureSingle.get();
-          sVideoTexture = outTex;
-          CompositeToSVideo(inputSignal, levels.temporalArtifactReduction > 0.0f);
+          sVideoTexture = transientPool->Target(decodedSVideoTarget);
+          CompositeToSVideo(inputSignal);
         }
         else
         {
@@ -100,16 +268,101 @@ namespace CathodeRetro
 
       uint32_t OutputTextureWidth() const
       {
-        return rgbTexture->Width();
+        return rgbWidth;
       }
 
     private:
-      void CompositeToSVideo(const ITexture *inputSignal, bool isDoubled)
+      static constexpr uint32_t k_noFrame = ~0U;
+
+      // Move on to a new frame whose output is in the given history texture (with the current frame becoming the
+      //  previous one).
+      void StartFrame(uint32_t index)
+      {
+        previousIndex = currentIndex;
+        currentIndex = index;
+        history[index].lastUsedFrame = ++frameCount;
+      }
+
+      void ReturnHistoryTextures()
+      {
+        if (transientPool != nullptr)
+        {
+          for (HistoryFrame &frame : history)
+          {
+            transientPool->ReturnTarget(std::move(frame.texture));
+          }
+        }
+
+        history.clear();
+        currentIndex = k_noFrame;
+        previousIndex = k_noFrame;
+        foundIndex = k_noFrame;
+      }
+
+
+      // Work backwards from the output region to the region that each pass needs to render (and, at the end, to the
+      //  region of the input signal that the first pass reads). Every pass reads from the same scanline that it's
+      //  rendering, so the rows are the same all the way through, and only the columns spread out.
+      void UpdateRegions(bool hasFilter)
+      {
+        const uint32_t N = k_signalSamplesPerColorCycle;
+        uint32_t scanlineWidth = signalProps.scanlineWidth;
+        rgbOutputRegion = ClampRegion(outputRegion, rgbWidth, signalProps.scanlineCount);
+
+        // FilterRGB's side taps are a step away on either side (plus a texel for their bilinear filtering).
+        decodedRGBRegion = rgbOutputRegion;
+        if (hasFilter)
+        {
+          uint32_t stepSize = uint32_t(std::ceil(signalProps.colorCyclesPerInputPixel * float(N)));
+          decodedRGBRegion = WidenRegion(rgbOutputRegion, stepSize + 1, rgbWidth);
+        }
+
+        // RGB texel x decodes signal texel x + half of the padding.
+        TexelRect signalRegion = decodedRGBRegion;
+        signalRegion.left += signalProps.totalSidePaddingTexelCount / 2;
+        signalRegion.right += signalProps.totalSidePaddingTexelCount / 2;
+
+        if (isChromaDecimated)
+        {
+          // Signal texel x interpolates between the decimated texels on either side of x / N, and decimated texel m
+          //  filters the S-Video texels within a color cycle of m * N + N / 2 (on top of the ones that the RGB
+          //  conversion reads directly).
+          uint32_t iqWidth = scanlineWidth / N + 1;
+          chromaRegion = signalRegion;
+          chromaRegion.left = (signalRegion.left >= N) ? signalRegion.left / N - 1 : 0;
+          chromaRegion.right = std::min((signalRegion.right + N - 1) / N + 2, iqWidth);
+
+          uint32_t firstCenter = chromaRegion.left * N + N / 2;
+          uint32_t lastCenter = (chromaRegion.right - 1) * N + N / 2;
+          sVideoRegion = signalRegion;
+          sVideoRegion.left = std::min(signalRegion.left, (firstCenter > N) ? firstCenter - N : 0);
+          sVideoRegion.right = std::min(std::max(signalRegion.right, lastCenter + N + 1), scanlineWidth);
+        }
+        else
+        {
+          // The RGB conversion's box filter of the modulated chroma reaches a color cycle to either side (plus a texel
+          //  for the bilinear filtering), and the modulated chroma reads a texel of the S-Video on either side.
+          chromaRegion = WidenRegion(signalRegion, N + 1, scanlineWidth);
+          sVideoRegion = WidenRegion(chromaRegion, 1, scanlineWidth);
+        }
+
+        // The luma/chroma separation's box filter reaches half of a color cycle to either side.
+        inputRegion = sVideoRegion;
+        if (signalProps.type == SignalType::Composite)
+        {
+          inputRegion = WidenRegion(sVideoRegion, N / 2 + 1, scanlineWidth);
+        }
+      }
+
+
+      void CompositeToSVideo(const ITexture *inputSignal)
       {
+        ScopedStage stage(device, StageID::CompositeToSVideo);
+
         compositeToSVideoConstantBuffer->Update(CompositeToSVideoConstantData{ k_signalSamplesPerColorCycle });
         device->RenderQuad(
           ShaderID::Decoder_CompositeToSVideo,
-          (isDoubled ? decodedSVideoTextureDouble : decodedSVideoTextureSingle).get(),
+          RenderTargetView(transientPool->Target(decodedSVideoTarget), sVideoRegion),
           {{inputSignal, SamplerType::LinearClamp}},
           compositeToSVideoConstantBuffer.get());
       }
@@ -117,6 +370,63 @@ namespace CathodeRetro
 
       void SVideoToRGB(const ITexture *sVideoTexture, const ITexture *inputPhases, const SignalLevels &levels)
       {
+        ScopedStage stage(device, StageID::SVideoToRGB);
+
+        SVideoToRGBConstantData rgbConstants = {
+          k_signalSamplesPerColorCycle,
+
+          // Saturation needs brightness scaled into it as well or else the output is weird when the brightness is set
+          //  below 1.0
+          knobSettings.saturation / levels.saturationScale * knobSettings.brightness,
+          knobSettings.brightness,
+          levels.blackLevel,
+          levels.whiteLevel,
+          levels.temporalArtifactReduction,
+          sVideoTexture->Width(),
+          rgbWidth,
+        };
+
+        bool hasFilter = (knobSettings.sharpness != 0.0f);
+        IRenderTarget *rgbTex = hasFilter ? transientPool->Target(decodedRGBTarget) : RGBOutput();
+
+        if (isChromaDecimated)
+        {
+          IRenderTarget *decimatedIQTex = transientPool->Target(decimatedIQTarget);
+          sVideoToModulatedChromaConstantBuffer->Update(
+            SVideoToDecimatedIQConstantData {
+              k_signalSamplesPerColorCycle,
+              knobSettings.tint,
+              sVideoTexture->Width(),
+              decimatedIQTex->Width(),
+            });
+
+          device->RenderQuad(
+            ShaderID::Decoder_SVideoToDecimatedIQ,
+            RenderTargetView(decimatedIQTex, chromaRegion),
+            {
+              {sVideoTexture, SamplerType::NearestClamp},
+              {inputPhases, SamplerType::NearestClamp},
+            },
+            sVideoToModulatedChromaConstantBuffer.get());
+
+          sVideoToRGBConstantBuffer->Update(
+            SVideoAndDecimatedIQToRGBConstantData {
+              rgbConstants,
+              decimatedIQTex->Width(),
+            });
+
+          device->RenderQuad(
+            ShaderID::Decoder_SVideoAndDecimatedIQToRGB,
+            RenderTargetView(rgbTex, decodedRGBRegion),
+            {
+              {sVideoTexture, SamplerType::LinearClamp},
+              {decimatedIQTex, SamplerType::LinearClamp},
+            },
+            sVideoToRGBConstantBuffer.get());
+
+          return;
+        }
+
         sVideoToModulatedChromaConstantBuffer->Update(
           SVideoToModulatedChromaConstantData {
             k_signalSamplesPerColorCycle,
@@ -124,37 +434,21 @@ namespace CathodeRetro
             sVideoTexture->Width(),
           });
 
-        IRenderTarget *modulatedChromaTex = (levels.temporalArtifactReduction > 0.0f)
-          ? modulatedChromaTextureDouble.get()
-          : modulatedChromaTextureSingle.get();
+        IRenderTarget *modulatedChromaTex = transientPool->Target(modulatedChromaTarget);
 
         device->RenderQuad(
           ShaderID::Decoder_SVideoToModulatedChroma,
-          modulatedChromaTex,
+          RenderTargetView(modulatedChromaTex, chromaRegion),
           {
             {sVideoTexture, SamplerType::LinearClamp},
             {inputPhases, SamplerType::NearestClamp},
           },
           sVideoToModulatedChromaConstantBuffer.get());
 
-        sVideoToRGBConstantBuffer->Update(
-          SVideoToRGBConstantData {
-            k_signalSamplesPerColorCycle,
-
-            // Saturation needs brightness scaled into it as well or else the output is weird when the brightness is
-            //  set below 1.0
-            knobSettings.saturation / levels.saturationScale * knobSettings.brightness,
-            knobSettings.brightness,
-            levels.blackLevel,
-            levels.whiteLevel,
-            levels.temporalArtifactReduction,
-            sVideoTexture->Width(),
-            rgbTexture->Width(),
-          });
-
+        sVideoToRGBConstantBuffer->Update(rgbConstants);
         device->RenderQuad(
           ShaderID::Decoder_SVideoToRGB,
-          rgbTexture.get(),
+          RenderTargetView(rgbTex, decodedRGBRegion),
           {
             {sVideoTexture, SamplerType::LinearClamp},
             {modulatedChromaTex, SamplerType::LinearClamp},
@@ -165,6 +459,8 @@ namespace CathodeRetro
 
       void FilterRGB()
       {
+        ScopedStage stage(device, StageID::FilterRGB);
+
         filterRGBConstantBuffer->Update(
           FilterRGBConstantData {
             -knobSettings.sharpness,
@@ -173,20 +469,63 @@ namespace CathodeRetro
 
         device->RenderQuad(
           ShaderID::Decoder_FilterRGB,
-          scratchRGBTexture.get(),
-          {{rgbTexture.get(), SamplerType::LinearClamp}},
+          RenderTargetView(RGBOutput(), rgbOutputRegion),
+          {{transientPool->Target(decodedRGBTarget), SamplerType::LinearClamp}},
           filterRGBConstantBuffer.get());
+      }
 
-        // Our output is the new RGB Texture.
-        std::swap(rgbTexture, scratchRGBTexture);
+      // The texture that the final RGB output goes into this frame.
+      IRenderTarget *RGBOutput()
+      {
+        if (!history.empty())
+        {
+          return history[currentIndex].texture.get();
+        }
+
+        return transientPool->Target(rgbOutputTarget);
       }
 
       IGraphicsDevice *device;
 
-      std::unique_ptr<IRenderTarget> rgbTexture;
-      std::unique_ptr<IRenderTarget> scratchRGBTexture;
+      // The intermediate textures are transient: the RGB output comes straight out of the S-Video to RGB decode unless
+      //  there's sharpening/blurring to do, in which case the FilterRGB output is the final RGB output. The final
+      //  output is transient too, unless the previous frame's output needs keeping, in which case it goes into one of
+      //  the history textures, each of which remembers the key and output region it was decoded with and when it was
+      //  last used (as a frame number, counted by frameCount). currentIndex and previousIndex are the history textures
+      //  that the current and previous frames' outputs are in (which are the same texture if a frame reused the one
+      //  before it), and foundIndex is the one that FindFrame last found.
+      struct HistoryFrame
+      {
+        std::unique_ptr<IRenderTarget> texture;
+        std::vector<uint8_t> key;
+        TexelRect region;
+        uint64_t lastUsedFrame = 0;
+      };
+
+      TransientTargetPool *transientPool = nullptr;
+      TransientTargetPool::Handle decodedRGBTarget = 0;
+      TransientTargetPool::Handle rgbOutputTarget = 0;
+      std::vector<HistoryFrame> history;
+      uint32_t currentIndex = k_noFrame;
+      uint32_t previousIndex = k_noFrame;
+      uint32_t foundIndex = k_noFrame;
+      uint64_t frameCount = 0;
+      uint32_t rgbWidth;
       SignalProperties signalProps;
       TVKnobSettings knobSettings;
+      SignalPrecision signalPrecision = SignalPrecision::Float32;
+      ChromaResolution chromaResolution = ChromaResolution::Full;
+
+      // The part of the RGB output that will be used (as given to SetOutputRegion) and the regions that each pass
+      //  renders to give it (see UpdateRegions): the RGB output itself, the unfiltered RGB (the same thing when there's
+      //  no filtering), the modulated chroma or decimated IQ, the S-Video, and the part of the input signal that's
+      //  read.
+      TexelRect outputRegion;
+      TexelRect rgbOutputRegion;
+      TexelRect decodedRGBRegion;
+      TexelRect chromaRegion;
+      TexelRect sVideoRegion;
+      TexelRect inputRegion;
 
       // Step 1: Composite to SVideo elements
       struct CompositeToSVideoConstantData
@@ -195,8 +534,7 @@ namespace CathodeRetro
       };
 
       std::unique_ptr<IConstantBuffer> compositeToSVideoConstantBuffer;
-      std::unique_ptr<IRenderTarget> decodedSVideoTextureSingle;
-      std::unique_ptr<IRenderTarget> decodedSVideoTextureDouble;
+      TransientTargetPool::Handle decodedSVideoTarget = 0;
 
       // Step 2: SVideo to RGB Elements
       struct SVideoToModulatedChromaConstantData
@@ -221,8 +559,26 @@ namespace CathodeRetro
         uint32_t inputWidth;
       };
 
-      std::unique_ptr<IRenderTarget> modulatedChromaTextureSingle;
-      std::unique_ptr<IRenderTarget> modulatedChromaTextureDouble;
+      // The decimated chroma decode's versions of the above (see ChromaResolution). isChromaDecimated is whether the
+      //  current frame was planned with it.
+      struct SVideoToDecimatedIQConstantData
+      {
+        uint32_t samplesPerColorburstCycle;
+        float tint;
+        uint32_t inputWidth;
+        uint32_t outputWidth;                         // The width of the decimated IQ texture
+      };
+
+      struct SVideoAndDecimatedIQToRGBConstantData
+      {
+        SVideoToRGBConstantData common;
+        uint32_t iqWidth;                             // The width of the decimated IQ texture
+      };
+
+      bool isChromaDecimated = false;
+      TransientTargetPool::Handle decimatedIQTarget = 0;
+
+      TransientTargetPool::Handle modulatedChromaTarget = 0;
       std::unique_ptr<IConstantBuffer> sVideoToModulatedChromaConstantBuffer;
       std::unique_ptr<IConstantBuffer> sVideoToRGBConstantBuffer;
 
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <cassert>
+#include <cmath>
+
 #include "CathodeRetro/Internal/Constants.h"
+#include "CathodeRetro/Internal/ScopedStage.h"
 #include "CathodeRetro/Internal/SignalLevels.h"
 #include "CathodeRetro/Internal/SignalProperties.h"
+#include "CathodeRetro/Internal/TexelRegion.h"
 #include "CathodeRetro/Settings.h"
+#include "CathodeRetro/TransientTargetPool.h"
 
 namespace CathodeRetro
 {
@@ -40,7 +46,9 @@ namespace CathodeRetro
         signalProps.inputPixelAspectRatio = inputSettings.inputPixelAspectRatio;
 
         generateSignalConstantBuffer = device->CreateConstantBuffer(
-          std::max(sizeof(RGBToSVideoConstantData), sizeof(GeneratePhaseTextureConstantData)));
+          std::max(
+            std::max(sizeof(RGBToSVideoConstantData), sizeof(IndexedToSVideoConstantData)),
+            sizeof(GeneratePhaseTextureConstantData)));
 
         applyArtifactsConstantBuffer = device->CreateConstantBuffer(sizeof(ApplyArtifactsConstantData));
 
@@ -55,42 +63,140 @@ namespace CathodeRetro
       const Internal::SignalLevels &SignalLevels() const
         { return levels; }
 
+      // The per-scanline phases for the current frame (only valid during the frame that PlanTransients was last called
+      //  for).
       const ITexture *PhasesTexture() const
-        { return phasesTexture.get(); }
+        { return transientPool->Target(phasesTarget); }
 
+      // The generated signal for the current frame (only valid during the frame that PlanTransients was last called
+      //  for).
       const ITexture *SignalTexture() const
-        { return signalTexture.get(); }
+        { return transientPool->Target(signalTarget); }
 
       void SetArtifactSettings(const ArtifactSettings &settings)
       {
         artifactSettings = settings;
+        UpdateFormats();
+      }
 
-        // If we have any temporal artifact reduction we are going to double up our generated signal textures so that
-        //  two phases of the same frame can be blended together by the decoder.
-        bool wantsDouble = (artifactSettings.temporalArtifactReduction > 0.0f);
+      // Change the storage precision of the generated signal textures. Like the artifact settings, this takes effect
+      //  starting with the next PlanTransients call.
+      void SetSignalPrecision(SignalPrecision precision)
+      {
+        signalPrecision = precision;
+        UpdateFormats();
+      }
 
-        TextureFormat phasesFormat = wantsDouble ? TextureFormat::RG_Float32 : TextureFormat::R_Float32;
-        TextureFormat signalFormat = wantsDouble
-          ? ((signalProps.type == SignalType::SVideo) ? TextureFormat::RGBA_Float32 : TextureFormat::RG_Float32)
-          : ((signalProps.type == SignalType::SVideo) ? TextureFormat::RG_Float32 : TextureFormat::R_Float32);
+      // Switch to (or, with a colorCount of 0, away from) palette-indexed input: from here on, the input texture given
+      //  to Generate is an R_Unorm8 texture of indices into the given palette (colorCount RGBA_Unorm8 colors, 4 bytes
+      //  each, with the alpha ignored). The palette's signal table (see
+      //  cathode-retro-generator-indexed-to-svideo-or-composite.hlsl) gets rendered at the start of the next Generate,
+      //  so this should only be called when the palette changes. This can create render targets, so it can't be
+      //  called while rendering.
+      void SetPalette(const uint8_t *rgbaColors, uint32_t colorCount)
+      {
+        assert(colorCount <= k_maxPaletteColorCount);
+        paletteGeneration++;
+        if (colorCount == 0)
+        {
+          paletteSignalTable = nullptr;
+          return;
+        }
 
-        if (phasesTexture == nullptr || phasesTexture->Format() != phasesFormat)
+        // Every phase that a frame can start at (other than with picture instability, which the table's linear
+        //  filtering covers) is a multiple of 1 / denominator, and every texel along a scanline is another 1 /
+        //  k_signalSamplesPerColorCycle on from there (plus the half-texel offset from GeneratePhaseTexture), so with
+        //  this many steps every one of those phases lands exactly on a step.
+        paletteConstants.phaseStepCount = 2 * k_signalSamplesPerColorCycle * sourceSettings.denominator;
+        paletteConstants.paletteColorCount = colorCount;
+        for (uint32_t i = 0; i < colorCount; i++)
         {
-          phasesTexture = device->CreateRenderTarget(1, signalProps.scanlineCount, 1, phasesFormat);
+          for (uint32_t c = 0; c < 4; c++)
+          {
+            paletteConstants.colors[i][c] = float(rgbaColors[i * 4 + c]) / 255.0f;
+          }
         }
 
-        if (signalTexture == nullptr || signalTexture->Format() != signalFormat)
+        if (paletteTableConstantBuffer == nullptr)
         {
-          signalTexture = device->CreateRenderTarget(
-            signalProps.scanlineWidth,
-            signalProps.scanlineCount,
+          paletteTableConstantBuffer = device->CreateConstantBuffer(sizeof(PaletteSignalTableConstantData));
+        }
+
+        if (paletteSignalTable == nullptr
+          || paletteSignalTable->Width() != paletteConstants.phaseStepCount
+          || paletteSignalTable->Height() != colorCount)
+        {
+          paletteSignalTable = device->CreateRenderTarget(
+            paletteConstants.phaseStepCount,
+            colorCount,
             1,
-            signalFormat);
-          scratchSignalTexture = device->CreateRenderTarget(
+            TextureFormat::RG_Float32);
+        }
+
+        isPaletteSignalTableDirty = true;
+      }
+
+      bool IsIndexed() const
+        { return paletteSignalTable != nullptr; }
+
+      // Set the part of the generated signal that will be used (see RenderTargetView::region), so that generating it
+      //  can skip the rest. This takes effect starting with the next PlanTransients call.
+      void SetOutputRegion(const TexelRect &region)
+        { outputRegion = region; }
+
+      // Request this frame's phases and signal textures from the given pool. This can create render targets, so it
+      //  needs to happen before rendering starts.
+      void PlanTransients(TransientTargetPool *pool)
+      {
+        transientPool = pool;
+
+        // The phases are read by the generator and by the decoder's RGB conversion.
+        phasesTarget = pool->Request(
+          1,
+          signalProps.scanlineCount,
+          phasesFormat,
+          StageID::GeneratePhasesTexture,
+          StageID::SVideoToRGB);
+
+        // The signal needs to live until the decoder's first stage is done with it.
+        StageID lastSignalStage = (signalProps.type == SignalType::Composite)
+          ? StageID::CompositeToSVideo
+          : StageID::SVideoToRGB;
+
+        cleanSignalTarget = pool->Request(
+          signalProps.scanlineWidth,
+          signalProps.scanlineCount,
+          signalFormat,
+          StageID::GenerateCleanSignal,
+          HasArtifacts() ? StageID::ApplyArtifacts : lastSignalStage);
+
+        signalTarget = cleanSignalTarget;
+        if (HasArtifacts())
+        {
+          signalTarget = pool->Request(
             signalProps.scanlineWidth,
             signalProps.scanlineCount,
-            1,
-            signalFormat);
+            signalFormat,
+            StageID::ApplyArtifacts,
+            lastSignalStage);
+        }
+
+        // Every scanline's phase is needed (it's a single texel each anyway), but only the used part of the signal,
+        //  plus however far the ghost's samples reach from there (a texel for the bilinear filtering if there's no
+        //  ghost).
+        signalRegion = ClampRegion(outputRegion, signalProps.scanlineWidth, signalProps.scanlineCount);
+        cleanSignalRegion = signalRegion;
+        if (HasArtifacts())
+        {
+          uint32_t reach = 1;
+          if (artifactSettings.ghostVisibility > 0.0f)
+          {
+            float ghostReach = std::abs(artifactSettings.ghostDistance)
+              + std::abs(artifactSettings.ghostSpreadScale) * k_ghostSpreadReach;
+            reach += uint32_t(std::ceil(ghostReach * float(k_signalSamplesPerColorCycle)));
+          }
+
+          cleanSignalRegion = WidenRegion(signalRegion, reach, signalProps.scanlineWidth);
         }
       }
 
@@ -104,12 +210,52 @@ namespace CathodeRetro
         GeneratePhasesTexture();
         GenerateCleanSignal(inputRGBTexture);
 
-        if (artifactSettings.noiseStrength > 0.0f || artifactSettings.ghostVisibility > 0.0f)
+        if (HasArtifacts())
         {
-          // Apply artifacts to the signal, then swap signal and scratch to get the artifact output
+          // Apply artifacts to the clean signal to get the final signal
           ApplyArtifacts();
         }
 
+        SkipFrame();
+      }
+
+      // Everything (other than the input itself) that the next frame's signal depends on, which can be compared with
+      //  memcmp to see if two frames with the same input will generate the same signal.
+      struct FrameKey
+      {
+        uint32_t frameStartPhaseNumerator;
+        uint32_t prevFrameStartPhaseNumerator;
+        uint32_t noiseSeed;
+        uint32_t paletteGeneration;
+        ArtifactSettings artifactSettings;
+      };
+
+      FrameKey NextFrameKey() const
+      {
+        FrameKey key = {};
+        key.frameStartPhaseNumerator = frameStartPhaseNumerator;
+        key.paletteGeneration = paletteGeneration;
+        key.artifactSettings = artifactSettings;
+
+        // The previous frame's phase only matters if the signal has both phases in it, and the noise seed only matters
+        //  if there's noise (of either sort) to apply.
+        if (artifactSettings.temporalArtifactReduction > 0.0f)
+        {
+          key.prevFrameStartPhaseNumerator = prevFrameStartPhaseNumerator;
+        }
+
+        if (artifactSettings.noiseStrength > 0.0f || artifactSettings.instabilityScale > 0.0f)
+        {
+          key.noiseSeed = noiseSeed;
+        }
+
+        return key;
+      }
+
+      // Move on to the next frame without generating anything (for when the caller has the result of generating this
+      //  frame already), keeping the phase and noise sequence exactly as if it had been generated.
+      void SkipFrame()
+      {
         isEvenFrame = !isEvenFrame;
         prevFrameStartPhaseNumerator = frameStartPhaseNumerator;
         frameStartPhaseNumerator = (frameStartPhaseNumerator
@@ -131,6 +277,27 @@ namespace CathodeRetro
         uint32_t sidePaddingTexelCount;
       };
 
+      static constexpr uint32_t k_maxPaletteColorCount = 256;
+
+      // The furthest that ApplyArtifacts' ghost samples reach from the ghost's center, in multiples of
+      //  ghostSpreadScale color cycles (see cathode-retro-generator-apply-artifacts.hlsl).
+      static constexpr float k_ghostSpreadReach = 1.34f;
+
+      struct PaletteSignalTableConstantData
+      {
+        uint32_t phaseStepCount;                        // How many phases to generate the signal at for each color
+        uint32_t paletteColorCount;                     // How many colors there are in the palette
+        uint32_t padding[2];                            // (The colors start on a 16-byte boundary)
+        float colors[k_maxPaletteColorCount][4];        // The palette colors (only paletteColorCount are used)
+      };
+
+      struct IndexedToSVideoConstantData
+      {
+        RGBToSVideoConstantData common;                 // The same as for RGB input
+        uint32_t paletteColorCount;                     // The number of colors in the palette
+        uint32_t phaseStepCount;                        // How many phases the palette signal table has for each color
+      };
+
       struct GeneratePhaseTextureConstantData
       {
         float initialFrameStartPhase;                   // The phase at the start of the first scanline of this frame
@@ -163,8 +330,34 @@ namespace CathodeRetro
       };
 
 
+      // Work out the formats of the phases and signal textures from the artifact settings and signal precision.
+      void UpdateFormats()
+      {
+        // If we have any temporal artifact reduction we are going to double up our generated signal textures so that
+        //  two phases of the same frame can be blended together by the decoder.
+        bool wantsDouble = (artifactSettings.temporalArtifactReduction > 0.0f);
+
+        // The phases texture is only one texel per scanline so it always stays at full precision (it's not worth
+        //  losing the phase accuracy), but the signal textures can be stored as half floats if requested. None of these
+        //  get created here: they're all transients, so changing formats just means asking the pool for different
+        //  render targets at the next PlanTransients.
+        phasesFormat = wantsDouble ? TextureFormat::RG_Float32 : TextureFormat::R_Float32;
+
+        bool isHalf = (signalPrecision == SignalPrecision::Float16);
+        TextureFormat r = isHalf ? TextureFormat::R_Float16 : TextureFormat::R_Float32;
+        TextureFormat rg = isHalf ? TextureFormat::RG_Float16 : TextureFormat::RG_Float32;
+        TextureFormat rgba = isHalf ? TextureFormat::RGBA_Float16 : TextureFormat::RGBA_Float32;
+
+        signalFormat = wantsDouble
+          ? ((signalProps.type == SignalType::SVideo) ? rgba : rg)
+          : ((signalProps.type == SignalType::SVideo) ? rg : r);
+      }
+
+
       void GeneratePhasesTexture()
       {
+        ScopedStage stage(device, StageID::GeneratePhasesTexture);
+
         // Update our scanline phases texture
         generateSignalConstantBuffer->Update(
           GeneratePhaseTextureConstantData{
@@ -174,38 +367,76 @@ namespace CathodeRetro
             k_signalSamplesPerColorCycle,
             artifactSettings.instabilityScale,
             noiseSeed,
-            signalTexture->Width(),
-            signalTexture->Height(),
+            signalProps.scanlineWidth,
+            signalProps.scanlineCount,
           });
 
         device->RenderQuad(
           ShaderID::Generator_GeneratePhaseTexture,
-          phasesTexture.get(),
+          transientPool->Target(phasesTarget),
           {},
           generateSignalConstantBuffer.get());
       }
 
 
-      void GenerateCleanSignal(const ITexture *rgbTexture)
+      void GenerateCleanSignal(const ITexture *inputTexture)
       {
-        // Now run the actual shader
-        generateSignalConstantBuffer->Update(
-          RGBToSVideoConstantData{
-            k_signalSamplesPerColorCycle,
-            rgbTexture->Width(),
-            signalTexture->Width(),
-            signalTexture->Height(),
-            (signalProps.type == SignalType::Composite) ? 1.0f : 0.0f,
-            artifactSettings.instabilityScale,
-            noiseSeed,
-            signalProps.totalSidePaddingTexelCount,
-          });
+        ScopedStage stage(device, StageID::GenerateCleanSignal);
 
-        device->RenderQuad(
-          ShaderID::Generator_RGBToSVideoOrComposite,
-          signalTexture.get(),
-          {{rgbTexture, SamplerType::LinearClamp}, {phasesTexture.get(), SamplerType::NearestClamp}},
-          generateSignalConstantBuffer.get());
+        // Now run the actual shader
+        RGBToSVideoConstantData constants = {
+          k_signalSamplesPerColorCycle,
+          inputTexture->Width(),
+          signalProps.scanlineWidth,
+          signalProps.scanlineCount,
+          (signalProps.type == SignalType::Composite) ? 1.0f : 0.0f,
+          artifactSettings.instabilityScale,
+          noiseSeed,
+          signalProps.totalSidePaddingTexelCount,
+        };
+
+        if (IsIndexed())
+        {
+          assert(inputTexture->Format() == TextureFormat::R_Unorm8);
+          if (isPaletteSignalTableDirty)
+          {
+            paletteTableConstantBuffer->Update(paletteConstants);
+            device->RenderQuad(
+              ShaderID::Generator_GeneratePaletteSignalTable,
+              paletteSignalTable.get(),
+              {},
+              paletteTableConstantBuffer.get());
+            isPaletteSignalTableDirty = false;
+          }
+
+          generateSignalConstantBuffer->Update(
+            IndexedToSVideoConstantData{
+              constants,
+              paletteConstants.paletteColorCount,
+              paletteConstants.phaseStepCount,
+            });
+          device->RenderQuad(
+            ShaderID::Generator_IndexedToSVideoOrComposite,
+            RenderTargetView(transientPool->Target(cleanSignalTarget), cleanSignalRegion),
+            {
+              {inputTexture, SamplerType::NearestClamp},
+              {transientPool->Target(phasesTarget), SamplerType::NearestClamp},
+              {paletteSignalTable.get(), SamplerType::LinearWrap},
+            },
+            generateSignalConstantBuffer.get());
+        }
+        else
+        {
+          generateSignalConstantBuffer->Update(constants);
+          device->RenderQuad(
+            ShaderID::Generator_RGBToSVideoOrComposite,
+            RenderTargetView(transientPool->Target(cleanSignalTarget), cleanSignalRegion),
+            {
+              {inputTexture, SamplerType::LinearClamp},
+              {transientPool->Target(phasesTarget), SamplerType::NearestClamp},
+            },
+            generateSignalConstantBuffer.get());
+        }
 
         levels.temporalArtifactReduction = artifactSettings.temporalArtifactReduction;
         levels.blackLevel = 0.0f;
@@ -216,6 +447,8 @@ namespace CathodeRetro
 
       void ApplyArtifacts()
       {
+        ScopedStage stage(device, StageID::ApplyArtifacts);
+
         applyArtifactsConstantBuffer->Update(
           ApplyArtifactsConstantData {
             artifactSettings.ghostVisibility,
@@ -225,22 +458,23 @@ namespace CathodeRetro
             artifactSettings.noiseStrength,
             noiseSeed,
 
-            scratchSignalTexture->Width(),
-            scratchSignalTexture->Height(),
+            signalProps.scanlineWidth,
+            signalProps.scanlineCount,
             k_signalSamplesPerColorCycle,
           });
 
         device->RenderQuad(
           ShaderID::Generator_ApplyArtifacts,
-          scratchSignalTexture.get(),
-          {{signalTexture.get(), SamplerType::LinearClamp}},
+          RenderTargetView(transientPool->Target(signalTarget), signalRegion),
+          {{transientPool->Target(cleanSignalTarget), SamplerType::LinearClamp}},
           applyArtifactsConstantBuffer.get());
-
-        // Our output is the new signal texture so swap scratch into place.
-        std::swap(signalTexture, scratchSignalTexture);
       }
 
 
+      bool HasArtifacts() const
+        { return artifactSettings.noiseStrength > 0.0f || artifactSettings.ghostVisibility > 0.0f; }
+
+
       IGraphicsDevice *device;
 
       uint32_t noiseSeed = 0;
@@ -248,16 +482,36 @@ namespace CathodeRetro
       std::unique_ptr<IConstantBuffer> generateSignalConstantBuffer;
       std::unique_ptr<IConstantBuffer> applyArtifactsConstantBuffer;
 
-      std::unique_ptr<IRenderTarget> phasesTexture;
-
-      std::unique_ptr<IRenderTarget> signalTexture;
-      std::unique_ptr<IRenderTarget> scratchSignalTexture;
+      // Palette-indexed input (see SetPalette): the palette's signal table is a render target that only gets rendered
+      //  when the palette changes. paletteGeneration counts palette changes, so that frames generated with different
+      //  palettes never look the same (see NextFrameKey).
+      PaletteSignalTableConstantData paletteConstants = {};
+      std::unique_ptr<IConstantBuffer> paletteTableConstantBuffer;
+      std::unique_ptr<IRenderTarget> paletteSignalTable;
+      bool isPaletteSignalTableDirty = false;
+      uint32_t paletteGeneration = 0;
+
+      // Every texture is transient: the phases, the clean signal, and (if there are artifacts being applied) the
+      //  final signal with the artifacts added.
+      TextureFormat phasesFormat = TextureFormat::R_Float32;
+      TextureFormat signalFormat = TextureFormat::R_Float32;
+      TransientTargetPool *transientPool = nullptr;
+      TransientTargetPool::Handle phasesTarget = 0;
+      TransientTargetPool::Handle cleanSignalTarget = 0;
+      TransientTargetPool::Handle signalTarget = 0;
+
+      // The part of the signal that will be used (as given to SetOutputRegion), and the parts of the final and clean
+      //  signals that get rendered for it (see PlanTransients).
+      TexelRect outputRegion;
+      TexelRect signalRegion;
+      TexelRect cleanSignalRegion;
 
       SourceSettings sourceSettings;
       Internal::SignalProperties signalProps;
       Internal::SignalLevels levels;
 
       ArtifactSettings artifactSettings;
+      SignalPrecision signalPrecision = SignalPrecision::Float32;
 
       uint32_t frameStartPhaseNumerator = 0;
       uint32_t prevFrameStartPhaseNumerator = 0;
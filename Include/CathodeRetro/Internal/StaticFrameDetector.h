@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace CathodeRetro
+{
+  namespace Internal
+  {
+    // Fingerprints each frame's input, with one hash per scanline (to count how many scanlines changed since the
+    //  previous frame) and one for the frame as a whole (to look it up among the decoder's kept frames). The hashes
+    //  are only there to make a mismatch quick to find: a copy of the previous frame's texels is kept as well, so a
+    //  scanline whose hash matches only counts as unchanged if its texels really are the same.
+    class StaticFrameDetector
+    {
+    public:
+      // Forget the previous frame (so that every scanline of the next frame counts as changed).
+      void Reset()
+      {
+        scanlineHashes.clear();
+        frameBytes.clear();
+      }
+
+
+      // Fingerprint a frame: rowCount rows of rowByteCount bytes each, rowPitch bytes apart. Returns the hash of the
+      //  whole frame, and sets *changedScanlineCountOut to how many scanlines are different from the previous frame's.
+      uint64_t Update(
+        const void *texels,
+        size_t rowPitch,
+        size_t rowByteCount,
+        uint32_t rowCount,
+        uint32_t *changedScanlineCountOut)
+      {
+        // Any scanlines that don't line up with the old ones (because the input changed size) count as changed.
+        bool hadPreviousFrame = (scanlineHashes.size() == rowCount && frameBytes.size() == rowByteCount * rowCount);
+        scanlineHashes.resize(rowCount);
+        frameBytes.resize(rowByteCount * rowCount);
+
+        uint32_t changedCount = 0;
+        for (uint32_t y = 0; y < rowCount; y++)
+        {
+          const uint8_t *row = static_cast<const uint8_t *>(texels) + rowPitch * y;
+          uint8_t *previousRow = frameBytes.data() + rowByteCount * y;
+          uint64_t hash = HashRow(row, rowByteCount);
+          if (!hadPreviousFrame || hash != scanlineHashes[y] || memcmp(row, previousRow, rowByteCount) != 0)
+          {
+            changedCount++;
+            memcpy(previousRow, row, rowByteCount);
+          }
+
+          scanlineHashes[y] = hash;
+        }
+
+        *changedScanlineCountOut = changedCount;
+        return HashRow(reinterpret_cast<const uint8_t *>(scanlineHashes.data()), rowCount * sizeof(uint64_t));
+      }
+
+
+      // The texels of the frame last given to Update, with its rows packed together.
+      const uint8_t *FrameBytes() const
+        { return frameBytes.data(); }
+
+      size_t FrameByteCount() const
+        { return frameBytes.size(); }
+
+    private:
+      // A 64-bit multiply/xorshift hash, eight bytes at a time (this runs over every input texel every frame, so it
+      //  needs to be a lot quicker than a byte-at-a-time hash).
+      static uint64_t HashRow(const uint8_t *bytes, size_t byteCount)
+      {
+        constexpr uint64_t k_multiplier = 0x9e3779b97f4a7c15ULL;
+
+        uint64_t hash = byteCount * k_multiplier;
+        size_t i = 0;
+        for (; i + 8 <= byteCount; i += 8)
+        {
+          uint64_t word;
+          memcpy(&word, bytes + i, sizeof(word));
+          hash = (hash ^ word) * k_multiplier;
+          hash ^= hash >> 32;
+        }
+
+        if (i < byteCount)
+        {
+          uint64_t word = 0;
+          memcpy(&word, bytes + i, byteCount - i);
+          hash = (hash ^ word) * k_multiplier;
+          hash ^= hash >> 32;
+        }
+
+        return hash;
+      }
+
+
+      std::vector<uint64_t> scanlineHashes;
+      std::vector<uint8_t> frameBytes;
+    };
+  }
+}
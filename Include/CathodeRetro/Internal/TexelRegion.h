@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+
+namespace CathodeRetro
+{
+  namespace Internal
+  {
+    // Clamp a region to a texture of the given size.
+    inline TexelRect ClampRegion(const TexelRect &region, uint32_t width, uint32_t height)
+    {
+      TexelRect clamped;
+      clamped.left = std::min(region.left, width);
+      clamped.right = std::max(clamped.left, std::min(region.right, width));
+      clamped.top = std::min(region.top, height);
+      clamped.bottom = std::max(clamped.top, std::min(region.bottom, height));
+      return clamped;
+    }
+
+
+    // Whether every texel of the inner region is also in the outer one.
+    inline bool ContainsRegion(const TexelRect &outer, const TexelRect &inner)
+    {
+      return outer.left <= inner.left && outer.top <= inner.top
+        && outer.right >= inner.right && outer.bottom >= inner.bottom;
+    }
+
+
+    // Widen a region by texelCount texels on either side horizontally (for a pass whose samples reach that far to
+    //  either side of the texel being rendered), clamped to a texture of the given width. Every pass in the signal
+    //  pipeline works a scanline at a time, so the rows never need widening.
+    inline TexelRect WidenRegion(const TexelRect &region, uint32_t texelCount, uint32_t width)
+    {
+      TexelRect widened = region;
+      widened.left = (region.left > texelCount) ? region.left - texelCount : 0;
+      widened.right = std::min(region.right + texelCount, width);
+      return widened;
+    }
+  }
+}
@@ -0,0 +1,344 @@
+// ScreenTextureCache holds on to generated textures that only depend on the screen settings and the output size (that
+//  is, the screen texture, which is expensive to generate), so that going back to a previous combination of settings
+//  or output size (resizing a window back and forth, toggling between presets, etc.) reuses the texture that was
+//  already generated rather than generating it all over again.
+//
+// Textures are looked up by a key made out of exactly the values that they are generated from (so changing a setting
+//  that doesn't affect a texture still finds the same one). The cache keeps any textures that are in use plus as many
+//  of the most recently used others as fit in its memory budget.
+//
+// Optionally, the cache can also save every texture that gets generated into a directory, and load them back out of
+//  it (in this run of the app or a later one) rather than generating them again. This requires the graphics device to
+//  implement IGraphicsDevice::ReadTexels and WriteTexels.
+//
+// One cache can be shared between any number of CathodeRetro instances that render using the same device.
+#pragma once
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+namespace CathodeRetro
+{
+  class ScreenTextureCache
+  {
+  public:
+    static constexpr size_t k_defaultMaxByteCount = 64 * 1024 * 1024;
+
+    class Entry
+    {
+    public:
+      IRenderTarget *Texture() const
+        { return texture.get(); }
+
+      // Whether the contents of the texture still need to be rendered (it was neither in the cache nor on disk). Call
+      //  MarkGenerated once they have been.
+      bool NeedsGenerate() const
+        { return !isGenerated; }
+
+      void MarkGenerated()
+      {
+        isGenerated = true;
+        needsSave = isPersistent;
+      }
+
+    private:
+      std::vector<uint8_t> key;
+      uint64_t keyHash = 0;
+      std::unique_ptr<IRenderTarget> texture;
+      size_t byteCount = 0;
+      uint64_t lastUseIndex = 0;
+      bool isGenerated = false;
+      bool isPersistent = false;
+      bool needsSave = false;
+
+      friend class ScreenTextureCache;
+    };
+
+
+    // maxByteCount is roughly how much texture memory to keep unused textures around in (textures that are in use are
+    //  kept regardless). If persistenceDirectory is not null, generated textures are saved into (and loaded from) that
+    //  directory, which must already exist.
+    explicit ScreenTextureCache(
+      IGraphicsDevice *deviceIn,
+      size_t maxByteCountIn = k_defaultMaxByteCount,
+      const char *persistenceDirectory = nullptr)
+      : device(deviceIn)
+      , maxByteCount(maxByteCountIn)
+    {
+      if (persistenceDirectory != nullptr)
+      {
+        directory = persistenceDirectory;
+        if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+        {
+          directory += '/';
+        }
+
+        isPersistent = true;
+      }
+    }
+
+
+    // This saves any textures that haven't been yet, so it must not be called between
+    //  IGraphicsDevice::BeginRendering and EndRendering.
+    ~ScreenTextureCache()
+      { SavePending(); }
+
+
+    ScreenTextureCache(const ScreenTextureCache &) = delete;
+    void operator=(const ScreenTextureCache &) = delete;
+
+
+    // Get the texture for the given key (the bytes of which should be every value that the texture's contents depend
+    //  on), creating it (and loading its contents from disk, if they're there) if it isn't already cached. If the
+    //  returned entry NeedsGenerate, the caller needs to render its contents and then call MarkGenerated.
+    // This can create a render target, so it must not be called between IGraphicsDevice::BeginRendering and
+    //  EndRendering.
+    std::shared_ptr<Entry> Acquire(
+      const void *keyData,
+      size_t keyByteCount,
+      uint32_t width,
+      uint32_t height,
+      uint32_t mipCount, // 0 means "all mip levels"
+      TextureFormat format)
+    {
+      auto keyBytes = static_cast<const uint8_t *>(keyData);
+      uint64_t hash = HashBytes(keyBytes, keyByteCount);
+      for (std::shared_ptr<Entry> &entry : entries)
+      {
+        if (entry->keyHash == hash
+          && entry->key.size() == keyByteCount
+          && memcmp(entry->key.data(), keyBytes, keyByteCount) == 0)
+        {
+          entry->lastUseIndex = ++useCounter;
+          return entry;
+        }
+      }
+
+      auto entry = std::make_shared<Entry>();
+      entry->key.assign(keyBytes, keyBytes + keyByteCount);
+      entry->keyHash = hash;
+      entry->texture = device->CreateRenderTarget(width, height, mipCount, format);
+      entry->lastUseIndex = ++useCounter;
+      entry->isPersistent = isPersistent;
+      for (uint32_t mip = 0; mip < entry->texture->MipCount(); mip++)
+      {
+        entry->byteCount += MipByteCount(entry->texture.get(), mip);
+      }
+
+      if (isPersistent)
+      {
+        entry->isGenerated = Load(entry.get());
+      }
+
+      entries.push_back(entry);
+      totalByteCount += entry->byteCount;
+      EvictUnused();
+      return entry;
+    }
+
+
+    // Save any textures that have been generated since the last call to disk (if this cache has a persistence
+    //  directory). CathodeRetro calls this before rendering each frame. This reads texels back from the graphics
+    //  device, so it must not be called between IGraphicsDevice::BeginRendering and EndRendering.
+    void SavePending()
+    {
+      for (std::shared_ptr<Entry> &entry : entries)
+      {
+        if (entry->needsSave)
+        {
+          // Whether or not this works, don't try again: if the device can't read texels back it never will.
+          entry->needsSave = false;
+          Save(entry.get());
+        }
+      }
+    }
+
+
+    // The number of textures that the cache is currently holding.
+    uint32_t TextureCount() const
+      { return uint32_t(entries.size()); }
+
+  private:
+    // Bump this whenever the way any of the cached textures get generated changes, so that files saved by an older
+    //  version don't get used.
+    static constexpr uint32_t k_fileVersion = 1;
+    static constexpr uint32_t k_fileMagic = 0x54535243; // "CRST" (in little-endian)
+
+
+    static uint64_t HashBytes(const uint8_t *bytes, size_t byteCount)
+    {
+      // 64-bit FNV-1a
+      uint64_t hash = 0xcbf29ce484222325ULL;
+      for (size_t i = 0; i < byteCount; i++)
+      {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+      }
+
+      return hash;
+    }
+
+
+    static size_t MipByteCount(const ITexture *texture, uint32_t mip)
+    {
+      size_t width = std::max(1U, texture->Width() >> mip);
+      size_t height = std::max(1U, texture->Height() >> mip);
+      return width * height * TexelByteCount(texture->Format());
+    }
+
+
+    // Drop the least recently used textures that nobody is using until we're back under budget.
+    void EvictUnused()
+    {
+      while (totalByteCount > maxByteCount)
+      {
+        size_t evictIndex = entries.size();
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+          if (entries[i].use_count() == 1
+            && (evictIndex == entries.size() || entries[i]->lastUseIndex < entries[evictIndex]->lastUseIndex))
+          {
+            evictIndex = i;
+          }
+        }
+
+        if (evictIndex == entries.size())
+        {
+          // Everything left is in use.
+          return;
+        }
+
+        if (entries[evictIndex]->needsSave)
+        {
+          Save(entries[evictIndex].get());
+        }
+
+        totalByteCount -= entries[evictIndex]->byteCount;
+        entries.erase(entries.begin() + ptrdiff_t(evictIndex));
+      }
+    }
+
+
+    std::string FilePath(const Entry *entry) const
+    {
+      // The hash is only to give the file a name: the full key is stored in the file and checked when loading.
+      char name[32];
+      snprintf(name, sizeof(name), "%016" PRIx64 ".crtex", entry->keyHash);
+      return directory + name;
+    }
+
+
+    struct FileHeader
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t keyByteCount;
+      uint32_t width;
+      uint32_t height;
+      uint32_t mipCount;
+      uint32_t format;
+    };
+
+
+    FileHeader MakeHeader(const Entry *entry) const
+    {
+      FileHeader header;
+      header.magic = k_fileMagic;
+      header.version = k_fileVersion;
+      header.keyByteCount = uint32_t(entry->key.size());
+      header.width = entry->texture->Width();
+      header.height = entry->texture->Height();
+      header.mipCount = entry->texture->MipCount();
+      header.format = uint32_t(entry->texture->Format());
+      return header;
+    }
+
+
+    // Load an entry's texture from disk, returning whether it worked.
+    bool Load(Entry *entry)
+    {
+      std::unique_ptr<FILE, decltype(&fclose)> file(fopen(FilePath(entry).c_str(), "rb"), &fclose);
+      if (file == nullptr)
+      {
+        return false;
+      }
+
+      FileHeader expected = MakeHeader(entry);
+      FileHeader header;
+      std::vector<uint8_t> key(entry->key.size());
+      if (fread(&header, sizeof(header), 1, file.get()) != 1
+        || memcmp(&header, &expected, sizeof(header)) != 0
+        || fread(key.data(), 1, key.size(), file.get()) != key.size()
+        || key != entry->key)
+      {
+        return false;
+      }
+
+      std::vector<uint8_t> texels;
+      for (uint32_t mip = 0; mip < entry->texture->MipCount(); mip++)
+      {
+        texels.resize(MipByteCount(entry->texture.get(), mip));
+        if (fread(texels.data(), 1, texels.size(), file.get()) != texels.size()
+          || !device->WriteTexels(entry->texture.get(), mip, texels.data()))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+
+    void Save(const Entry *entry)
+    {
+      std::string path = FilePath(entry);
+      std::string tempPath = path + ".tmp";
+
+      bool succeeded = false;
+      {
+        std::unique_ptr<FILE, decltype(&fclose)> file(fopen(tempPath.c_str(), "wb"), &fclose);
+        if (file == nullptr)
+        {
+          return;
+        }
+
+        FileHeader header = MakeHeader(entry);
+        succeeded = fwrite(&header, sizeof(header), 1, file.get()) == 1
+          && fwrite(entry->key.data(), 1, entry->key.size(), file.get()) == entry->key.size();
+
+        std::vector<uint8_t> texels;
+        for (uint32_t mip = 0; succeeded && mip < entry->texture->MipCount(); mip++)
+        {
+          texels.resize(MipByteCount(entry->texture.get(), mip));
+          succeeded = device->ReadTexels(entry->texture.get(), mip, texels.data())
+            && fwrite(texels.data(), 1, texels.size(), file.get()) == texels.size();
+        }
+
+        succeeded = (fclose(file.release()) == 0) && succeeded;
+      }
+
+      // Write to a temporary file and then move it into place so that nothing ever loads a partially-written file. If
+      //  the rename fails because another process already saved this texture that's fine too: it's the same texture.
+      if (!succeeded || rename(tempPath.c_str(), path.c_str()) != 0)
+      {
+        remove(tempPath.c_str());
+      }
+    }
+
+
+    IGraphicsDevice *device;
+    size_t maxByteCount;
+    size_t totalByteCount = 0;
+    std::string directory;
+    bool isPersistent = false;
+    uint64_t useCounter = 0;
+    std::vector<std::shared_ptr<Entry>> entries;
+  };
+}
@@ -23,6 +23,21 @@ namespace CathodeRetro
   };
 
 
+  enum class SignalPrecision
+  {
+    Float32,      // Store the intermediate signal textures as 32-bit floats.
+    Float16,      // Store them as 16-bit floats, halving their memory use and bandwidth at a small cost in quality.
+  };
+
+
+  enum class ChromaResolution
+  {
+    Full,         // Filter the decoded chroma (I and Q) separately for every texel of the signal.
+    Decimated,    // Filter it once per color cycle and interpolate in between. The filtered chroma can't change much
+                  //  within a color cycle anyway, so this looks nearly identical for a fraction of the work.
+  };
+
+
   enum class MaskType
   {
     SlotMask,
@@ -0,0 +1,174 @@
+// StageTimings is an optional helper for graphics devices that implement the IGraphicsDevice::BeginStage/EndStage
+//  profiling markers: the device reports how long each stage took in a given frame, and this keeps a window of recent
+//  frames around to report the min/average/99th percentile time of each stage (and of the frame as a whole).
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+namespace CathodeRetro
+{
+  class StageTimings
+  {
+  public:
+    struct Stats
+    {
+      // How many frames (of the ones in the window) this stage ran in. If this is 0 the rest of the values are 0.
+      uint32_t frameCount = 0;
+
+      double minMS = 0.0;
+      double avgMS = 0.0;
+      double p99MS = 0.0;
+    };
+
+
+    // frameWindowSize is the number of most recent frames to keep timings for.
+    explicit StageTimings(uint32_t frameWindowSizeIn = 240)
+      : frameWindowSize(std::max(1U, frameWindowSizeIn))
+      { }
+
+
+    // Start a new frame of timings. Every stage starts out as "did not run this frame".
+    void BeginFrame()
+    {
+      assert(!isInFrame);
+      isInFrame = true;
+      std::fill(std::begin(currentFrame), std::end(currentFrame), -1.0);
+    }
+
+
+    // Add time to a stage for the current frame (if a stage runs more than once in a frame, the times add together).
+    void AddStageTime(StageID stage, double milliseconds)
+    {
+      assert(isInFrame);
+      assert(stage != StageID::Count);
+
+      double &t = currentFrame[uint32_t(stage)];
+      t = std::max(t, 0.0) + milliseconds;
+    }
+
+
+    // Finish the current frame, adding its timings into the window (and pushing the oldest frame out if the window is
+    //  full).
+    void EndFrame()
+    {
+      assert(isInFrame);
+      isInFrame = false;
+
+      double frameTotal = 0.0;
+      for (uint32_t i = 0; i < k_stageCount; i++)
+      {
+        if (currentFrame[i] >= 0.0)
+        {
+          frameTotal += currentFrame[i];
+        }
+      }
+
+      if (frames.size() < frameWindowSize)
+      {
+        frames.emplace_back();
+      }
+
+      FrameTimes &frame = frames[nextFrameIndex];
+      std::copy(std::begin(currentFrame), std::end(currentFrame), std::begin(frame.stages));
+      frame.total = frameTotal;
+      nextFrameIndex = (nextFrameIndex + 1) % frameWindowSize;
+    }
+
+
+    // Get the stats for a given stage across all of the frames in the window that it ran in.
+    Stats GetStageStats(StageID stage) const
+    {
+      assert(stage != StageID::Count);
+
+      std::vector<double> times;
+      times.reserve(frames.size());
+      for (const FrameTimes &frame : frames)
+      {
+        if (frame.stages[uint32_t(stage)] >= 0.0)
+        {
+          times.push_back(frame.stages[uint32_t(stage)]);
+        }
+      }
+
+      return CalculateStats(&times);
+    }
+
+
+    // Get the stats for the sum of every stage's time, per frame.
+    Stats GetFrameStats() const
+    {
+      std::vector<double> times;
+      times.reserve(frames.size());
+      for (const FrameTimes &frame : frames)
+      {
+        times.push_back(frame.total);
+      }
+
+      return CalculateStats(&times);
+    }
+
+
+    // The number of frames currently in the window.
+    uint32_t FrameCount() const
+      { return uint32_t(frames.size()); }
+
+
+    // Throw out all of the accumulated frames.
+    void Reset()
+    {
+      assert(!isInFrame);
+      frames.clear();
+      nextFrameIndex = 0;
+    }
+
+  private:
+    static constexpr uint32_t k_stageCount = uint32_t(StageID::Count);
+
+    struct FrameTimes
+    {
+      // Per-stage times in milliseconds, or negative if the stage did not run that frame.
+      double stages[k_stageCount];
+      double total;
+    };
+
+
+    static Stats CalculateStats(std::vector<double> *times)
+    {
+      Stats stats;
+      if (times->empty())
+      {
+        return stats;
+      }
+
+      std::sort(times->begin(), times->end());
+
+      double sum = 0.0;
+      for (double t : *times)
+      {
+        sum += t;
+      }
+
+      stats.frameCount = uint32_t(times->size());
+      stats.minMS = times->front();
+      stats.avgMS = sum / double(times->size());
+
+      // Nearest-rank percentile: the smallest time that at least 99% of the frames are at or below.
+      size_t p99Rank = (times->size() * 99 + 99) / 100;
+      stats.p99MS = (*times)[std::max<size_t>(p99Rank, 1) - 1];
+      return stats;
+    }
+
+
+    uint32_t frameWindowSize;
+    std::vector<FrameTimes> frames;
+    uint32_t nextFrameIndex = 0;
+    double currentFrame[k_stageCount] = {};
+    bool isInFrame = false;
+  };
+}
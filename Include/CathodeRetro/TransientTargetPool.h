@@ -0,0 +1,260 @@
+// TransientTargetPool hands out the intermediate ("transient") render targets that Cathode Retro only needs for part of
+//  a frame. Before each frame, every transient that the frame is going to use is requested along with the range of
+//  stages that it is live for, and then the pool assigns render targets such that any two transients with the same
+//  size and format whose lifetimes don't overlap share a single render target.
+//
+// Nothing in a transient is kept from one frame to the next, so one pool can also be shared between any number of
+//  CathodeRetro instances that render using the same device: rather than each instance holding its own set of
+//  intermediates, they all share one set per distinct input size. When several instances are planned together (see
+//  CathodeRetro::RenderBatch), each one's requests are a separate stream, and the streams never share a render target
+//  within the plan, so that a device is free to run them at the same time.
+//
+// Textures that do need to last from one frame to the next (like the previous frame's output) can also be taken out of
+//  the pool and returned to it when they're no longer needed, so that every render target that Cathode Retro uses
+//  gets recycled by size and format: turning a setting off and back on again (or switching between settings that
+//  need different formats) reuses the render targets that were already created rather than making new ones.
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+namespace CathodeRetro
+{
+  class TransientTargetPool
+  {
+  public:
+    using Handle = uint32_t;
+
+    explicit TransientTargetPool(IGraphicsDevice *deviceIn)
+      : device(deviceIn)
+      { }
+
+
+    // Start planning a frame. Any handles from the previous plan are no longer valid after this.
+    void BeginPlan()
+    {
+      assert(!isPlanning);
+      isPlanning = true;
+      requests.clear();
+      streamIndex = 0;
+    }
+
+
+    // Start another stream within the current plan. The requests made after this can share render targets with each
+    //  other, but never with a request from an earlier stream (no matter how their stages line up), since every
+    //  stream has its own timeline.
+    void BeginStream()
+    {
+      assert(isPlanning);
+      streamIndex++;
+    }
+
+
+    // Request a render target that is written for the first time in firstStage and read for the last time in
+    //  lastStage. The returned handle can be turned into a render target (using Target) once the plan is complete.
+    Handle Request(uint32_t width, uint32_t height, TextureFormat format, StageID firstStage, StageID lastStage)
+    {
+      assert(isPlanning);
+      assert(firstStage <= lastStage);
+
+      RequestInfo request;
+      request.width = width;
+      request.height = height;
+      request.format = format;
+      request.firstStage = uint32_t(firstStage);
+      request.lastStage = uint32_t(lastStage);
+      request.streamIndex = streamIndex;
+      requests.push_back(request);
+      return Handle(requests.size() - 1);
+    }
+
+
+    // Finish planning the frame, assigning a render target to every request. This will create any additional render
+    //  targets that are needed, so it must not be called between IGraphicsDevice::BeginRendering and EndRendering.
+    void EndPlan()
+    {
+      assert(isPlanning);
+      isPlanning = false;
+
+      for (PooledTarget &target : targets)
+      {
+        target.isAssigned = false;
+      }
+
+      // Hand out the render targets in order of when each request is first live (which, for a set of intervals, uses
+      //  the fewest targets possible): each request gets the first target of the right size/format that is no longer
+      //  in use by the time the request starts (and that no other stream has), or a brand new one if there isn't one.
+      std::vector<uint32_t> order(requests.size());
+      for (uint32_t i = 0; i < uint32_t(order.size()); i++)
+      {
+        order[i] = i;
+      }
+
+      std::stable_sort(
+        order.begin(),
+        order.end(),
+        [this](uint32_t a, uint32_t b) { return requests[a].firstStage < requests[b].firstStage; });
+
+      for (uint32_t requestIndex : order)
+      {
+        RequestInfo &request = requests[requestIndex];
+
+        uint32_t targetIndex = 0;
+        for (; targetIndex < uint32_t(targets.size()); targetIndex++)
+        {
+          const PooledTarget &target = targets[targetIndex];
+          if (target.renderTarget->Width() == request.width
+            && target.renderTarget->Height() == request.height
+            && target.renderTarget->Format() == request.format
+            && (!target.isAssigned
+              || (target.streamIndex == request.streamIndex && target.lastStage < request.firstStage)))
+          {
+            break;
+          }
+        }
+
+        if (targetIndex == targets.size())
+        {
+          PooledTarget target;
+          target.renderTarget = device->CreateRenderTarget(request.width, request.height, 1, request.format);
+          targets.push_back(std::move(target));
+        }
+
+        PooledTarget &target = targets[targetIndex];
+        target.isAssigned = true;
+        target.wasUsed = true;
+        target.streamIndex = request.streamIndex;
+        target.lastStage = request.lastStage;
+        request.targetIndex = targetIndex;
+      }
+    }
+
+
+    // Take a render target of the given size and format out of the pool (creating one if there isn't a spare) for the
+    //  caller to keep for as long as it likes, across any number of frames. This can only happen while planning, and
+    //  the target should be handed back with ReturnTarget once the caller is done with it.
+    std::unique_ptr<IRenderTarget> TakeTarget(uint32_t width, uint32_t height, TextureFormat format)
+    {
+      // No target has been assigned to a request yet while planning, so any of them can go.
+      assert(isPlanning);
+      for (auto iter = targets.begin(); iter != targets.end(); ++iter)
+      {
+        if (iter->renderTarget->Width() == width
+          && iter->renderTarget->Height() == height
+          && iter->renderTarget->Format() == format)
+        {
+          std::unique_ptr<IRenderTarget> renderTarget = std::move(iter->renderTarget);
+          targets.erase(iter);
+          return renderTarget;
+        }
+      }
+
+      return device->CreateRenderTarget(width, height, 1, format);
+    }
+
+
+    // Give a render target that came from TakeTarget back to the pool, for use by later plans (or TakeTarget calls).
+    //  This can happen at any time outside of rendering.
+    void ReturnTarget(std::unique_ptr<IRenderTarget> renderTarget)
+    {
+      if (renderTarget != nullptr)
+      {
+        PooledTarget target;
+        target.renderTarget = std::move(renderTarget);
+        target.wasUsed = true;
+        targets.push_back(std::move(target));
+      }
+    }
+
+
+    // Get the render target that was assigned to the given request in the current plan.
+    IRenderTarget *Target(Handle handle) const
+    {
+      assert(!isPlanning);
+      assert(handle < requests.size());
+      return targets[requests[handle].targetIndex].renderTarget.get();
+    }
+
+
+    // Destroy every render target that has not been handed out by a plan (or returned to the pool) in the last
+    //  keepUnusedCallCount + 1 calls to ReleaseUnused, so with the default of 0 that's anything that has not been used
+    //  since the previous call. A CathodeRetro instance that owns its pool calls this after planning each frame
+    //  (keeping targets around for a little while, so that a setting that gets switched off and back on doesn't
+    //  cause them to be recreated), but if the pool is shared it is up to the owner to call it every so often (for
+    //  instance, once all of the instances have rendered for a frame), otherwise render targets that no instance needs
+    //  anymore will stick around.
+    void ReleaseUnused(uint32_t keepUnusedCallCount = 0)
+    {
+      assert(!isPlanning);
+
+      // Remapping the indices of any assigned targets keeps the handles of the current plan valid.
+      std::vector<uint32_t> remap(targets.size());
+      uint32_t keptCount = 0;
+      for (uint32_t i = 0; i < uint32_t(targets.size()); i++)
+      {
+        remap[i] = keptCount;
+        targets[i].unusedCallCount = targets[i].wasUsed ? 0 : targets[i].unusedCallCount + 1;
+        if (targets[i].unusedCallCount <= keepUnusedCallCount)
+        {
+          targets[i].wasUsed = false;
+          if (keptCount != i)
+          {
+            targets[keptCount] = std::move(targets[i]);
+          }
+
+          keptCount++;
+        }
+      }
+
+      targets.resize(keptCount);
+      for (RequestInfo &request : requests)
+      {
+        request.targetIndex = remap[request.targetIndex];
+      }
+    }
+
+
+    // The number of render targets that the pool currently holds (not counting any that have been taken out of it).
+    uint32_t TargetCount() const
+      { return uint32_t(targets.size()); }
+
+  private:
+    struct RequestInfo
+    {
+      uint32_t width;
+      uint32_t height;
+      TextureFormat format;
+      uint32_t firstStage;
+      uint32_t lastStage;
+      uint32_t streamIndex;
+      uint32_t targetIndex = 0;
+    };
+
+    struct PooledTarget
+    {
+      std::unique_ptr<IRenderTarget> renderTarget;
+
+      // Whether this target has been handed out to a request in the current plan and, if so, the stream that it
+      //  belongs to and the last stage that that request (the latest of them, if there are multiple) needs it for.
+      bool isAssigned = false;
+      uint32_t streamIndex = 0;
+      uint32_t lastStage = 0;
+
+      // Whether any plan has handed this target out (or it was returned to the pool) since the last ReleaseUnused
+      //  call, and otherwise how many calls in a row it has gone unused for.
+      bool wasUsed = false;
+      uint32_t unusedCallCount = 0;
+    };
+
+    IGraphicsDevice *device;
+    std::vector<RequestInfo> requests;
+    std::vector<PooledTarget> targets;
+    uint32_t streamIndex = 0;
+    bool isPlanning = false;
+  };
+}
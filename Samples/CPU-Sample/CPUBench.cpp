@@ -0,0 +1,972 @@
+// A benchmark for the CPU backend: it runs the full Cathode Retro pipeline over the matrix of source, artifact, and
+//  screen presets from SettingPresets.h at a set of input sizes, as well as every shader pass on its own, and reports
+//  ns/pixel, frames (or passes) per second, and an estimate of the bytes moved. Results are printed as a table and
+//  can also be written out as JSON so that runs from different commits can be diffed.
+//
+// "Bytes moved" counts every texel of every texture view that a pass reads from plus every texel that it writes to
+//  (in their native formats). It is not a measurement of actual memory traffic (which caching and pass fusion will
+//  reduce), but it is consistent from run to run.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CathodeRetro/CathodeRetro.h"
+#include "CathodeRetro/SettingPresets.h"
+
+#include "CPUGraphicsDevice.h"
+
+
+template <typename T, size_t N>
+constexpr uint32_t ArrayLength(const T (&)[N])
+  { return uint32_t(N); }
+
+
+static const char *ShaderName(CathodeRetro::ShaderID id)
+{
+  using CathodeRetro::ShaderID;
+  switch (id)
+  {
+    case ShaderID::Util_Copy: return "Util_Copy";
+    case ShaderID::Util_Downsample2X: return "Util_Downsample2X";
+    case ShaderID::Util_TonemapAndDownsample: return "Util_TonemapAndDownsample";
+    case ShaderID::Util_GaussianBlur13: return "Util_GaussianBlur13";
+    case ShaderID::Generator_GeneratePhaseTexture: return "Generator_GeneratePhaseTexture";
+    case ShaderID::Generator_RGBToSVideoOrComposite: return "Generator_RGBToSVideoOrComposite";
+    case ShaderID::Generator_IndexedToSVideoOrComposite: return "Generator_IndexedToSVideoOrComposite";
+    case ShaderID::Generator_GeneratePaletteSignalTable: return "Generator_GeneratePaletteSignalTable";
+    case ShaderID::Generator_ApplyArtifacts: return "Generator_ApplyArtifacts";
+    case ShaderID::Decoder_CompositeToSVideo: return "Decoder_CompositeToSVideo";
+    case ShaderID::Decoder_SVideoToModulatedChroma: return "Decoder_SVideoToModulatedChroma";
+    case ShaderID::Decoder_SVideoToRGB: return "Decoder_SVideoToRGB";
+    case ShaderID::Decoder_SVideoToDecimatedIQ: return "Decoder_SVideoToDecimatedIQ";
+    case ShaderID::Decoder_SVideoAndDecimatedIQToRGB: return "Decoder_SVideoAndDecimatedIQToRGB";
+    case ShaderID::Decoder_FilterRGB: return "Decoder_FilterRGB";
+    case ShaderID::CRT_GenerateScreenTexture: return "CRT_GenerateScreenTexture";
+    case ShaderID::CRT_GenerateDistortionTexture: return "CRT_GenerateDistortionTexture";
+    case ShaderID::CRT_GenerateSlotMask: return "CRT_GenerateSlotMask";
+    case ShaderID::CRT_GenerateShadowMask: return "CRT_GenerateShadowMask";
+    case ShaderID::CRT_GenerateApertureGrille: return "CRT_GenerateApertureGrille";
+    case ShaderID::CRT_RGBToCRT: return "CRT_RGBToCRT";
+  }
+
+  return "Unknown";
+}
+
+
+static constexpr uint32_t k_shaderCount = uint32_t(CathodeRetro::ShaderID::Decoder_SVideoAndDecimatedIQToRGB) + 1;
+
+
+// The byte count of everything that a view of a texture can see (a single mip level, or all of them).
+static size_t ViewByteCount(const CathodeRetro::ITexture *texture, int32_t mipLevel)
+{
+  auto cpuTexture = static_cast<const CPUTexture *>(texture);
+  if (mipLevel < 0)
+  {
+    return cpuTexture->ByteCount();
+  }
+
+  return cpuTexture->MipRowPitch(uint32_t(mipLevel)) * cpuTexture->MipHeight(uint32_t(mipLevel));
+}
+
+
+// A constant buffer that keeps a copy of its most recent contents, so that a captured pass can be replayed later.
+class RecordingConstantBuffer : public CathodeRetro::IConstantBuffer
+{
+public:
+  explicit RecordingConstantBuffer(std::unique_ptr<CathodeRetro::IConstantBuffer> &&innerIn)
+    : inner(std::move(innerIn))
+    { }
+
+  void Update(const void *data, size_t dataSize) override
+  {
+    contents.assign(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + dataSize);
+    inner->Update(data, dataSize);
+  }
+
+  CathodeRetro::IConstantBuffer *Inner() const
+    { return inner.get(); }
+
+  const std::vector<uint8_t> &Contents() const
+    { return contents; }
+
+private:
+  std::unique_ptr<CathodeRetro::IConstantBuffer> inner;
+  std::vector<uint8_t> contents;
+};
+
+
+// A RenderQuad call, with everything needed to issue it again.
+struct CapturedPass
+{
+  CathodeRetro::ShaderID shaderID;
+  uint32_t permutation;
+  CathodeRetro::RenderTargetView output;
+  std::vector<CathodeRetro::ShaderResourceView> inputs;
+  std::vector<uint8_t> constants;
+  size_t bytesMoved;
+};
+
+
+// Sits between Cathode Retro and the CPU device to count the bytes moved by every pass and (optionally) capture the
+//  passes for replaying later.
+class BenchDevice : public CathodeRetro::IGraphicsDevice
+{
+public:
+  explicit BenchDevice(CPUGraphicsDevice *innerIn)
+    : inner(innerIn)
+    { }
+
+
+  void SetCapture(std::vector<CapturedPass> *captureIn)
+    { capture = captureIn; }
+
+  size_t BytesMoved() const
+    { return bytesMoved; }
+
+  void ResetBytesMoved()
+    { bytesMoved = 0; }
+
+
+  std::unique_ptr<CathodeRetro::IRenderTarget> CreateRenderTarget(
+    uint32_t width,
+    uint32_t height,
+    uint32_t mipCount,
+    CathodeRetro::TextureFormat format) override
+  {
+    return inner->CreateRenderTarget(width, height, mipCount, format);
+  }
+
+
+  std::unique_ptr<CathodeRetro::IConstantBuffer> CreateConstantBuffer(size_t size) override
+    { return std::make_unique<RecordingConstantBuffer>(inner->CreateConstantBuffer(size)); }
+
+  void BeginRendering() override
+    { inner->BeginRendering(); }
+
+  void EndRendering() override
+    { inner->EndRendering(); }
+
+
+  void RenderQuad(
+    CathodeRetro::ShaderID shaderID,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer = nullptr) override
+  {
+    RenderQuadPermutation(shaderID, CathodeRetro::k_rgbToCRTAllFeatures, output, inputs, constantBuffer);
+  }
+
+
+  bool SupportsShaderPermutations() const override
+    { return inner->SupportsShaderPermutations(); }
+
+
+  void RenderQuadPermutation(
+    CathodeRetro::ShaderID shaderID,
+    uint32_t permutation,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer = nullptr) override
+  {
+    auto recordingBuffer = static_cast<RecordingConstantBuffer *>(constantBuffer);
+
+    size_t passBytes = ViewByteCount(output.texture, int32_t(output.mipLevel));
+    for (auto &input : inputs)
+    {
+      passBytes += ViewByteCount(input.texture, input.mipLevel);
+    }
+
+    bytesMoved += passBytes;
+
+    if (capture != nullptr)
+    {
+      capture->push_back({
+        shaderID,
+        permutation,
+        output,
+        inputs,
+        (recordingBuffer != nullptr) ? recordingBuffer->Contents() : std::vector<uint8_t>(),
+        passBytes});
+    }
+
+    inner->RenderQuadPermutation(
+      shaderID,
+      permutation,
+      output,
+      inputs,
+      (recordingBuffer != nullptr) ? recordingBuffer->Inner() : nullptr);
+  }
+
+private:
+  CPUGraphicsDevice *inner;
+  std::vector<CapturedPass> *capture = nullptr;
+  size_t bytesMoved = 0;
+};
+
+
+struct Size
+{
+  uint32_t width;
+  uint32_t height;
+};
+
+
+struct ShaderResult
+{
+  Size inputSize;
+  CathodeRetro::ShaderID shaderID;
+  uint32_t outputWidth;
+  uint32_t outputHeight;
+  double nsPerPixel;
+  double passesPerSecond;
+  size_t bytesPerPass;
+};
+
+
+struct PipelineResult
+{
+  Size inputSize;
+  uint32_t sourcePreset;
+  uint32_t artifactPreset;
+  uint32_t screenPreset;
+  double nsPerPixel;
+  double framesPerSecond;
+  size_t bytesPerFrame;
+};
+
+
+struct BenchOptions
+{
+  std::vector<Size> inputSizes = {{256, 240}, {320, 200}, {640, 480}};
+  Size outputSize = {1920, 1080};
+  CathodeRetro::SignalType signalType = CathodeRetro::SignalType::Composite;
+  CathodeRetro::SignalPrecision signalPrecision = CathodeRetro::SignalPrecision::Float32;
+  CathodeRetro::ChromaResolution chromaResolution = CathodeRetro::ChromaResolution::Full;
+  std::vector<uint32_t> sourcePresets;
+  std::vector<uint32_t> artifactPresets;
+  std::vector<uint32_t> screenPresets;
+  uint32_t frameCount = 3;
+  uint32_t streamCount = 1;
+  double minShaderMilliseconds = 100.0;
+  uint32_t threadCount = 0;
+  uint32_t rowsPerTile = 8; // Fixed by default so that the timings don't include the auto mode's tuning frames.
+  const char *jsonPath = nullptr;
+  bool checkSIMD = false;
+  bool indexedInput = false;
+};
+
+
+// Make an input image with some color bars, edges, and gradients in it (the content doesn't much matter for timing
+//  but it's nice for it to look like a real image with plenty of color transitions).
+static std::vector<uint32_t> MakeTestPattern(uint32_t width, uint32_t height)
+{
+  static constexpr uint32_t k_bars[] =
+    { 0xFFFFFFFF, 0xFF00FFFF, 0xFFFFFF00, 0xFF00FF00, 0xFFFF00FF, 0xFF0000FF, 0xFFFF0000, 0xFF000000 };
+
+  std::vector<uint32_t> texels(size_t(width) * height);
+  for (uint32_t y = 0; y < height; y++)
+  {
+    for (uint32_t x = 0; x < width; x++)
+    {
+      uint32_t texel;
+      if (y < height * 2 / 3)
+      {
+        texel = k_bars[x * ArrayLength(k_bars) / width];
+      }
+      else
+      {
+        uint32_t r = x * 255 / std::max(1U, width - 1);
+        uint32_t g = (y * 255 / std::max(1U, height - 1)) ^ ((x & 8) ? 0x40 : 0x00);
+        uint32_t b = 255 - r;
+        texel = 0xFF000000 | (b << 16) | (g << 8) | r;
+      }
+
+      texels[size_t(y) * width + x] = texel;
+    }
+  }
+
+  return texels;
+}
+
+
+// Reduce a test pattern to palette indices, using a 3-3-2 bit RGB palette (so every index maps straight to a color).
+static std::vector<uint8_t> MakeIndexedTestPattern(
+  const std::vector<uint32_t> &pattern,
+  std::vector<uint32_t> *paletteOut)
+{
+  paletteOut->resize(256);
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t r = ((i >> 5) & 7) * 255 / 7;
+    uint32_t g = ((i >> 2) & 7) * 255 / 7;
+    uint32_t b = (i & 3) * 255 / 3;
+    (*paletteOut)[i] = 0xFF000000 | (b << 16) | (g << 8) | r;
+  }
+
+  std::vector<uint8_t> indices(pattern.size());
+  for (size_t i = 0; i < pattern.size(); i++)
+  {
+    uint32_t texel = pattern[i];
+    indices[i] = uint8_t((texel & 0xE0) | ((texel >> 11) & 0x1C) | ((texel >> 22) & 0x03));
+  }
+
+  return indices;
+}
+
+
+static std::string SizeString(Size size)
+  { return std::to_string(size.width) + "x" + std::to_string(size.height); }
+
+
+// Replay a single captured pass over and over (each in its own BeginRendering/EndRendering pair, so that nothing gets
+//  fused with it) for at least the given amount of time.
+static ShaderResult TimeCapturedPass(CPUGraphicsDevice *device, const CapturedPass &pass, double minMilliseconds)
+{
+  std::unique_ptr<CathodeRetro::IConstantBuffer> constantBuffer;
+  if (!pass.constants.empty())
+  {
+    constantBuffer = device->CreateConstantBuffer(pass.constants.size());
+    constantBuffer->Update(pass.constants.data(), pass.constants.size());
+  }
+
+  auto replay = [&]
+  {
+    device->BeginRendering();
+    switch (pass.inputs.size())
+    {
+      case 0:
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {},
+          constantBuffer.get());
+        break;
+      case 1:
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {pass.inputs[0]},
+          constantBuffer.get());
+        break;
+      case 2:
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {pass.inputs[0], pass.inputs[1]},
+          constantBuffer.get());
+        break;
+      case 3:
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {pass.inputs[0], pass.inputs[1], pass.inputs[2]},
+          constantBuffer.get());
+        break;
+      case 4:
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {pass.inputs[0], pass.inputs[1], pass.inputs[2], pass.inputs[3]},
+          constantBuffer.get());
+        break;
+      default:
+        assert(pass.inputs.size() == 5);
+        device->RenderQuadPermutation(
+          pass.shaderID,
+          pass.permutation,
+          pass.output,
+          {pass.inputs[0], pass.inputs[1], pass.inputs[2], pass.inputs[3], pass.inputs[4]},
+          constantBuffer.get());
+        break;
+    }
+    device->EndRendering();
+  };
+
+  replay(); // Warm up.
+
+  uint32_t iterationCount = 0;
+  double elapsedMilliseconds = 0.0;
+  auto startTime = std::chrono::steady_clock::now();
+  do
+  {
+    replay();
+    iterationCount++;
+    elapsedMilliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+  } while (elapsedMilliseconds < minMilliseconds);
+
+  auto output = static_cast<const CPUTexture *>(pass.output.texture);
+  ShaderResult result = {};
+  result.shaderID = pass.shaderID;
+  result.outputWidth = output->MipWidth(pass.output.mipLevel);
+  result.outputHeight = output->MipHeight(pass.output.mipLevel);
+
+  double secondsPerPass = elapsedMilliseconds / 1000.0 / double(iterationCount);
+  result.nsPerPixel = secondsPerPass * 1e9 / (double(result.outputWidth) * double(result.outputHeight));
+  result.passesPerSecond = 1.0 / secondsPerPass;
+  result.bytesPerPass = pass.bytesMoved;
+  return result;
+}
+
+
+static void RunBenchmarks(
+  const BenchOptions &options,
+  std::vector<ShaderResult> *shaderResults,
+  std::vector<PipelineResult> *pipelineResults,
+  uint32_t *threadCountOut)
+{
+  CPUGraphicsDevice cpuDevice(options.threadCount, options.rowsPerTile);
+  BenchDevice device(&cpuDevice);
+  *threadCountOut = cpuDevice.ThreadCount();
+
+  printf(
+    "%-9s %-30s %-38s %-30s %10s %10s %14s\n",
+    "Input",
+    "Source",
+    "Artifacts",
+    "Screen",
+    "frames/s",
+    "ns/px",
+    "bytes/frame");
+
+  // Each stream renders from its own input into its own output, so that they are all independent of each other.
+  std::vector<std::unique_ptr<CathodeRetro::IRenderTarget>> outputTextures;
+  for (uint32_t i = 0; i < options.streamCount; i++)
+  {
+    outputTextures.push_back(cpuDevice.CreateRenderTarget(
+      options.outputSize.width,
+      options.outputSize.height,
+      1,
+      CathodeRetro::TextureFormat::RGBA_Unorm8));
+  }
+
+  for (Size inputSize : options.inputSizes)
+  {
+    std::vector<uint32_t> pattern = MakeTestPattern(inputSize.width, inputSize.height);
+    std::vector<uint32_t> palette;
+    std::vector<uint8_t> indexedPattern;
+    if (options.indexedInput)
+    {
+      indexedPattern = MakeIndexedTestPattern(pattern, &palette);
+    }
+
+    std::vector<std::unique_ptr<CathodeRetro::ITexture>> inputTextures;
+    for (uint32_t i = 0; i < options.streamCount; i++)
+    {
+      inputTextures.push_back(cpuDevice.CreateTexture(
+        inputSize.width,
+        inputSize.height,
+        options.indexedInput ? CathodeRetro::TextureFormat::R_Unorm8 : CathodeRetro::TextureFormat::RGBA_Unorm8,
+        options.indexedInput ? static_cast<const void *>(indexedPattern.data()) : pattern.data()));
+    }
+
+    bool shaderIsTimed[k_shaderCount] = {};
+
+    for (uint32_t sourcePreset : options.sourcePresets)
+    {
+      for (uint32_t artifactPreset : options.artifactPresets)
+      {
+        for (uint32_t screenPreset : options.screenPresets)
+        {
+          // Every stream gets its own instance, but they all share their intermediates and screen textures and are
+          //  rendered together as one batch.
+          CathodeRetro::TransientTargetPool transientPool(&device);
+          CathodeRetro::ScreenTextureCache screenTextureCache(&device);
+          std::vector<std::unique_ptr<CathodeRetro::CathodeRetro>> instances;
+          std::vector<CathodeRetro::CathodeRetro::BatchStream> streams;
+
+          CathodeRetro::ArtifactSettings artifactSettings = CathodeRetro::k_artifactPresets[artifactPreset].settings;
+
+          for (uint32_t i = 0; i < options.streamCount; i++)
+          {
+            instances.push_back(std::make_unique<CathodeRetro::CathodeRetro>(
+              &device,
+              options.signalType,
+              inputSize.width,
+              inputSize.height,
+              CathodeRetro::k_sourcePresets[sourcePreset].settings,
+              &transientPool,
+              &screenTextureCache));
+
+            instances.back()->SetOutputSize(options.outputSize.width, options.outputSize.height);
+            if (options.indexedInput)
+            {
+              instances.back()->SetPalette(reinterpret_cast<const uint8_t *>(palette.data()), uint32_t(palette.size()));
+            }
+
+            instances.back()->UpdateSettings(
+              artifactSettings,
+              CathodeRetro::TVKnobSettings(),
+              CathodeRetro::OverscanSettings(),
+              CathodeRetro::k_screenPresets[screenPreset].settings);
+            instances.back()->SetSignalPrecision(options.signalPrecision);
+            instances.back()->SetChromaResolution(options.chromaResolution);
+
+            streams.push_back({
+              instances.back().get(),
+              inputTextures[i].get(),
+              CathodeRetro::ScanlineType::Odd,
+              outputTextures[i].get()});
+          }
+
+          // The first frame also renders the screen and mask textures, which then get reused by every frame after,
+          //  so it's captured (to time the passes individually) but not timed.
+          std::vector<CapturedPass> capture;
+          device.SetCapture(&capture);
+          CathodeRetro::CathodeRetro::RenderBatch(streams.data(), options.streamCount);
+          device.SetCapture(nullptr);
+
+          device.ResetBytesMoved();
+          auto startTime = std::chrono::steady_clock::now();
+          for (uint32_t frame = 0; frame < options.frameCount; frame++)
+          {
+            for (CathodeRetro::CathodeRetro::BatchStream &stream : streams)
+            {
+              stream.scanlineType = (frame & 1) ? CathodeRetro::ScanlineType::Even : CathodeRetro::ScanlineType::Odd;
+            }
+
+            CathodeRetro::CathodeRetro::RenderBatch(streams.data(), options.streamCount);
+          }
+
+          // The timings are per stream (so per output frame), not per batch.
+          double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+          double secondsPerFrame = seconds / double(options.frameCount * options.streamCount);
+
+          PipelineResult result;
+          result.inputSize = inputSize;
+          result.sourcePreset = sourcePreset;
+          result.artifactPreset = artifactPreset;
+          result.screenPreset = screenPreset;
+          result.nsPerPixel = secondsPerFrame * 1e9
+            / (double(options.outputSize.width) * double(options.outputSize.height));
+          result.framesPerSecond = 1.0 / secondsPerFrame;
+          result.bytesPerFrame = device.BytesMoved() / (options.frameCount * options.streamCount);
+          pipelineResults->push_back(result);
+
+          printf(
+            "%-9s %-30s %-38s %-30s %10.2f %10.2f %14zu\n",
+            SizeString(inputSize).c_str(),
+            CathodeRetro::k_sourcePresets[sourcePreset].name,
+            CathodeRetro::k_artifactPresets[artifactPreset].name,
+            CathodeRetro::k_screenPresets[screenPreset].name,
+            result.framesPerSecond,
+            result.nsPerPixel,
+            result.bytesPerFrame);
+
+          // Time the first instance (at this input size) of every shader that this configuration used (the
+          //  textures that the captured passes reference are still alive as long as the instances are).
+          for (const CapturedPass &pass : capture)
+          {
+            if (!shaderIsTimed[uint32_t(pass.shaderID)])
+            {
+              shaderIsTimed[uint32_t(pass.shaderID)] = true;
+              ShaderResult shaderResult = TimeCapturedPass(&cpuDevice, pass, options.minShaderMilliseconds);
+              shaderResult.inputSize = inputSize;
+              shaderResults->push_back(shaderResult);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+
+static void PrintShaderResults(const std::vector<ShaderResult> &results)
+{
+  printf("\n%-9s %-34s %-11s %12s %12s %14s\n", "Input", "Shader", "Output", "ns/px", "passes/s", "bytes/pass");
+  for (const ShaderResult &r : results)
+  {
+    printf(
+      "%-9s %-34s %-11s %12.3f %12.2f %14zu\n",
+      SizeString(r.inputSize).c_str(),
+      ShaderName(r.shaderID),
+      SizeString({r.outputWidth, r.outputHeight}).c_str(),
+      r.nsPerPixel,
+      r.passesPerSecond,
+      r.bytesPerPass);
+  }
+}
+
+
+static std::string JSONString(const char *s)
+{
+  std::string out = "\"";
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '"' || *s == '\\')
+    {
+      out += '\\';
+    }
+
+    out += *s;
+  }
+
+  return out + "\"";
+}
+
+
+static void WriteJSON(
+  const char *path,
+  const BenchOptions &options,
+  uint32_t threadCount,
+  const std::vector<ShaderResult> &shaderResults,
+  const std::vector<PipelineResult> &pipelineResults)
+{
+  std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path, "w"), &fclose);
+  if (file == nullptr)
+  {
+    throw std::runtime_error(std::string("Could not open ") + path + " for writing");
+  }
+
+  FILE *f = file.get();
+  fprintf(f, "{\n");
+  fprintf(f, "  \"threadCount\": %u,\n", threadCount);
+  if (options.rowsPerTile == CPUGraphicsDevice::k_autoRowsPerTile)
+  {
+    fprintf(f, "  \"rowsPerTile\": \"auto\",\n");
+  }
+  else
+  {
+    fprintf(f, "  \"rowsPerTile\": %u,\n", options.rowsPerTile);
+  }
+
+  fprintf(
+    f,
+    "  \"yiqInstructionSet\": \"%s\",\n",
+    CPUYIQKernels::InstructionSetName(CPUYIQKernels::ActiveInstructionSet()));
+  fprintf(f, "  \"outputSize\": \"%s\",\n", SizeString(options.outputSize).c_str());
+  fprintf(f, "  \"framesPerConfiguration\": %u,\n", options.frameCount);
+  fprintf(f, "  \"streamsPerBatch\": %u,\n", options.streamCount);
+  fprintf(
+    f,
+    "  \"signalPrecision\": \"%s\",\n",
+    (options.signalPrecision == CathodeRetro::SignalPrecision::Float16) ? "float16" : "float32");
+  fprintf(
+    f,
+    "  \"chromaResolution\": \"%s\",\n",
+    (options.chromaResolution == CathodeRetro::ChromaResolution::Decimated) ? "decimated" : "full");
+  fprintf(f, "  \"indexedInput\": %s,\n", options.indexedInput ? "true" : "false");
+
+  fprintf(f, "  \"shaders\": [\n");
+  for (size_t i = 0; i < shaderResults.size(); i++)
+  {
+    const ShaderResult &r = shaderResults[i];
+    fprintf(
+      f,
+      "    {\"inputSize\": \"%s\", \"shader\": %s, \"outputSize\": \"%s\", \"nsPerPixel\": %.4f, "
+        "\"passesPerSecond\": %.4f, \"bytesPerPass\": %zu}%s\n",
+      SizeString(r.inputSize).c_str(),
+      JSONString(ShaderName(r.shaderID)).c_str(),
+      SizeString({r.outputWidth, r.outputHeight}).c_str(),
+      r.nsPerPixel,
+      r.passesPerSecond,
+      r.bytesPerPass,
+      (i + 1 < shaderResults.size()) ? "," : "");
+  }
+
+  fprintf(f, "  ],\n");
+
+  fprintf(f, "  \"pipeline\": [\n");
+  for (size_t i = 0; i < pipelineResults.size(); i++)
+  {
+    const PipelineResult &r = pipelineResults[i];
+    fprintf(
+      f,
+      "    {\"inputSize\": \"%s\", \"source\": %s, \"artifacts\": %s, \"screen\": %s, \"nsPerPixel\": %.4f, "
+        "\"framesPerSecond\": %.4f, \"bytesPerFrame\": %zu}%s\n",
+      SizeString(r.inputSize).c_str(),
+      JSONString(CathodeRetro::k_sourcePresets[r.sourcePreset].name).c_str(),
+      JSONString(CathodeRetro::k_artifactPresets[r.artifactPreset].name).c_str(),
+      JSONString(CathodeRetro::k_screenPresets[r.screenPreset].name).c_str(),
+      r.nsPerPixel,
+      r.framesPerSecond,
+      r.bytesPerFrame,
+      (i + 1 < pipelineResults.size()) ? "," : "");
+  }
+
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+}
+
+
+// Parse a comma-separated list of preset indices (or "all").
+static bool ParseIndexList(const char *s, uint32_t count, std::vector<uint32_t> *out)
+{
+  out->clear();
+  if (strcmp(s, "all") == 0)
+  {
+    for (uint32_t i = 0; i < count; i++)
+    {
+      out->push_back(i);
+    }
+
+    return true;
+  }
+
+  while (*s != '\0')
+  {
+    char *end;
+    unsigned long value = strtoul(s, &end, 10);
+    if (end == s || value >= count)
+    {
+      return false;
+    }
+
+    out->push_back(uint32_t(value));
+    s = (*end == ',') ? end + 1 : end;
+  }
+
+  return !out->empty();
+}
+
+
+// Parse the name of an instruction set for the YIQ kernels (see CPUYIQKernels.h).
+static bool ParseInstructionSet(const char *s, CPUYIQKernels::InstructionSet *out)
+{
+  for (uint32_t i = 0; i < CPUYIQKernels::k_instructionSetCount; i++)
+  {
+    if (strcmp(s, CPUYIQKernels::InstructionSetName(CPUYIQKernels::InstructionSet(i))) == 0)
+    {
+      *out = CPUYIQKernels::InstructionSet(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+// Check every supported vector version of the YIQ kernels against the scalar math, returning whether they all match
+//  closely enough.
+static bool CheckSIMD()
+{
+  bool allPassed = true;
+  for (uint32_t i = 0; i < CPUYIQKernels::k_instructionSetCount; i++)
+  {
+    auto set = CPUYIQKernels::InstructionSet(i);
+    float maxError = CPUYIQKernels::ValidateKernels(set);
+    if (maxError < 0.0f)
+    {
+      printf("%-8s not supported\n", CPUYIQKernels::InstructionSetName(set));
+      continue;
+    }
+
+    bool passed = (maxError <= CPUYIQKernels::k_maxVectorError);
+    printf("%-8s max error %.3g %s\n", CPUYIQKernels::InstructionSetName(set), maxError, passed ? "ok" : "FAILED");
+    allPassed = allPassed && passed;
+  }
+
+  return allPassed;
+}
+
+
+// Parse a comma-separated list of WxH sizes.
+static bool ParseSizeList(const char *s, std::vector<Size> *out)
+{
+  out->clear();
+  while (*s != '\0')
+  {
+    Size size;
+    int consumed = 0;
+    if (sscanf(s, "%ux%u%n", &size.width, &size.height, &consumed) != 2 || size.width == 0 || size.height == 0)
+    {
+      return false;
+    }
+
+    out->push_back(size);
+    s += consumed;
+    s = (*s == ',') ? s + 1 : s;
+  }
+
+  return !out->empty();
+}
+
+
+static void PrintUsage()
+{
+  printf(
+    "Usage: cathode-retro-cpu-bench [options]\n"
+    "  --sizes <WxH,...>       Input sizes (default 256x240,320x200,640x480)\n"
+    "  --output <W>x<H>        Output size (default 1920x1080)\n"
+    "  --signal <type>         rgb, svideo, or composite (default composite)\n"
+    "  --sources <list>        Source preset indices, comma-separated, or \"all\" (default all)\n"
+    "  --artifacts <list>      Artifact preset indices, comma-separated, or \"all\" (default all)\n"
+    "  --screens <list>        Screen preset indices, comma-separated, or \"all\" (default all)\n"
+    "  --frames <count>        Timed frames per configuration (default 3)\n"
+    "  --streams <count>       Render this many independent streams per frame as one batch (default 1)\n"
+    "  --shader-time <ms>      Minimum time to spend timing each individual shader (default 100)\n"
+    "  --threads <count>       Worker thread count (default: one per hardware thread)\n"
+    "  --tile-rows <count>     Rows per tile of work, or \"auto\" to time a few and pick the fastest (default 8)\n"
+    "  --half-precision        Store the intermediate signal textures as 16-bit floats\n"
+    "  --decimated-chroma      Decode the chroma once per color cycle and interpolate in between\n"
+    "  --indexed               Use palette-indexed input (the test pattern reduced to a 256-color palette)\n"
+    "  --simd <set>            YIQ kernels: scalar, sse4.1, avx2, avx512, or neon (default: best supported)\n"
+    "  --check-simd            Check the vector YIQ kernels against the scalar math instead of benchmarking\n"
+    "  --json <path>           Also write the results to the given JSON file\n");
+}
+
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  ParseIndexList("all", ArrayLength(CathodeRetro::k_sourcePresets), &options.sourcePresets);
+  ParseIndexList("all", ArrayLength(CathodeRetro::k_artifactPresets), &options.artifactPresets);
+  ParseIndexList("all", ArrayLength(CathodeRetro::k_screenPresets), &options.screenPresets);
+
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = (i + 1 < argc);
+    bool isValid = hasValue;
+    if (strcmp(argv[i], "--sizes") == 0 && hasValue)
+    {
+      isValid = ParseSizeList(argv[++i], &options.inputSizes);
+    }
+    else if (strcmp(argv[i], "--output") == 0 && hasValue)
+    {
+      std::vector<Size> sizes;
+      isValid = ParseSizeList(argv[++i], &sizes) && sizes.size() == 1;
+      options.outputSize = isValid ? sizes[0] : options.outputSize;
+    }
+    else if (strcmp(argv[i], "--signal") == 0 && hasValue)
+    {
+      i++;
+      if (strcmp(argv[i], "rgb") == 0)
+      {
+        options.signalType = CathodeRetro::SignalType::RGB;
+      }
+      else if (strcmp(argv[i], "svideo") == 0)
+      {
+        options.signalType = CathodeRetro::SignalType::SVideo;
+      }
+      else
+      {
+        isValid = (strcmp(argv[i], "composite") == 0);
+      }
+    }
+    else if (strcmp(argv[i], "--sources") == 0 && hasValue)
+    {
+      isValid = ParseIndexList(argv[++i], ArrayLength(CathodeRetro::k_sourcePresets), &options.sourcePresets);
+    }
+    else if (strcmp(argv[i], "--artifacts") == 0 && hasValue)
+    {
+      isValid = ParseIndexList(argv[++i], ArrayLength(CathodeRetro::k_artifactPresets), &options.artifactPresets);
+    }
+    else if (strcmp(argv[i], "--screens") == 0 && hasValue)
+    {
+      isValid = ParseIndexList(argv[++i], ArrayLength(CathodeRetro::k_screenPresets), &options.screenPresets);
+    }
+    else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+    {
+      options.frameCount = uint32_t(std::max(1, atoi(argv[++i])));
+    }
+    else if (strcmp(argv[i], "--streams") == 0 && hasValue)
+    {
+      options.streamCount = uint32_t(std::max(1, atoi(argv[++i])));
+    }
+    else if (strcmp(argv[i], "--shader-time") == 0 && hasValue)
+    {
+      options.minShaderMilliseconds = std::max(0.0, atof(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+    {
+      options.threadCount = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--tile-rows") == 0 && hasValue)
+    {
+      i++;
+      options.rowsPerTile = (strcmp(argv[i], "auto") == 0)
+        ? CPUGraphicsDevice::k_autoRowsPerTile
+        : uint32_t(std::max(1, atoi(argv[i])));
+    }
+    else if (strcmp(argv[i], "--half-precision") == 0)
+    {
+      options.signalPrecision = CathodeRetro::SignalPrecision::Float16;
+      isValid = true;
+    }
+    else if (strcmp(argv[i], "--decimated-chroma") == 0)
+    {
+      options.chromaResolution = CathodeRetro::ChromaResolution::Decimated;
+      isValid = true;
+    }
+    else if (strcmp(argv[i], "--indexed") == 0)
+    {
+      options.indexedInput = true;
+      isValid = true;
+    }
+    else if (strcmp(argv[i], "--simd") == 0 && hasValue)
+    {
+      CPUYIQKernels::InstructionSet set;
+      isValid = ParseInstructionSet(argv[++i], &set);
+      if (isValid && !CPUYIQKernels::SetInstructionSet(set))
+      {
+        fprintf(stderr, "The %s YIQ kernels are not supported on this CPU (or in this build)\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--check-simd") == 0)
+    {
+      options.checkSIMD = true;
+      isValid = true;
+    }
+    else if (strcmp(argv[i], "--json") == 0 && hasValue)
+    {
+      options.jsonPath = argv[++i];
+    }
+    else
+    {
+      isValid = false;
+    }
+
+    if (!isValid)
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  if (options.indexedInput && options.signalType == CathodeRetro::SignalType::RGB)
+  {
+    fprintf(stderr, "Palette-indexed input needs a composite or svideo signal\n");
+    return 1;
+  }
+
+  if (options.checkSIMD)
+  {
+    return CheckSIMD() ? 0 : 1;
+  }
+
+  printf("YIQ kernels: %s\n\n", CPUYIQKernels::InstructionSetName(CPUYIQKernels::ActiveInstructionSet()));
+
+  try
+  {
+    std::vector<ShaderResult> shaderResults;
+    std::vector<PipelineResult> pipelineResults;
+    uint32_t threadCount = 0;
+    RunBenchmarks(options, &shaderResults, &pipelineResults, &threadCount);
+    PrintShaderResults(shaderResults);
+
+    if (options.jsonPath != nullptr)
+    {
+      WriteJSON(options.jsonPath, options, threadCount, shaderResults, pipelineResults);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
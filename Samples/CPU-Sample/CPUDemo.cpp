@@ -0,0 +1,606 @@
+// A command-line sample that runs the full Cathode Retro pipeline on the CPU (no GPU or windowing system required):
+//  it loads a binary PPM image, renders it through Cathode Retro using the presets from SettingPresets.h, and writes
+//  the result out as another binary PPM.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CathodeRetro/CathodeRetro.h"
+#include "CathodeRetro/SettingPresets.h"
+#include "CathodeRetro/StageTimings.h"
+
+#include "CPUGraphicsDevice.h"
+
+
+template <typename T, size_t N>
+constexpr uint32_t ArrayLength(const T (&)[N])
+  { return uint32_t(N); }
+
+
+struct Image
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint32_t> rgbaTexels;
+
+  // Only filled in for palette-indexed input (see ConvertToIndexed).
+  std::vector<uint8_t> indices;
+  std::vector<uint32_t> palette;
+};
+
+
+static Image LoadPPM(const char *path)
+{
+  std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path, "rb"), &fclose);
+  if (file == nullptr)
+  {
+    throw std::runtime_error(std::string("Could not open ") + path);
+  }
+
+  char magic[3] = {};
+  uint32_t maxValue = 0;
+  Image image;
+  if (fscanf(file.get(), "%2s %u %u %u", magic, &image.width, &image.height, &maxValue) != 4
+    || strcmp(magic, "P6") != 0
+    || maxValue != 255)
+  {
+    throw std::runtime_error(std::string(path) + " is not an 8-bit binary (P6) PPM");
+  }
+
+  // Exactly one whitespace character separates the header from the texel data.
+  fgetc(file.get());
+
+  std::vector<uint8_t> rgb(size_t(image.width) * image.height * 3);
+  if (fread(rgb.data(), 1, rgb.size(), file.get()) != rgb.size())
+  {
+    throw std::runtime_error(std::string("Unexpected end of file reading ") + path);
+  }
+
+  image.rgbaTexels.resize(size_t(image.width) * image.height);
+  for (size_t i = 0; i < image.rgbaTexels.size(); i++)
+  {
+    image.rgbaTexels[i] = uint32_t(rgb[i * 3 + 0])
+      | (uint32_t(rgb[i * 3 + 1]) << 8)
+      | (uint32_t(rgb[i * 3 + 2]) << 16)
+      | 0xFF000000;
+  }
+
+  return image;
+}
+
+
+// Build a palette of the image's colors (in the order they first appear) and the index of every texel into it, for
+//  palette-indexed input. This only works for images with at most 256 distinct colors.
+static void ConvertToIndexed(Image *image)
+{
+  image->indices.resize(image->rgbaTexels.size());
+  image->palette.clear();
+  for (size_t i = 0; i < image->rgbaTexels.size(); i++)
+  {
+    uint32_t texel = image->rgbaTexels[i];
+    auto found = std::find(image->palette.begin(), image->palette.end(), texel);
+    if (found == image->palette.end())
+    {
+      if (image->palette.size() == 256)
+      {
+        throw std::runtime_error("The input image has more than 256 colors, so it can't be palette-indexed");
+      }
+
+      found = image->palette.insert(image->palette.end(), texel);
+    }
+
+    image->indices[i] = uint8_t(found - image->palette.begin());
+  }
+}
+
+
+static void SavePPM(const char *path, const CPUTexture &texture)
+{
+  assert(texture.Format() == CathodeRetro::TextureFormat::RGBA_Unorm8);
+
+  std::unique_ptr<FILE, decltype(&fclose)> file(fopen(path, "wb"), &fclose);
+  if (file == nullptr)
+  {
+    throw std::runtime_error(std::string("Could not open ") + path + " for writing");
+  }
+
+  fprintf(file.get(), "P6\n%u %u\n255\n", texture.Width(), texture.Height());
+
+  const uint8_t *rgba = texture.MipData(0);
+  std::vector<uint8_t> rgb(size_t(texture.Width()) * texture.Height() * 3);
+  for (size_t i = 0; i < size_t(texture.Width()) * texture.Height(); i++)
+  {
+    rgb[i * 3 + 0] = rgba[i * 4 + 0];
+    rgb[i * 3 + 1] = rgba[i * 4 + 1];
+    rgb[i * 3 + 2] = rgba[i * 4 + 2];
+  }
+
+  fwrite(rgb.data(), 1, rgb.size(), file.get());
+}
+
+
+static void PrintStageTimings(const CathodeRetro::StageTimings &timings)
+{
+  printf("\n%-24s %8s %10s %10s %10s\n", "Stage", "Frames", "Min (ms)", "Avg (ms)", "P99 (ms)");
+  for (uint32_t i = 0; i < uint32_t(CathodeRetro::StageID::Count); i++)
+  {
+    auto stage = CathodeRetro::StageID(i);
+    CathodeRetro::StageTimings::Stats stats = timings.GetStageStats(stage);
+    if (stats.frameCount > 0)
+    {
+      printf(
+        "%-24s %8u %10.3f %10.3f %10.3f\n",
+        CathodeRetro::StageName(stage),
+        stats.frameCount,
+        stats.minMS,
+        stats.avgMS,
+        stats.p99MS);
+    }
+  }
+
+  CathodeRetro::StageTimings::Stats frame = timings.GetFrameStats();
+  printf("%-24s %8u %10.3f %10.3f %10.3f\n\n", "Total", frame.frameCount, frame.minMS, frame.avgMS, frame.p99MS);
+}
+
+
+// Compare an output rendered with the cheaper options (the half-precision signal chain and/or decimated chroma) against
+//  the same output rendered without them, print how different the two are (in 8-bit output levels), and return the
+//  PSNR (in dB, or infinity if they are identical).
+static double PrintComparisonReport(
+  const char *description,
+  const CPUTexture &cheapOutput,
+  const CPUTexture &referenceOutput)
+{
+  assert(cheapOutput.Width() == referenceOutput.Width() && cheapOutput.Height() == referenceOutput.Height());
+
+  const uint8_t *a = cheapOutput.MipData(0);
+  const uint8_t *b = referenceOutput.MipData(0);
+  size_t channelCount = size_t(cheapOutput.Width()) * cheapOutput.Height() * 3;
+
+  uint32_t maxError = 0;
+  uint64_t errorSum = 0;
+  uint64_t squaredErrorSum = 0;
+  size_t differentCount = 0;
+  for (size_t i = 0; i < size_t(cheapOutput.Width()) * cheapOutput.Height(); i++)
+  {
+    // Only compare the color channels (alpha is always opaque).
+    for (size_t c = 0; c < 3; c++)
+    {
+      uint32_t error = uint32_t(std::abs(int32_t(a[i * 4 + c]) - int32_t(b[i * 4 + c])));
+      maxError = std::max(maxError, error);
+      errorSum += error;
+      squaredErrorSum += error * error;
+      differentCount += (error != 0) ? 1 : 0;
+    }
+  }
+
+  double meanSquaredError = double(squaredErrorSum) / double(channelCount);
+  printf("\n%s:\n", description);
+  printf("  Max error:            %u/255\n", maxError);
+  printf("  Mean error:           %.4f/255\n", double(errorSum) / double(channelCount));
+  printf("  Differing channels:   %.3f%%\n", 100.0 * double(differentCount) / double(channelCount));
+  if (meanSquaredError == 0.0)
+  {
+    printf("  PSNR:                 inf (identical)\n\n");
+    return HUGE_VAL;
+  }
+
+  double psnr = 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+  printf("  PSNR:                 %.2f dB\n\n", psnr);
+  return psnr;
+}
+
+
+static std::unique_ptr<CathodeRetro::CathodeRetro> CreateCathodeRetro(
+  CPUGraphicsDevice *device,
+  CathodeRetro::SignalType signalType,
+  const Image &image,
+  const CathodeRetro::SourceSettings &sourceSettings,
+  const CathodeRetro::ArtifactSettings &artifactSettings,
+  const CathodeRetro::OverscanSettings &overscanSettings,
+  const CathodeRetro::ScreenSettings &screenSettings,
+  uint32_t outputWidth,
+  uint32_t outputHeight,
+  CathodeRetro::ScreenTextureCache *screenTextureCache)
+{
+  auto cathodeRetro = std::make_unique<CathodeRetro::CathodeRetro>(
+    device,
+    signalType,
+    image.width,
+    image.height,
+    sourceSettings,
+    nullptr,
+    screenTextureCache);
+
+  if (!image.palette.empty())
+  {
+    cathodeRetro->SetPalette(reinterpret_cast<const uint8_t *>(image.palette.data()), uint32_t(image.palette.size()));
+  }
+
+  cathodeRetro->SetOutputSize(outputWidth, outputHeight);
+  cathodeRetro->UpdateSettings(
+    artifactSettings,
+    CathodeRetro::TVKnobSettings(),
+    overscanSettings,
+    screenSettings);
+
+  return cathodeRetro;
+}
+
+
+static void PrintUsage()
+{
+  printf(
+    "Usage: cathode-retro-cpu-sample <input.ppm> <output.ppm> [options]\n"
+    "  --size <W>x<H>          Output size (default 1920x1080)\n"
+    "  --signal <type>         rgb, svideo, or composite (default composite)\n"
+    "  --source <index>        Source preset index (default 1)\n"
+    "  --artifacts <index>     Artifact preset index (default 1)\n"
+    "  --screen <index>        Screen preset index (default 4)\n"
+    "  --overscan <L>,<R>,<T>,<B>\n"
+    "                          Input pixels of overscan to cut off of each side (default none)\n"
+    "  --frames <count>        How many frames to render (the last one is saved, default 1)\n"
+    "  --threads <count>       Worker thread count (default: one per hardware thread)\n"
+    "  --tile-rows <count>     Rows per tile of work, or \"auto\" to time a few and pick the fastest (default auto)\n"
+    "  --no-fusion             Finish each pass before starting the next instead of overlapping their tiles\n"
+    "  --profile               Print min/avg/p99 timings for each stage of the pipeline\n"
+    "  --half-precision        Store the intermediate signal textures as 16-bit floats, and report how much that\n"
+    "                          changes the output compared to the float32 path\n"
+    "  --decimated-chroma      Decode the chroma once per color cycle and interpolate in between, and report how\n"
+    "                          much that changes the output compared to the full-resolution decode\n"
+    "  --min-psnr <dB>         Fail if --half-precision or --decimated-chroma bring the output's PSNR (compared to\n"
+    "                          the full-quality output) below this\n"
+    "  --cache-dir <dir>       Save generated screen textures into (and load them back from) an existing directory\n"
+    "  --distortion-texture    Bake the screen distortion into a texture instead of calculating it every frame\n"
+    "  --static-frames         Skip the signal generation and decoding of frames that match one of the last few,\n"
+    "                          and report how many frames that was\n"
+    "  --indexed               Feed the image in as palette indices (it must have at most 256 colors)\n");
+
+  printf("\nSource presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_sourcePresets); i++)
+  {
+    printf("  %u: %s\n", i, CathodeRetro::k_sourcePresets[i].name);
+  }
+
+  printf("\nArtifact presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_artifactPresets); i++)
+  {
+    printf("  %u: %s\n", i, CathodeRetro::k_artifactPresets[i].name);
+  }
+
+  printf("\nScreen presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_screenPresets); i++)
+  {
+    printf("  %u: %s\n", i, CathodeRetro::k_screenPresets[i].name);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  const char *inputPath = argv[1];
+  const char *outputPath = argv[2];
+  uint32_t outputWidth = 1920;
+  uint32_t outputHeight = 1080;
+  CathodeRetro::SignalType signalType = CathodeRetro::SignalType::Composite;
+  uint32_t sourcePreset = 1;
+  uint32_t artifactPreset = 1;
+  uint32_t screenPreset = 4;
+  CathodeRetro::OverscanSettings overscanSettings;
+  uint32_t frameCount = 1;
+  uint32_t threadCount = 0;
+  uint32_t rowsPerTile = CPUGraphicsDevice::k_autoRowsPerTile;
+  bool enablePassFusion = true;
+  bool profile = false;
+  bool halfPrecision = false;
+  bool decimatedChroma = false;
+  double minPSNR = 0.0;
+  const char *cacheDirectory = nullptr;
+  bool useDistortionTexture = false;
+  bool useStaticFrameDetection = false;
+  bool indexed = false;
+
+  for (int i = 3; i < argc; i++)
+  {
+    bool hasValue = (i + 1 < argc);
+    if (strcmp(argv[i], "--size") == 0 && hasValue)
+    {
+      if (sscanf(argv[++i], "%ux%u", &outputWidth, &outputHeight) != 2 || outputWidth == 0 || outputHeight == 0)
+      {
+        fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--signal") == 0 && hasValue)
+    {
+      i++;
+      if (strcmp(argv[i], "rgb") == 0)
+      {
+        signalType = CathodeRetro::SignalType::RGB;
+      }
+      else if (strcmp(argv[i], "svideo") == 0)
+      {
+        signalType = CathodeRetro::SignalType::SVideo;
+      }
+      else if (strcmp(argv[i], "composite") == 0)
+      {
+        signalType = CathodeRetro::SignalType::Composite;
+      }
+      else
+      {
+        fprintf(stderr, "Unknown signal type: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--source") == 0 && hasValue)
+    {
+      sourcePreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--artifacts") == 0 && hasValue)
+    {
+      artifactPreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--screen") == 0 && hasValue)
+    {
+      screenPreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--overscan") == 0 && hasValue)
+    {
+      if (sscanf(
+          argv[++i],
+          "%u,%u,%u,%u",
+          &overscanSettings.overscanLeft,
+          &overscanSettings.overscanRight,
+          &overscanSettings.overscanTop,
+          &overscanSettings.overscanBottom) != 4)
+      {
+        fprintf(stderr, "Invalid overscan: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+    {
+      frameCount = std::max(1, atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+    {
+      threadCount = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--tile-rows") == 0 && hasValue)
+    {
+      i++;
+      rowsPerTile = (strcmp(argv[i], "auto") == 0)
+        ? CPUGraphicsDevice::k_autoRowsPerTile
+        : uint32_t(std::max(1, atoi(argv[i])));
+    }
+    else if (strcmp(argv[i], "--no-fusion") == 0)
+    {
+      enablePassFusion = false;
+    }
+    else if (strcmp(argv[i], "--profile") == 0)
+    {
+      profile = true;
+    }
+    else if (strcmp(argv[i], "--half-precision") == 0)
+    {
+      halfPrecision = true;
+    }
+    else if (strcmp(argv[i], "--decimated-chroma") == 0)
+    {
+      decimatedChroma = true;
+    }
+    else if (strcmp(argv[i], "--min-psnr") == 0 && hasValue)
+    {
+      minPSNR = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cache-dir") == 0 && hasValue)
+    {
+      cacheDirectory = argv[++i];
+    }
+    else if (strcmp(argv[i], "--distortion-texture") == 0)
+    {
+      useDistortionTexture = true;
+    }
+    else if (strcmp(argv[i], "--static-frames") == 0)
+    {
+      useStaticFrameDetection = true;
+    }
+    else if (strcmp(argv[i], "--indexed") == 0)
+    {
+      indexed = true;
+    }
+    else
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  if (sourcePreset >= ArrayLength(CathodeRetro::k_sourcePresets)
+    || artifactPreset >= ArrayLength(CathodeRetro::k_artifactPresets)
+    || screenPreset >= ArrayLength(CathodeRetro::k_screenPresets))
+  {
+    fprintf(stderr, "Preset index out of range\n");
+    return 1;
+  }
+
+  if (indexed && signalType == CathodeRetro::SignalType::RGB)
+  {
+    fprintf(stderr, "Palette-indexed input needs a composite or svideo signal\n");
+    return 1;
+  }
+
+  try
+  {
+    Image image = LoadPPM(inputPath);
+    if (indexed)
+    {
+      ConvertToIndexed(&image);
+    }
+
+    // This is what gets handed to the input texture (and to static frame detection).
+    const void *inputTexels = indexed ? static_cast<const void *>(image.indices.data()) : image.rgbaTexels.data();
+    size_t inputRowPitch = size_t(image.width) * (indexed ? sizeof(uint8_t) : sizeof(uint32_t));
+
+    CPUGraphicsDevice device(threadCount, rowsPerTile, enablePassFusion);
+    CathodeRetro::StageTimings stageTimings(frameCount);
+    if (profile)
+    {
+      device.SetStageTimings(&stageTimings);
+    }
+
+    // Both CathodeRetro instances (when there are two) share their screen textures through this.
+    CathodeRetro::ScreenTextureCache screenTextureCache(
+      &device,
+      CathodeRetro::ScreenTextureCache::k_defaultMaxByteCount,
+      cacheDirectory);
+
+    auto inputTexture = device.CreateTexture(
+      image.width,
+      image.height,
+      indexed ? CathodeRetro::TextureFormat::R_Unorm8 : CathodeRetro::TextureFormat::RGBA_Unorm8,
+      inputTexels);
+    auto outputTexture = device.CreateRenderTarget(
+      outputWidth,
+      outputHeight,
+      1,
+      CathodeRetro::TextureFormat::RGBA_Unorm8);
+
+    CathodeRetro::ArtifactSettings artifactSettings = CathodeRetro::k_artifactPresets[artifactPreset].settings;
+
+    auto cathodeRetro = CreateCathodeRetro(
+      &device,
+      signalType,
+      image,
+      CathodeRetro::k_sourcePresets[sourcePreset].settings,
+      artifactSettings,
+      overscanSettings,
+      CathodeRetro::k_screenPresets[screenPreset].settings,
+      outputWidth,
+      outputHeight,
+      &screenTextureCache);
+    cathodeRetro->SetUseDistortionTexture(useDistortionTexture);
+    cathodeRetro->SetStaticFrameDetection(useStaticFrameDetection);
+    if (halfPrecision)
+    {
+      cathodeRetro->SetSignalPrecision(CathodeRetro::SignalPrecision::Float16);
+    }
+
+    if (decimatedChroma)
+    {
+      cathodeRetro->SetChromaResolution(CathodeRetro::ChromaResolution::Decimated);
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+      // The input never changes here, so (with static frame detection on) every frame after the first few reuses an
+      //  earlier one, as long as there's no noise.
+      cathodeRetro->Render(
+        inputTexture.get(),
+        CathodeRetro::ScanlineType::Odd,
+        outputTexture.get(),
+        inputTexels,
+        inputRowPitch);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf(
+      "Rendered %u frame(s) at %ux%u on %u thread(s): %.2f ms/frame\n",
+      frameCount,
+      outputWidth,
+      outputHeight,
+      device.ThreadCount(),
+      seconds * 1000.0 / double(frameCount));
+
+    if (useStaticFrameDetection)
+    {
+      const CathodeRetro::CathodeRetro::StaticFrameStats &stats = cathodeRetro->StaticFrameDetectionStats();
+      printf(
+        "Static frames: %llu of %llu frame(s) reused an earlier decode, %llu changed scanline(s)\n",
+        (unsigned long long)stats.reusedFrameCount,
+        (unsigned long long)stats.checkedFrameCount,
+        (unsigned long long)stats.changedScanlineCount);
+    }
+
+    if (profile)
+    {
+      PrintStageTimings(stageTimings);
+    }
+
+    bool passed = true;
+    if (halfPrecision || decimatedChroma)
+    {
+      // Render the same frames again with the float32 signal chain and full-resolution chroma to see what the cheaper
+      //  options cost us. The noise and phase sequences only depend on the frame count, so the two sets of frames line
+      //  up exactly.
+      device.SetStageTimings(nullptr);
+
+      auto referenceCathodeRetro = CreateCathodeRetro(
+        &device,
+        signalType,
+        image,
+        CathodeRetro::k_sourcePresets[sourcePreset].settings,
+        artifactSettings,
+        overscanSettings,
+        CathodeRetro::k_screenPresets[screenPreset].settings,
+        outputWidth,
+        outputHeight,
+        &screenTextureCache);
+      referenceCathodeRetro->SetUseDistortionTexture(useDistortionTexture);
+      auto referenceTexture = device.CreateRenderTarget(
+        outputWidth,
+        outputHeight,
+        1,
+        CathodeRetro::TextureFormat::RGBA_Unorm8);
+
+      for (uint32_t frame = 0; frame < frameCount; frame++)
+      {
+        referenceCathodeRetro->Render(inputTexture.get(), CathodeRetro::ScanlineType::Odd, referenceTexture.get());
+      }
+
+      const char *description = !decimatedChroma
+        ? "Half-precision signal chain vs. float32"
+        : (halfPrecision
+          ? "Half-precision signal chain and decimated chroma vs. float32 and full-resolution chroma"
+          : "Decimated chroma vs. full-resolution chroma");
+      double psnr = PrintComparisonReport(
+        description,
+        *static_cast<const CPUTexture *>(outputTexture.get()),
+        *static_cast<const CPUTexture *>(referenceTexture.get()));
+
+      if (psnr < minPSNR)
+      {
+        fprintf(stderr, "PSNR of %.2f dB is below the minimum of %.2f dB\n", psnr, minPSNR);
+        passed = false;
+      }
+    }
+
+    SavePPM(outputPath, *static_cast<const CPUTexture *>(outputTexture.get()));
+    if (!passed)
+    {
+      return 1;
+    }
+  }
+  catch (const std::exception &e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,657 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+#include "CathodeRetro/StageTimings.h"
+
+#include "CPUShaders.h"
+#include "CPUTexture.h"
+#include "CPUThreadPool.h"
+
+
+// A "constant buffer" for the CPU device is just a block of bytes that the shader ports read their constants out of.
+class CPUConstantBuffer : public CathodeRetro::IConstantBuffer
+{
+public:
+  CPUConstantBuffer(size_t sizeIn)
+    : data((sizeIn + sizeof(Float4) - 1) / sizeof(Float4))
+    , size(sizeIn)
+    { }
+
+  void Update(const void *dataIn, size_t dataSize) override
+  {
+    assert(dataSize <= size);
+    memcpy(data.data(), dataIn, dataSize);
+  }
+
+  const std::vector<Float4> &Contents() const
+    { return data; }
+
+private:
+  // Stored as Float4s so that the contents are suitably aligned for any of the constant structures.
+  std::vector<Float4> data;
+  size_t size;
+};
+
+
+// An IGraphicsDevice that runs all of the Cathode Retro shaders on the CPU, using native C++ ports of the shaders (see
+//  CPUShaders.h). Every RenderQuad is split into tiles of rows which are run on a work-stealing thread pool.
+//
+// Passes are not run right away: they're queued up until the end of the frame and then run as a single graph of
+//  tiles, where each tile only waits for the tiles of earlier passes that wrote the rows it reads (see
+//  CPUShaders::InputRowRange) rather than for the whole of each earlier pass to finish. A thread that finishes a tile
+//  moves straight on to whatever tiles were waiting on it, so the intermediate textures of the signal generation and
+//  decode chain (phases, signal, S-Video, modulated chroma, RGB) are mostly read back a few rows at a time while they
+//  are still in cache, rather than each pass streaming a full texture out to memory for the next one to read back in.
+//  Passes that write to a texture that an earlier pass reads or writes still wait for all of that earlier pass. The
+//  results are identical to running the passes one at a time.
+class CPUGraphicsDevice : public CathodeRetro::IGraphicsDevice
+{
+public:
+  // Passing this as the tile height has the device time a few different tile heights for each set of passes that it
+  //  runs and then stick with the fastest.
+  static constexpr uint32_t k_autoRowsPerTile = 0;
+
+
+  // A thread count of 0 means "one thread per hardware thread". rowsPerTile is how many output rows are in each tile.
+  //  If enablePassFusion is false, every pass runs (across all threads) to completion before the next one starts.
+  CPUGraphicsDevice(
+    uint32_t threadCount = 0,
+    uint32_t rowsPerTileIn = k_autoRowsPerTile,
+    bool enablePassFusionIn = true)
+    : threadPool(threadCount)
+    , rowsPerTile(rowsPerTileIn)
+    , enablePassFusion(enablePassFusionIn)
+    { }
+
+
+  CPUGraphicsDevice(CPUGraphicsDevice &) = delete;
+  void operator=(const CPUGraphicsDevice &) = delete;
+
+
+  uint32_t ThreadCount() const
+    { return threadPool.ThreadCount(); }
+
+
+  // Create a (non-render-target) texture, optionally with initial texel data (tightly packed, in the given format).
+  std::unique_ptr<CathodeRetro::ITexture> CreateTexture(
+    uint32_t width,
+    uint32_t height,
+    CathodeRetro::TextureFormat format,
+    const void *initialDataTexels)
+  {
+    return std::make_unique<CPUTexture>(width, height, 1, format, initialDataTexels);
+  }
+
+
+  // Create a texture whose contents get replaced regularly (for instance, with each frame of a video). It holds
+  //  bufferCount copies of its texels so that the next frame can be written (say, by a decoding thread) while the
+  //  current one is still being rendered from, and swapping to the new frame is free.
+  std::unique_ptr<CathodeRetro::ITexture> CreateStreamingTexture(
+    uint32_t width,
+    uint32_t height,
+    CathodeRetro::TextureFormat format,
+    uint32_t bufferCount = 2)
+  {
+    auto texture = std::make_unique<CPUTexture>(width, height, 1, format, nullptr);
+    texture->SetBufferCount(bufferCount);
+    return texture;
+  }
+
+
+  // Get a pointer to write new contents for a texture into (rows are *rowPitchOut bytes apart, mip 0 only). The new
+  //  contents replace the old once UnmapTexture is called. Mapping can happen at any time (including from another
+  //  thread while rendering, as long as the texture is a streaming texture), but unmapping cannot happen during
+  //  rendering.
+  void *MapTexture(CathodeRetro::ITexture *texture, size_t *rowPitchOut)
+  {
+    auto cpuTexture = static_cast<CPUTexture *>(texture);
+    *rowPitchOut = cpuTexture->MipRowPitch(0);
+    return cpuTexture->Map();
+  }
+
+
+  void UnmapTexture(CathodeRetro::ITexture *texture)
+  {
+    assert(!isRendering);
+    static_cast<CPUTexture *>(texture)->Unmap();
+  }
+
+
+  // Replace the contents of a texture with the given (tightly packed) texels.
+  void UpdateTexture(CathodeRetro::ITexture *texture, const void *texels)
+  {
+    auto cpuTexture = static_cast<CPUTexture *>(texture);
+    size_t rowPitch;
+    void *dest = MapTexture(texture, &rowPitch);
+    memcpy(dest, texels, rowPitch * cpuTexture->Height());
+    UnmapTexture(texture);
+  }
+
+
+  // Have a texture read its contents directly out of caller-owned (tightly packed) texels, with no copy at all. This
+  //  lasts until the texture is next unmapped/updated, and the memory must stay valid and unchanged until then (or for
+  //  as long as the texture is rendered from).
+  void SetExternalTexels(CathodeRetro::ITexture *texture, const void *texels)
+  {
+    assert(!isRendering);
+    static_cast<CPUTexture *>(texture)->SetExternalTexels(texels);
+  }
+
+
+  // Start (or, with nullptr, stop) recording how long each stage of the pipeline takes into the given timings object,
+  //  one frame per BeginRendering/EndRendering pair. Note that while this is enabled, tiles of one stage never wait on
+  //  tiles of another (each stage runs to completion on its own, so that the time spent in it can be measured).
+  void SetStageTimings(CathodeRetro::StageTimings *timingsIn)
+  {
+    assert(!isRendering);
+    stageTimings = timingsIn;
+  }
+
+
+  // CathodeRetro::IGraphicsDevice Implementations ////////////////////////////////////////////////////////////////////
+
+
+  std::unique_ptr<CathodeRetro::IRenderTarget> CreateRenderTarget(
+    uint32_t width,
+    uint32_t height,
+    uint32_t mipCount, // 0 means "all mip levels"
+    CathodeRetro::TextureFormat format) override
+  {
+    assert(!isRendering);
+    return std::make_unique<CPUTexture>(width, height, mipCount, format, nullptr);
+  }
+
+
+  std::unique_ptr<CathodeRetro::IConstantBuffer> CreateConstantBuffer(size_t size) override
+  {
+    assert(!isRendering);
+    return std::make_unique<CPUConstantBuffer>(size);
+  }
+
+
+  void BeginRendering() override
+  {
+    // There's no render state to set up on the CPU, this just keeps us honest about matching Begin/End calls.
+    assert(!isRendering);
+    isRendering = true;
+
+    if (stageTimings != nullptr)
+    {
+      stageTimings->BeginFrame();
+    }
+  }
+
+
+  void RenderQuad(
+    CathodeRetro::ShaderID shaderID,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer = nullptr) override
+  {
+    RenderQuadPermutation(shaderID, CathodeRetro::k_rgbToCRTAllFeatures, output, inputs, constantBuffer);
+  }
+
+
+  bool SupportsShaderPermutations() const override
+    { return true; }
+
+
+  // Every permutation of every shader is compiled into the CPU port, so this just picks the right function.
+  void RenderQuadPermutation(
+    CathodeRetro::ShaderID shaderID,
+    uint32_t permutation,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer = nullptr) override
+  {
+    assert(isRendering);
+
+    if (output.texture == nullptr)
+    {
+      // There's no such thing as a backbuffer here, the caller needs to supply a render target (which they can then
+      //  read the texels out of).
+      throw std::runtime_error("CPUGraphicsDevice requires an explicit render target");
+    }
+
+    assert(inputs.size() <= CPUShaderContext::k_maxInputs);
+
+    QueuedPass pass;
+    pass.shaderID = shaderID;
+    pass.shader = CPUShaders::ShaderFromID(shaderID, permutation);
+
+    CPUShaderContext &ctx = pass.ctx;
+    ctx = {};
+    ctx.output = static_cast<CPUTexture *>(output.texture);
+    ctx.outputMip = output.mipLevel;
+    ctx.outputWidth = ctx.output->MipWidth(output.mipLevel);
+    ctx.outputHeight = ctx.output->MipHeight(output.mipLevel);
+
+    // Only the output's region gets rendered (the rest keeps whatever was in it).
+    ctx.region.left = std::min(output.region.left, ctx.outputWidth);
+    ctx.region.right = std::max(ctx.region.left, std::min(output.region.right, ctx.outputWidth));
+    ctx.region.top = std::min(output.region.top, ctx.outputHeight);
+    ctx.region.bottom = std::max(ctx.region.top, std::min(output.region.bottom, ctx.outputHeight));
+    ctx.inputCount = uint32_t(inputs.size());
+    for (uint32_t i = 0; i < ctx.inputCount; i++)
+    {
+      const CathodeRetro::ShaderResourceView &input = inputs.begin()[i];
+      ctx.inputs[i] = CPUTextureView(static_cast<const CPUTexture *>(input.texture), input.mipLevel, input.samplerType);
+    }
+
+    if (constantBuffer != nullptr)
+    {
+      // The pass might not run until after the constant buffer has been updated for something else, so it gets its
+      //  own copy of the contents.
+      pass.constants = static_cast<CPUConstantBuffer *>(constantBuffer)->Contents();
+    }
+
+    queuedPasses.push_back(std::move(pass));
+    if (!enablePassFusion)
+    {
+      FlushQueuedPasses();
+    }
+  }
+
+
+  void EndRendering() override
+  {
+    assert(isRendering);
+    FlushQueuedPasses();
+    isRendering = false;
+
+    if (stageTimings != nullptr)
+    {
+      stageTimings->EndFrame();
+    }
+  }
+
+
+  void BeginStage(CathodeRetro::StageID) override
+  {
+    if (stageTimings != nullptr)
+    {
+      FlushQueuedPasses();
+      stageStartTime = std::chrono::steady_clock::now();
+    }
+  }
+
+
+  void EndStage(CathodeRetro::StageID stage) override
+  {
+    if (stageTimings != nullptr)
+    {
+      FlushQueuedPasses();
+      stageTimings->AddStageTime(
+        stage,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stageStartTime).count());
+    }
+  }
+
+
+  bool ReadTexels(const CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, void *texelsOut) override
+  {
+    assert(!isRendering);
+    auto cpuTexture = static_cast<const CPUTexture *>(texture);
+    memcpy(
+      texelsOut,
+      cpuTexture->MipData(mipLevel),
+      cpuTexture->MipRowPitch(mipLevel) * cpuTexture->MipHeight(mipLevel));
+    return true;
+  }
+
+
+  bool WriteTexels(CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, const void *texels) override
+  {
+    assert(!isRendering);
+    auto cpuTexture = static_cast<CPUTexture *>(texture);
+    memcpy(
+      cpuTexture->MipData(mipLevel),
+      texels,
+      cpuTexture->MipRowPitch(mipLevel) * cpuTexture->MipHeight(mipLevel));
+    return true;
+  }
+
+private:
+  struct QueuedPass
+  {
+    CathodeRetro::ShaderID shaderID = CathodeRetro::ShaderID::Util_Copy;
+    CPUShaders::ShaderFunc shader = nullptr;
+    CPUShaderContext ctx = {};
+    std::vector<Float4> constants;
+  };
+
+
+  // A task in the graph is either a tile of rows of a pass, or (with rowBegin == rowEnd) a placeholder that finishes
+  //  once every tile of its pass has, for later passes that need all of it to wait on.
+  struct TileTask
+  {
+    uint32_t pass;
+    uint32_t rowBegin;
+    uint32_t rowEnd;
+  };
+
+
+  // The tiles of a pass cover its output region's rows, [firstRow, endRow).
+  struct PassTiles
+  {
+    uint32_t firstTile;
+    uint32_t tileCount;
+    uint32_t doneTask;
+    uint32_t firstRow;
+    uint32_t endRow;
+  };
+
+
+  // Which queued pass last wrote to a given mip of a texture, and which passes have read it since.
+  struct ResourceState
+  {
+    const CPUTexture *texture;
+    uint32_t mip;
+    int32_t writerPass;
+    std::vector<uint32_t> readerPasses;
+  };
+
+
+  static constexpr uint32_t k_autoTileHeightCount = 4;
+  static constexpr uint32_t k_autoSamplesPerTileHeight = 2;
+  static constexpr size_t k_maxTileHeightTunings = 32;
+
+
+  // The timings that the auto tile height mode has gathered for a given set of passes.
+  struct TileHeightTuning
+  {
+    uint64_t signature = 0;
+    uint32_t sampleCount = 0;
+    double bestTimes[k_autoTileHeightCount] = {};
+    uint32_t chosenRowsPerTile = 0;
+  };
+
+
+  // The tile heights that the auto mode tries.
+  static uint32_t AutoTileHeight(uint32_t index)
+  {
+    static constexpr uint32_t k_heights[k_autoTileHeightCount] = { 4, 8, 16, 32 };
+    return k_heights[index];
+  }
+
+
+  void FlushQueuedPasses()
+  {
+    if (queuedPasses.empty())
+    {
+      return;
+    }
+
+    for (QueuedPass &pass : queuedPasses)
+    {
+      pass.ctx.constants = pass.constants.empty() ? nullptr : pass.constants.data();
+    }
+
+    TileHeightTuning *tuning = nullptr;
+    uint32_t tileHeight = rowsPerTile;
+    uint32_t tileHeightIndex = 0;
+    if (tileHeight == k_autoRowsPerTile)
+    {
+      tuning = FindTileHeightTuning();
+      if (tuning->sampleCount < k_autoTileHeightCount * k_autoSamplesPerTileHeight)
+      {
+        tileHeightIndex = tuning->sampleCount % k_autoTileHeightCount;
+        tileHeight = AutoTileHeight(tileHeightIndex);
+      }
+      else
+      {
+        tileHeight = tuning->chosenRowsPerTile;
+        tuning = nullptr;
+      }
+    }
+
+    BuildTaskGraph(tileHeight);
+
+    auto startTime = std::chrono::steady_clock::now();
+    threadPool.Run(
+      taskGraph,
+      [this](uint32_t task)
+      {
+        const TileTask &tile = tileTasks[task];
+        if (tile.rowBegin != tile.rowEnd)
+        {
+          const QueuedPass &pass = queuedPasses[tile.pass];
+          pass.shader(pass.ctx, tile.rowBegin, tile.rowEnd);
+        }
+      });
+
+    if (tuning != nullptr)
+    {
+      double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+      double &best = tuning->bestTimes[tileHeightIndex];
+      best = (tuning->sampleCount < k_autoTileHeightCount) ? time : std::min(best, time);
+      if (++tuning->sampleCount == k_autoTileHeightCount * k_autoSamplesPerTileHeight)
+      {
+        uint32_t bestIndex = 0;
+        for (uint32_t i = 1; i < k_autoTileHeightCount; i++)
+        {
+          if (tuning->bestTimes[i] < tuning->bestTimes[bestIndex])
+          {
+            bestIndex = i;
+          }
+        }
+
+        tuning->chosenRowsPerTile = AutoTileHeight(bestIndex);
+      }
+    }
+
+    queuedPasses.clear();
+  }
+
+
+  // Find (or start) the tile height timings for the currently-queued set of passes.
+  TileHeightTuning *FindTileHeightTuning()
+  {
+    // FNV-1a over the shader and output size of every queued pass.
+    uint64_t signature = 0xcbf29ce484222325ULL;
+    auto hash = [&](uint32_t v)
+    {
+      for (uint32_t i = 0; i < 4; i++)
+      {
+        signature = (signature ^ ((v >> (i * 8)) & 0xff)) * 0x100000001b3ULL;
+      }
+    };
+
+    for (const QueuedPass &pass : queuedPasses)
+    {
+      hash(uint32_t(pass.shaderID));
+      hash(pass.ctx.outputWidth);
+      hash(pass.ctx.outputHeight);
+      hash(pass.ctx.region.top);
+      hash(pass.ctx.region.bottom);
+    }
+
+    for (TileHeightTuning &tuning : tileHeightTunings)
+    {
+      if (tuning.signature == signature)
+      {
+        return &tuning;
+      }
+    }
+
+    if (tileHeightTunings.size() == k_maxTileHeightTunings)
+    {
+      tileHeightTunings.erase(tileHeightTunings.begin());
+    }
+
+    tileHeightTunings.push_back({});
+    tileHeightTunings.back().signature = signature;
+    return &tileHeightTunings.back();
+  }
+
+
+  ResourceState &FindResourceState(const CPUTexture *texture, uint32_t mip)
+  {
+    for (ResourceState &state : resourceStates)
+    {
+      if (state.texture == texture && state.mip == mip)
+      {
+        return state;
+      }
+    }
+
+    resourceStates.push_back({texture, mip, -1, {}});
+    return resourceStates.back();
+  }
+
+
+  // Build the graph of tiles for the queued passes, with each tile depending on the tiles (or whole passes) that
+  //  have to finish before it can run.
+  void BuildTaskGraph(uint32_t tileHeight)
+  {
+    taskGraph.Clear();
+    tileTasks.clear();
+    passTiles.clear();
+    resourceStates.clear();
+
+    for (uint32_t passIndex = 0; passIndex < uint32_t(queuedPasses.size()); passIndex++)
+    {
+      const CPUShaderContext &ctx = queuedPasses[passIndex].ctx;
+
+      PassTiles tiles;
+      tiles.firstTile = taskGraph.TaskCount();
+      tiles.firstRow = ctx.region.top;
+      tiles.endRow = ctx.region.bottom;
+      tiles.tileCount = (tiles.endRow - tiles.firstRow + tileHeight - 1) / tileHeight;
+      for (uint32_t t = 0; t < tiles.tileCount; t++)
+      {
+        taskGraph.AddTask();
+        uint32_t rowBegin = tiles.firstRow + t * tileHeight;
+        tileTasks.push_back({passIndex, rowBegin, std::min(rowBegin + tileHeight, tiles.endRow)});
+      }
+
+      auto dependOnPass = [&](uint32_t otherPass)
+      {
+        for (uint32_t t = 0; t < tiles.tileCount; t++)
+        {
+          taskGraph.AddDependency(tiles.firstTile + t, passTiles[otherPass].doneTask);
+        }
+      };
+
+      // Read-after-write: wait for the tiles that wrote the rows that each of our tiles read.
+      for (uint32_t inputIndex = 0; inputIndex < ctx.inputCount; inputIndex++)
+      {
+        const CPUTextureView &input = ctx.inputs[inputIndex];
+        for (uint32_t mip = input.BaseMip(); mip < input.BaseMip() + input.MipCount(); mip++)
+        {
+          ResourceState &state = FindResourceState(input.Texture(), mip);
+          if (std::find(state.readerPasses.begin(), state.readerPasses.end(), passIndex) == state.readerPasses.end())
+          {
+            state.readerPasses.push_back(passIndex);
+          }
+
+          if (state.writerPass < 0)
+          {
+            continue;
+          }
+
+          const PassTiles &writerTiles = passTiles[uint32_t(state.writerPass)];
+          if (input.MipCount() != 1)
+          {
+            dependOnPass(uint32_t(state.writerPass));
+            continue;
+          }
+
+          for (uint32_t t = 0; t < tiles.tileCount; t++)
+          {
+            const TileTask &tile = tileTasks[tiles.firstTile + t];
+            uint32_t firstRow;
+            uint32_t endRow;
+            CPUShaders::InputRowRange(
+              queuedPasses[passIndex].shaderID,
+              ctx,
+              inputIndex,
+              tile.rowBegin,
+              tile.rowEnd,
+              &firstRow,
+              &endRow);
+            if (firstRow >= endRow)
+            {
+              continue;
+            }
+
+            // Rows outside of the writer's region weren't written by it, but an earlier pass might still be writing
+            //  them (they're not used for anything, but they still shouldn't be read mid-write), so a tile that reads
+            //  any of those waits for the whole writer (which waited for the earlier passes).
+            if (firstRow < writerTiles.firstRow || endRow > writerTiles.endRow)
+            {
+              taskGraph.AddDependency(tiles.firstTile + t, writerTiles.doneTask);
+              continue;
+            }
+
+            uint32_t firstWriterTile = (firstRow - writerTiles.firstRow) / tileHeight;
+            uint32_t endWriterTile = std::min(
+              (endRow - 1 - writerTiles.firstRow) / tileHeight + 1,
+              writerTiles.tileCount);
+            if (firstWriterTile == 0 && endWriterTile == writerTiles.tileCount)
+            {
+              taskGraph.AddDependency(tiles.firstTile + t, writerTiles.doneTask);
+              continue;
+            }
+
+            for (uint32_t w = firstWriterTile; w < endWriterTile; w++)
+            {
+              taskGraph.AddDependency(tiles.firstTile + t, writerTiles.firstTile + w);
+            }
+          }
+        }
+      }
+
+      // Write-after-write and write-after-read: wait for every earlier pass that touched our output to finish.
+      ResourceState &outputState = FindResourceState(ctx.output, ctx.outputMip);
+      assert(std::find(outputState.readerPasses.begin(), outputState.readerPasses.end(), passIndex)
+        == outputState.readerPasses.end());
+      if (outputState.writerPass >= 0)
+      {
+        dependOnPass(uint32_t(outputState.writerPass));
+      }
+
+      for (uint32_t reader : outputState.readerPasses)
+      {
+        dependOnPass(reader);
+      }
+
+      outputState.writerPass = int32_t(passIndex);
+      outputState.readerPasses.clear();
+
+      tiles.doneTask = taskGraph.AddTask();
+      tileTasks.push_back({passIndex, 0, 0});
+      for (uint32_t t = 0; t < tiles.tileCount; t++)
+      {
+        taskGraph.AddDependency(tiles.doneTask, tiles.firstTile + t);
+      }
+
+      passTiles.push_back(tiles);
+    }
+  }
+
+
+  CPUThreadPool threadPool;
+  uint32_t rowsPerTile;
+  bool enablePassFusion;
+  bool isRendering = false;
+  std::vector<QueuedPass> queuedPasses;
+
+  // Scratch space for FlushQueuedPasses, kept around between frames to save on allocations.
+  CPUTaskGraph taskGraph;
+  std::vector<TileTask> tileTasks;
+  std::vector<PassTiles> passTiles;
+  std::vector<ResourceState> resourceStates;
+  std::vector<TileHeightTuning> tileHeightTunings;
+
+  CathodeRetro::StageTimings *stageTimings = nullptr;
+  std::chrono::steady_clock::time_point stageStartTime;
+};
@@ -0,0 +1,176 @@
+// This file contains the small set of HLSL-like vector types and intrinsics that the CPU shader ports need, so that
+//  the ports in CPUShaders.h can read as closely to the original shader source as possible.
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+struct Float2
+{
+  float x;
+  float y;
+};
+
+
+struct Float4
+{
+  float x;
+  float y;
+  float z;
+  float w;
+};
+
+
+inline Float2 operator+(Float2 a, Float2 b) { return {a.x + b.x, a.y + b.y}; }
+inline Float2 operator-(Float2 a, Float2 b) { return {a.x - b.x, a.y - b.y}; }
+inline Float2 operator*(Float2 a, Float2 b) { return {a.x * b.x, a.y * b.y}; }
+inline Float2 operator/(Float2 a, Float2 b) { return {a.x / b.x, a.y / b.y}; }
+inline Float2 operator*(Float2 a, float s) { return {a.x * s, a.y * s}; }
+inline Float2 operator*(float s, Float2 a) { return {a.x * s, a.y * s}; }
+inline Float2 operator/(Float2 a, float s) { return {a.x / s, a.y / s}; }
+inline Float2 operator+(Float2 a, float s) { return {a.x + s, a.y + s}; }
+inline Float2 operator-(Float2 a, float s) { return {a.x - s, a.y - s}; }
+inline Float2 &operator+=(Float2 &a, Float2 b) { a = a + b; return a; }
+inline Float2 &operator-=(Float2 &a, Float2 b) { a = a - b; return a; }
+inline Float2 &operator*=(Float2 &a, float s) { a = a * s; return a; }
+
+inline Float4 operator+(const Float4 &a, const Float4 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+inline Float4 operator-(const Float4 &a, const Float4 &b) { return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+inline Float4 operator*(const Float4 &a, const Float4 &b) { return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+inline Float4 operator*(const Float4 &a, float s) { return {a.x * s, a.y * s, a.z * s, a.w * s}; }
+inline Float4 operator*(float s, const Float4 &a) { return a * s; }
+inline Float4 operator/(const Float4 &a, float s) { return a * (1.0f / s); }
+inline Float4 operator+(const Float4 &a, float s) { return {a.x + s, a.y + s, a.z + s, a.w + s}; }
+inline Float4 &operator+=(Float4 &a, const Float4 &b) { a = a + b; return a; }
+inline Float4 &operator*=(Float4 &a, float s) { a = a * s; return a; }
+
+
+inline float Frac(float v)
+  { return v - std::floor(v); }
+
+inline Float2 Frac(Float2 v)
+  { return {Frac(v.x), Frac(v.y)}; }
+
+// Like the HLSL saturate, this maps NaN to 0 (which is also what a GPU does when writing NaN to a unorm target).
+inline float Saturate(float v)
+  { return (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f; }
+
+inline float Lerp(float a, float b, float t)
+  { return a + (b - a) * t; }
+
+inline Float2 Lerp(Float2 a, Float2 b, float t)
+  { return a + (b - a) * t; }
+
+inline Float4 Lerp(const Float4 &a, const Float4 &b, float t)
+  { return a + (b - a) * t; }
+
+inline float Sign(float v)
+  { return (v > 0.0f) ? 1.0f : ((v < 0.0f) ? -1.0f : 0.0f); }
+
+inline float Smoothstep(float edge0, float edge1, float v)
+{
+  float t = Saturate((v - edge0) / (edge1 - edge0));
+  return t * t * (3.0f - 2.0f * t);
+}
+
+inline float Dot(Float2 a, Float2 b)
+  { return a.x * b.x + a.y * b.y; }
+
+inline float Length(Float2 v)
+  { return std::sqrt(Dot(v, v)); }
+
+inline float Distance(Float2 a, Float2 b)
+  { return Length(a - b); }
+
+inline float DotRGB(const Float4 &a, float r, float g, float b)
+  { return a.x * r + a.y * g + a.z * b; }
+
+
+// Convert a float to IEEE half-precision bits the way a GPU does when writing to a 16-bit float render target (round to
+//  nearest even, with out-of-range values going to infinity and tiny values going denormal).
+inline uint16_t FloatToHalf(float v)
+{
+  uint32_t f;
+  memcpy(&f, &v, sizeof(f));
+  uint32_t sign = (f >> 16) & 0x8000;
+  f &= 0x7fffffff;
+
+  if (f >= 0x7f800000)
+  {
+    // Infinity or NaN (keep NaNs as NaNs).
+    return uint16_t(sign | 0x7c00 | ((f > 0x7f800000) ? 0x0200 : 0));
+  }
+
+  if (f >= 0x477ff000)
+  {
+    // Too large (even after rounding) for a half, so it goes to infinity.
+    return uint16_t(sign | 0x7c00);
+  }
+
+  if (f < 0x38800000)
+  {
+    // Below the smallest normal half, so this is a denormal: scale it up so that the half's mantissa LSB is 1.0 and
+    //  let the (round-to-nearest-even) default rounding mode do the rest.
+    float abs;
+    memcpy(&abs, &f, sizeof(abs));
+    return uint16_t(sign | uint32_t(std::nearbyint(abs * 16777216.0f)));
+  }
+
+  // Rebias the exponent (127 -> 15) and round the mantissa from 23 bits to 10, to nearest even.
+  return uint16_t(sign | ((f - 0x38000000 + 0x0fff + ((f >> 13) & 1)) >> 13));
+}
+
+
+inline float HalfToFloat(uint16_t h)
+{
+  uint32_t sign = uint32_t(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x03ff;
+
+  uint32_t f;
+  if (exponent == 0)
+  {
+    // Zero or denormal, which are exactly representable as a scaled float.
+    float v = float(mantissa) * (1.0f / 16777216.0f);
+    memcpy(&f, &v, sizeof(f));
+    f |= sign;
+  }
+  else if (exponent == 0x1f)
+  {
+    f = sign | 0x7f800000 | (mantissa << 13);
+  }
+  else
+  {
+    f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+
+  float v;
+  memcpy(&v, &f, sizeof(v));
+  return v;
+}
+
+
+// Port of cathode-retro-util-noise.hlsli
+inline float Noise2D(Float2 coord, float iseed)
+{
+  float fseed = Frac(iseed / 10000.0f);
+  float angle = Frac(Distance(coord, Float2{fseed + 0.3f + 1.0f, 0.1f + 1.0f} * 1000.0f));
+  return Frac(std::tan(angle) * Distance(coord, Float2{fseed + 0.1f - 2.0f, fseed + 0.2f - 2.0f} * 1000.0f));
+}
+
+
+inline float Noise1D(float coord, float iseed)
+  { return Noise2D({coord, 0.0f}, iseed); }
+
+
+// Port of cathode-retro-util-tracking-instability.hlsli
+inline float CalculateTrackingInstabilityOffset(
+  uint32_t scanlineIndex,
+  uint32_t noiseSeed,
+  float scale,
+  uint32_t signalTextureWidth)
+{
+  return (Noise1D(float(scanlineIndex), float(noiseSeed)) - 0.5f) * scale / float(signalTextureWidth);
+}
@@ -0,0 +1,1859 @@
+// These are native C++ ports of the shaders in the Shaders directory, for use by CPUGraphicsDevice. Each port is kept
+//  as close to the original shader source as is reasonable (with the same names and the same order of operations) so
+//  that the two can be compared side-by-side; see the .hlsl files for the full documentation of what each one does.
+//
+// Every shader entry point renders a band of rows [rowBegin, rowEnd) of its output, so that the device can spread a
+//  single RenderQuad across multiple threads.
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+#include "CPUShaderHelpers.h"
+#include "CPUTexture.h"
+#include "CPUYIQKernels.h"
+
+
+// Everything a CPU shader needs to know about a RenderQuad call: where it is writing to, what it is reading from, and
+//  its constant buffer contents.
+struct CPUShaderContext
+{
+  static constexpr uint32_t k_maxInputs = 5;
+
+  CPUTexture *output;
+  uint32_t outputMip;
+  uint32_t outputWidth;
+  uint32_t outputHeight;
+
+  // The part of the output to render (see RenderTargetView::region), already clamped to the output's size. Shaders
+  //  only get called for rows inside of it, and only need to write its columns.
+  CathodeRetro::TexelRect region;
+
+  CPUTextureView inputs[k_maxInputs];
+  uint32_t inputCount;
+
+  const void *constants;
+
+  template <typename T>
+  const T &Constants() const
+  {
+    assert(constants != nullptr);
+    return *static_cast<const T *>(constants);
+  }
+};
+
+
+namespace CPUShaders
+{
+  using ShaderFunc = void (*)(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd);
+
+  constexpr float k_pi = 3.141592653f;
+
+
+  // Run a "pixel shader" function for every texel in the given rows of the output, handing it the same [0..1] texture
+  //  coordinate that the basic vertex shader would have.
+  template <typename MainFunc>
+  void RunPixelShader(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd, MainFunc &&main)
+  {
+    float invWidth = 1.0f / float(ctx.outputWidth);
+    float invHeight = 1.0f / float(ctx.outputHeight);
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+      float v = (float(y) + 0.5f) * invHeight;
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        ctx.output->Store(ctx.outputMip, x, y, main(Float2{(float(x) + 0.5f) * invWidth, v}));
+      }
+    }
+  }
+
+
+  // Port of cathode-retro-util-box-filter.hlsli
+  inline Float4 BoxFilter(
+    const CPUTextureView &sourceTexture,
+    Float2 invTextureSize,
+    uint32_t filterWidth,
+    Float2 texCoord,
+    Float4 *centerSampleOut)
+  {
+    Float4 centerSample = sourceTexture.Sample(texCoord);
+    if (centerSampleOut != nullptr)
+    {
+      *centerSampleOut = centerSample;
+    }
+
+    Float4 avg = centerSample;
+
+    uint32_t iterEnd = (filterWidth - 1U) / 2U;
+    for (uint32_t i = 2U; i < iterEnd; i += 2U)
+    {
+      Float2 offset = Float2{float(i) - 0.5f, 0.0f} * invTextureSize;
+      avg += 2.0f * sourceTexture.Sample(texCoord + offset);
+      avg += 2.0f * sourceTexture.Sample(texCoord - offset);
+    }
+
+    uint32_t remainder = (filterWidth - 1U) % 4U;
+    if (remainder == 3U)
+    {
+      Float2 offset = Float2{float(iterEnd) + 1.0f / 3.0f, 0.0f} * invTextureSize;
+      avg += 1.5f * sourceTexture.Sample(texCoord + offset);
+      avg += 1.5f * sourceTexture.Sample(texCoord - offset);
+    }
+    else if (remainder > 0U)
+    {
+      float scale = (remainder == 2U) ? 1.0f : 0.0f;
+      Float2 offset = Float2{float(iterEnd) + 1.0f, 0.0f} * invTextureSize;
+      avg += scale * sourceTexture.Sample(texCoord + offset);
+      avg += scale * sourceTexture.Sample(texCoord - offset);
+    }
+
+    return avg / float(filterWidth);
+  }
+
+
+  // Scratch space for BoxFilterRow, kept around by the caller so that it is not reallocated for every row.
+  struct BoxFilterRowScratch
+  {
+    std::vector<Float4> texels;
+    std::vector<double> prefixSums;
+  };
+
+
+  // A running-sum version of BoxFilter that filters a whole row at once: averagesOut[i] is the box filter of the texel
+  //  at (firstCenterX + i, row), so every output costs the same no matter how wide the filter is. This is only usable
+  //  when the shader's texture coordinates land exactly on texel centers (which, for the decoder passes, they do).
+  //
+  // Even filter widths take half of each end texel, the same as BoxFilter's half-texel samples at either end. Note
+  //  that BoxFilter itself only gets its weights exactly right for widths that are a multiple of 4, which are the only
+  //  widths the decoder uses.
+  inline void BoxFilterRow(
+    const CPUTextureView &sourceTexture,
+    int32_t row,
+    int32_t firstCenterX,
+    uint32_t count,
+    uint32_t filterWidth,
+    BoxFilterRowScratch *scratch,
+    Float4 *averagesOut,
+    Float4 *centerSamplesOut)
+  {
+    assert(filterWidth > 0);
+
+    uint32_t halfWidth = filterWidth / 2U;
+    bool hasHalfTexelEnds = (filterWidth % 2U) == 0;
+    uint32_t texelCount = count + 2U * halfWidth;
+
+    // Sums are accumulated as doubles so that a long row doesn't drift by the time we get to the end of it.
+    scratch->texels.resize(texelCount);
+    scratch->prefixSums.resize((texelCount + 1) * 4);
+    double *sums = scratch->prefixSums.data();
+    sums[0] = sums[1] = sums[2] = sums[3] = 0.0;
+    for (uint32_t i = 0; i < texelCount; i++)
+    {
+      Float4 t = sourceTexture.Load(firstCenterX - int32_t(halfWidth) + int32_t(i), row);
+      scratch->texels[i] = t;
+      sums[i * 4 + 4] = sums[i * 4 + 0] + double(t.x);
+      sums[i * 4 + 5] = sums[i * 4 + 1] + double(t.y);
+      sums[i * 4 + 6] = sums[i * 4 + 2] + double(t.z);
+      sums[i * 4 + 7] = sums[i * 4 + 3] + double(t.w);
+    }
+
+    // For output i, scratch texel i is the left-most one in the window and (i + 2 * halfWidth) is the right-most.
+    uint32_t fullBegin = hasHalfTexelEnds ? 1 : 0;
+    uint32_t fullEnd = hasHalfTexelEnds ? 2U * halfWidth : 2U * halfWidth + 1U;
+    double invWidth = 1.0 / double(filterWidth);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const double *begin = sums + (i + fullBegin) * 4;
+      const double *end = sums + (i + fullEnd) * 4;
+      Float4 avg = {
+        float((end[0] - begin[0]) * invWidth),
+        float((end[1] - begin[1]) * invWidth),
+        float((end[2] - begin[2]) * invWidth),
+        float((end[3] - begin[3]) * invWidth)};
+
+      if (hasHalfTexelEnds)
+      {
+        avg += (scratch->texels[i] + scratch->texels[i + 2U * halfWidth]) * float(0.5 * invWidth);
+      }
+
+      averagesOut[i] = avg;
+      if (centerSamplesOut != nullptr)
+      {
+        centerSamplesOut[i] = scratch->texels[i + halfWidth];
+      }
+    }
+  }
+
+
+  // How far along (as a whole number of decimated IQ texels plus a blend amount) a signal texel is in the decimated IQ
+  //  texture, relative to its color cycle (see DecoderSVideoAndDecimatedIQToRGB).
+  struct DecimatedIQBlend
+  {
+    int32_t offset;
+    float amount;
+  };
+
+
+  // The two neighboring phase steps of the palette signal table that a signal texel blends between, and how far it is
+  //  from the first to the second (see GeneratorIndexedToSVideoOrComposite).
+  struct PalettePhaseSteps
+  {
+    uint32_t step0;
+    uint32_t step1;
+    float blend;
+  };
+
+
+  // Scratch rows for the shader ports that work a row at a time. Every tile of every pass would otherwise allocate
+  //  its own, so instead each worker thread has one set that lives as long as the thread does (the vectors only ever
+  //  grow, so after the first few tiles nothing gets allocated at all). A shader entry point can use it freely, since
+  //  a thread only runs one of them at a time.
+  struct RowScratch
+  {
+    BoxFilterRowScratch boxFilterRow;
+    std::vector<Float4> boxFilterOutput;
+
+    // The signal texel that each output column lands on, for the passes that work it out once per tile.
+    std::vector<uint32_t> signalTexelIndicesX;
+
+    // The indexed generator's palette phase steps for one color cycle of the current scanline (for both phases).
+    std::vector<PalettePhaseSteps> palettePhaseSteps;
+
+    // Separate channel rows for the whole-row YIQ conversions (see CPUYIQKernels.h).
+    std::vector<float> channels;
+
+    // The decimated chroma decode's modulated chroma row, per-phase blends, and row of decimated IQ texels.
+    std::vector<Float4> modulatedChroma;
+    std::vector<DecimatedIQBlend> decimatedIQBlends;
+    std::vector<Float4> decimatedIQRow;
+  };
+
+
+  inline RowScratch &ThreadRowScratch()
+  {
+    thread_local RowScratch scratch;
+    return scratch;
+  }
+
+
+  // The sin and cos of the color carrier for every texel of a single scanline. The phase only advances by
+  //  1/samplesPerCycle of a cycle per texel, so there are only samplesPerCycle distinct values along a scanline and
+  //  they can be worked out once per scanline instead of once per texel. At the usual 4 samples per cycle each step is
+  //  a 90 degree rotation, which is just a swap and a negate.
+  class ScanlineCarrier
+  {
+  public:
+    void Reset(float phase, uint32_t samplesPerCycle)
+    {
+      assert(samplesPerCycle > 0);
+      sinCos.resize(samplesPerCycle);
+
+      float angle = 2.0f * k_pi * phase;
+      if (samplesPerCycle == 4)
+      {
+        float s = std::sin(angle);
+        float c = std::cos(angle);
+        sinCos[0] = {s, c};
+        sinCos[1] = {c, -s};
+        sinCos[2] = {-s, -c};
+        sinCos[3] = {-c, s};
+        return;
+      }
+
+      for (uint32_t i = 0; i < samplesPerCycle; i++)
+      {
+        float a = 2.0f * k_pi * (phase + float(i) / float(samplesPerCycle));
+        sinCos[i] = {std::sin(a), std::cos(a)};
+      }
+    }
+
+
+    // Returns {sin, cos} of the carrier at the given texel index.
+    Float2 SinCos(uint32_t texelIndex) const
+      { return sinCos[texelIndex % sinCos.size()]; }
+
+  private:
+    std::vector<Float2> sinCos;
+  };
+
+
+  // Port of cathode-retro-util-lanczos.hlsli
+  inline Float4 Lanczos2xDownsample(const CPUTextureView &sourceTexture, Float2 centerTexCoord, Float2 filterDir)
+  {
+    static constexpr float k_coeffs[] = { -0.051f, 0.551f, 0.551f, -0.051f };
+    static constexpr float k_offsets[] = { -2.67647052f, -0.712341249f, 0.712341189f, 2.67647052f };
+
+    Float2 step = filterDir / sourceTexture.Size();
+    Float4 v = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (uint32_t i = 0; i < 4; i++)
+    {
+      v += sourceTexture.Sample(centerTexCoord + step * k_offsets[i]) * k_coeffs[i];
+    }
+
+    return v;
+  }
+
+
+  // Port of cathode-retro-crt-distort-coordinates.hlsli
+  inline Float2 ApproxAtan2(Float2 y, Float2 x)
+  {
+    y = y / x;
+    Float2 y2 = y * y;
+    return {
+      y.x * (1.0f + y2.x * (y2.x * 0.2f - 0.333333333f)),
+      y.y * (1.0f + y2.y * (y2.y * 0.2f - 0.333333333f)),
+    };
+  }
+
+
+  // The parts of DistortCRTCoordinates that only depend on the distortion amount (including maxUV, which the shader
+  //  recalculates for every pixel), so that they can be calculated once per pass rather than once per coordinate.
+  struct CRTDistortion
+  {
+    bool isDistorted;
+    Float2 distortion;
+    Float2 maxUV;
+  };
+
+
+  inline CRTDistortion PrepareCRTDistortion(Float2 distortion)
+  {
+    CRTDistortion prepared = {};
+    prepared.isDistorted = (distortion.x != 0.0f || distortion.y != 0.0f);
+    if (!prepared.isDistorted)
+    {
+      return prepared;
+    }
+
+    constexpr float k_distance = 2.0f;
+    constexpr float k_minDistortion = 0.0001f;
+
+    distortion = {std::max(k_minDistortion, distortion.x), std::max(k_minDistortion, distortion.y)};
+    prepared.distortion = distortion;
+
+    Float2 maxRayLenSq = {
+      distortion.x * distortion.x + k_distance * k_distance,
+      distortion.y * distortion.y + k_distance * k_distance };
+
+    Float2 maxB = Float2{k_distance * k_distance, k_distance * k_distance} / maxRayLenSq;
+    Float2 maxC = Float2{k_distance * k_distance - 1.0f, k_distance * k_distance - 1.0f} / maxRayLenSq;
+    Float2 maxT = {
+      maxB.x - std::sqrt(std::max(0.0f, maxB.x * maxB.x - maxC.x)),
+      maxB.y - std::sqrt(std::max(0.0f, maxB.y * maxB.y - maxC.y)) };
+    prepared.maxUV = ApproxAtan2(distortion * maxT, Float2{k_distance, k_distance} - k_distance * maxT);
+    return prepared;
+  }
+
+
+  inline Float2 DistortCRTCoordinates(Float2 texCoord, const CRTDistortion &prepared)
+  {
+    if (!prepared.isDistorted)
+    {
+      return texCoord;
+    }
+
+    constexpr float k_distance = 2.0f;
+
+    Float2 rayXY = texCoord * prepared.distortion;
+    float rayZ = -k_distance;
+
+    float rayLenSq = Dot(rayXY, rayXY) + rayZ * rayZ;
+
+    float b = (k_distance * k_distance) / rayLenSq;
+    float c = (k_distance * k_distance - 1.0f) / rayLenSq;
+
+    float t = b - std::sqrt(std::max(0.0f, b * b - c));
+
+    float denom = k_distance + rayZ * t;
+    Float2 uv = ApproxAtan2(rayXY * t, {denom, denom});
+    return uv / prepared.maxUV;
+  }
+
+
+  // Util_Copy: cathode-retro-util-copy.hlsl
+  inline void UtilCopy(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      return sourceTexture.Sample(inTexCoord);
+    });
+  }
+
+
+  // Util_Downsample2X: cathode-retro-util-downsample-2x.hlsl
+  inline void UtilDownsample2X(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    Float2 filterDir = ctx.Constants<Float2>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      return Lanczos2xDownsample(sourceTexture, inTexCoord, filterDir);
+    });
+  }
+
+
+  // Util_TonemapAndDownsample: cathode-retro-util-tonemap-and-downsample.hlsl
+  struct TonemapAndDownsampleConstants
+  {
+    Float2 downsampleDir;
+    float minLuminosity;
+    float colorPower;
+  };
+
+
+  inline void UtilTonemapAndDownsample(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<TonemapAndDownsampleConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float4 samp = Lanczos2xDownsample(sourceTexture, inTexCoord, consts.downsampleDir);
+
+      float inLuma = DotRGB(samp, 0.30f, 0.59f, 0.11f);
+
+      float outLuma = (inLuma - consts.minLuminosity) / (1.0f - consts.minLuminosity);
+      outLuma = std::pow(Saturate(outLuma), consts.colorPower);
+
+      float scale = outLuma / inLuma;
+      return Float4{samp.x * scale, samp.y * scale, samp.z * scale, samp.w};
+    });
+  }
+
+
+  // Util_GaussianBlur13: cathode-retro-util-gaussian-blur.hlsl
+  inline void UtilGaussianBlur13(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    static constexpr float k_coeffs[] =
+      { 3.586488181e-2f, 1.278779997e-1f, 2.589758386e-1f, 1.545625599e-1f, 2.589758386e-1f, 1.278779997e-1f,
+        3.586488181e-2f };
+    static constexpr float k_offsets[] =
+      { -5.308886854f, -3.374611919f, -1.445310910f, 0.000000000f, 1.445310910f, 3.374611919f, 5.308886854f };
+
+    Float2 blurDir = ctx.Constants<Float2>();
+    const CPUTextureView &sourceTex = ctx.inputs[0];
+    Float2 step = blurDir / sourceTex.Size();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float4 v = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (uint32_t i = 0; i < 7; i++)
+      {
+        v += sourceTex.Sample(inTexCoord + step * k_offsets[i]) * k_coeffs[i];
+      }
+
+      return v;
+    });
+  }
+
+
+  // Generator_GeneratePhaseTexture: cathode-retro-generator-gen-phase.hlsl
+  struct GeneratePhaseTextureConstants
+  {
+    float initialFrameStartPhase;
+    float prevFrameStartPhase;
+    float phaseIncrementPerScanline;
+    uint32_t samplesPerColorburstCycle;
+    float instabilityScale;
+    uint32_t noiseSeed;
+    uint32_t signalTextureWidth;
+    uint32_t scanlineCount;
+  };
+
+
+  inline void GeneratorGeneratePhaseTexture(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<GeneratePhaseTextureConstants>();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 texCoord)
+    {
+      uint32_t scanlineIndex = uint32_t(std::round(texCoord.y * float(consts.scanlineCount) - 0.5f));
+
+      Float2 phases = Float2{consts.initialFrameStartPhase, consts.prevFrameStartPhase}
+        + consts.phaseIncrementPerScanline * float(scanlineIndex);
+
+      phases = phases + 0.5f / float(consts.samplesPerColorburstCycle);
+
+      float instability = CalculateTrackingInstabilityOffset(
+        scanlineIndex,
+        consts.noiseSeed,
+        consts.instabilityScale,
+        consts.signalTextureWidth);
+      phases = phases + instability * float(consts.signalTextureWidth) / float(consts.samplesPerColorburstCycle);
+
+      Float2 f = Frac(phases);
+      return Float4{f.x, f.y, 0.0f, 0.0f};
+    });
+  }
+
+
+  // Generator_RGBToSVideoOrComposite: cathode-retro-generator-rgb-to-svideo-or-composite.hlsl
+  struct RGBToSVideoOrCompositeConstants
+  {
+    uint32_t outputTexelsPerColorburstCycle;
+    uint32_t inputWidth;
+    uint32_t outputWidth;
+    uint32_t scanlineCount;
+    float compositeBlend;
+    float instabilityScale;
+    uint32_t noiseSeed;
+    uint32_t sidePaddingTexelCount;
+  };
+
+
+  inline void GeneratorRGBToSVideoOrComposite(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<RGBToSVideoOrCompositeConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &scanlinePhases = ctx.inputs[1];
+
+    // Everything that depends only on the scanline (the tracking instability and the carrier phase) is hoisted out of
+    //  the per-texel loop.
+    ScanlineCarrier carrier0;
+    ScanlineCarrier carrier1;
+    uint32_t effectiveOutputWidth = consts.outputWidth - consts.sidePaddingTexelCount;
+
+    // Each scanline is sampled into separate R, G, and B rows so that the YIQ conversion can run on the whole row at
+    //  once (see CPUYIQKernels.h).
+    RowScratch &scratch = ThreadRowScratch();
+    scratch.channels.resize(size_t(ctx.outputWidth) * 6);
+    float *rRow = scratch.channels.data();
+    float *gRow = rRow + ctx.outputWidth;
+    float *bRow = gRow + ctx.outputWidth;
+    float *YRow = bRow + ctx.outputWidth;
+    float *IRow = YRow + ctx.outputWidth;
+    float *QRow = IRow + ctx.outputWidth;
+
+    scratch.signalTexelIndicesX.resize(ctx.outputWidth);
+    uint32_t *signalTexelIndicesX = scratch.signalTexelIndicesX.data();
+    for (uint32_t x = 0; x < ctx.outputWidth; x++)
+    {
+      float u = (float(x) + 0.5f) / float(ctx.outputWidth);
+      signalTexelIndicesX[x] = uint32_t(std::floor(u * float(consts.outputWidth)));
+    }
+
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+      float v = (float(y) + 0.5f) / float(ctx.outputHeight);
+      uint32_t signalTexelIndexY = uint32_t(std::floor(v * float(consts.scanlineCount)));
+
+      float instability = CalculateTrackingInstabilityOffset(
+        signalTexelIndexY,
+        consts.noiseSeed,
+        consts.instabilityScale,
+        consts.outputWidth);
+
+      Float4 scanlinePhase = scanlinePhases.Sample(
+        Float2{0.0f, float(signalTexelIndexY) + 0.5f} / float(consts.scanlineCount));
+      carrier0.Reset(scanlinePhase.x, consts.outputTexelsPerColorburstCycle);
+      carrier1.Reset(scanlinePhase.y, consts.outputTexelsPerColorburstCycle);
+
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        uint32_t signalTexelIndexX = signalTexelIndicesX[x];
+        Float2 texCoord =
+          (Float2{
+              float(signalTexelIndexX) * (float(consts.inputWidth) / float(consts.outputWidth)),
+              float(signalTexelIndexY)}
+            + Float2{0.25f, 0.5f})
+          / Float2{float(consts.inputWidth), float(consts.scanlineCount)};
+
+        texCoord.x = (texCoord.x - 0.5f) * float(consts.outputWidth) / float(effectiveOutputWidth) + 0.5f;
+        texCoord.x += instability;
+
+        Float4 rgb = sourceTexture.Sample(texCoord);
+        rRow[x] = rgb.x;
+        gRow[x] = rgb.y;
+        bRow[x] = rgb.z;
+      }
+
+      uint32_t left = ctx.region.left;
+      CPUYIQKernels::RGBToYIQRow(
+        rRow + left, gRow + left, bRow + left,
+        YRow + left, IRow + left, QRow + left,
+        ctx.region.right - left);
+
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        uint32_t signalTexelIndexX = signalTexelIndicesX[x];
+        float Y = YRow[x];
+        float I = IRow[x];
+        float Q = QRow[x];
+
+        Float2 sinCos0 = carrier0.SinCos(signalTexelIndexX);
+        Float2 sinCos1 = carrier1.SinCos(signalTexelIndexX);
+        Float2 chroma = {
+          sinCos0.x * I - sinCos0.y * Q,
+          sinCos1.x * I - sinCos1.y * Q };
+
+        Float4 signal = (consts.compositeBlend > 0.0f)
+          ? Float4{Y + chroma.x, Y + chroma.y, Y + chroma.x, Y + chroma.y}
+          : Float4{Y, chroma.x, Y, chroma.y};
+
+        ctx.output->Store(ctx.outputMip, x, y, signal);
+      }
+    }
+  }
+
+
+  // Generator_IndexedToSVideoOrComposite: cathode-retro-generator-indexed-to-svideo-or-composite.hlsl
+  struct IndexedToSVideoOrCompositeConstants
+  {
+    RGBToSVideoOrCompositeConstants common;
+    uint32_t paletteColorCount;
+    uint32_t phaseStepCount;
+  };
+
+
+  inline void GeneratorIndexedToSVideoOrComposite(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<IndexedToSVideoOrCompositeConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &scanlinePhases = ctx.inputs[1];
+    const CPUTextureView &paletteSignalTable = ctx.inputs[2];
+    uint32_t effectiveOutputWidth = consts.common.outputWidth - consts.common.sidePaddingTexelCount;
+
+    // The table is always sampled at the center of a row (one row per palette color), so its linear filtering only
+    //  ever blends two neighboring phase steps of the same color, and the table texels are read straight out of the
+    //  texture.
+    assert(paletteSignalTable.Texture()->Format() == CathodeRetro::TextureFormat::RG_Float32);
+    const Float2 *table = reinterpret_cast<const Float2 *>(
+      paletteSignalTable.Texture()->MipData(paletteSignalTable.BaseMip()));
+    uint32_t phaseStepCount = consts.phaseStepCount;
+
+    // Like the carrier in GeneratorRGBToSVideoOrComposite, the phase only advances by 1/texelsPerCycle of a cycle per
+    //  texel, so which two phase steps get blended (and by how much) only needs working out for one cycle's worth of
+    //  texels per scanline.
+    uint32_t texelsPerCycle = consts.common.outputTexelsPerColorburstCycle;
+    std::vector<PalettePhaseSteps> &phaseSteps = ThreadRowScratch().palettePhaseSteps;
+    phaseSteps.resize(size_t(texelsPerCycle) * 2);
+    auto calculateSteps = [&](float phase)
+    {
+      float stepCoord = phase * float(phaseStepCount);
+      float stepFloor = std::floor(stepCoord);
+      uint32_t step = uint32_t(stepFloor) % phaseStepCount;
+      return PalettePhaseSteps{step, (step + 1) % phaseStepCount, stepCoord - stepFloor};
+    };
+
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+      float v = (float(y) + 0.5f) / float(ctx.outputHeight);
+      uint32_t signalTexelIndexY = uint32_t(std::floor(v * float(consts.common.scanlineCount)));
+
+      float instability = CalculateTrackingInstabilityOffset(
+        signalTexelIndexY,
+        consts.common.noiseSeed,
+        consts.common.instabilityScale,
+        consts.common.outputWidth);
+
+      Float4 scanlinePhase = scanlinePhases.Sample(
+        Float2{0.0f, float(signalTexelIndexY) + 0.5f} / float(consts.common.scanlineCount));
+      for (uint32_t i = 0; i < texelsPerCycle; i++)
+      {
+        float xPhase = float(i) / float(texelsPerCycle);
+        phaseSteps[i * 2 + 0] = calculateSteps(Frac(scanlinePhase.x + xPhase));
+        phaseSteps[i * 2 + 1] = calculateSteps(Frac(scanlinePhase.y + xPhase));
+      }
+
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        float u = (float(x) + 0.5f) / float(ctx.outputWidth);
+        uint32_t signalTexelIndexX = uint32_t(std::floor(u * float(consts.common.outputWidth)));
+        Float2 texCoord =
+          (Float2{
+              float(signalTexelIndexX) * (float(consts.common.inputWidth) / float(consts.common.outputWidth)),
+              float(signalTexelIndexY)}
+            + Float2{0.25f, 0.5f})
+          / Float2{float(consts.common.inputWidth), float(consts.common.scanlineCount)};
+
+        texCoord.x = (texCoord.x - 0.5f) * float(consts.common.outputWidth) / float(effectiveOutputWidth) + 0.5f;
+        texCoord.x += instability;
+
+        uint32_t index = uint32_t(std::round(sourceTexture.Sample(texCoord).x * 255.0f));
+        const Float2 *colorRow = table + size_t(std::min(index, consts.paletteColorCount - 1)) * phaseStepCount;
+
+        const PalettePhaseSteps *steps = &phaseSteps[(signalTexelIndexX % texelsPerCycle) * 2];
+        Float2 signal0 = Lerp(colorRow[steps[0].step0], colorRow[steps[0].step1], steps[0].blend);
+        Float2 signal1 = Lerp(colorRow[steps[1].step0], colorRow[steps[1].step1], steps[1].blend);
+
+        Float4 signal = (consts.common.compositeBlend > 0.0f)
+          ? Float4{signal0.x + signal0.y, signal1.x + signal1.y, signal0.x + signal0.y, signal1.x + signal1.y}
+          : Float4{signal0.x, signal0.y, signal1.x, signal1.y};
+
+        ctx.output->Store(ctx.outputMip, x, y, signal);
+      }
+    }
+  }
+
+
+  // Generator_GeneratePaletteSignalTable: cathode-retro-generator-gen-palette-signal-table.hlsl
+  struct GeneratePaletteSignalTableConstants
+  {
+    uint32_t phaseStepCount;
+    uint32_t paletteColorCount;
+    uint32_t padding[2];
+    Float4 paletteColors[256];
+  };
+
+
+  inline void GeneratorGeneratePaletteSignalTable(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<GeneratePaletteSignalTableConstants>();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 texCoord)
+    {
+      uint32_t phaseIndex = uint32_t(std::floor(texCoord.x * float(consts.phaseStepCount)));
+      uint32_t colorIndex = uint32_t(std::floor(texCoord.y * float(consts.paletteColorCount)));
+      const Float4 &rgb = consts.paletteColors[colorIndex];
+
+      float Y = DotRGB(rgb, 0.3000f,  0.5900f,  0.1100f);
+      float I = DotRGB(rgb, 0.5990f, -0.2773f, -0.3217f);
+      float Q = DotRGB(rgb, 0.2130f, -0.5251f,  0.3121f);
+
+      Y = std::pow(Saturate(Y), 2.2f / 2.0f);
+      float iqSat = Saturate(Length(Float2{I, Q}));
+      float iqScale = std::pow(iqSat, 2.2f / 2.0f) / std::max(0.00001f, iqSat);
+      I *= iqScale;
+      Q *= iqScale;
+
+      float angle = 2.0f * k_pi * float(phaseIndex) / float(consts.phaseStepCount);
+      return Float4{Y, std::sin(angle) * I - std::cos(angle) * Q, 0.0f, 0.0f};
+    });
+  }
+
+
+  // Generator_ApplyArtifacts: cathode-retro-generator-apply-artifacts.hlsl
+  struct ApplyArtifactsConstants
+  {
+    float ghostVisibility;
+    float ghostDistance;
+    float ghostSpreadScale;
+    float noiseStrength;
+    uint32_t noiseSeed;
+    uint32_t signalTextureWidth;
+    uint32_t scanlineCount;
+    uint32_t samplesPerColorburstCycle;
+  };
+
+
+  inline void GeneratorApplyArtifacts(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<ApplyArtifactsConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    Float2 signalSize = {float(consts.signalTextureWidth), float(consts.scanlineCount)};
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inputTexCoord)
+    {
+      Float4 signal = sourceTexture.Sample(inputTexCoord);
+      if (consts.ghostVisibility != 0.0f)
+      {
+        Float2 ghostCenterCoord = inputTexCoord
+          + Float2{consts.ghostDistance * float(consts.samplesPerColorburstCycle), 0.0f} / signalSize;
+        Float2 ghostSampleSpread = Float2{consts.ghostSpreadScale * float(consts.samplesPerColorburstCycle), 0.0f}
+          / signalSize;
+
+        Float4 ghost;
+        ghost =  sourceTexture.Sample(ghostCenterCoord - ghostSampleSpread * 1.174285279339f) * 0.0436893869f;
+        ghost += sourceTexture.Sample(ghostCenterCoord - ghostSampleSpread * 1.339243613069f) * 0.323030611f;
+        ghost += sourceTexture.Sample(ghostCenterCoord) * 0.266559988f;
+        ghost += sourceTexture.Sample(ghostCenterCoord + ghostSampleSpread * 1.339243613069f) * 0.323030611f;
+        ghost += sourceTexture.Sample(ghostCenterCoord + ghostSampleSpread * 1.174285279339f) * 0.0436893869f;
+
+        signal += ghost * consts.ghostVisibility;
+      }
+
+      Float2 pixelIndex = inputTexCoord
+        * Float2{
+          float(consts.signalTextureWidth) / (float(consts.samplesPerColorburstCycle) * 2.0f / 3.0f),
+          float(consts.scanlineCount)};
+      float xFrac = Frac(pixelIndex.x);
+      pixelIndex = {std::floor(pixelIndex.x), std::floor(pixelIndex.y)};
+
+      float noiseL = Noise2D(pixelIndex, float(consts.noiseSeed));
+      float noiseR = Noise2D(pixelIndex + Float2{1.0f, 0.0f}, float(consts.noiseSeed));
+      float noise = Lerp(noiseL, noiseR, xFrac) * 2.0f - 1.0f;
+
+      return (signal + noise * consts.noiseStrength) / (1.0f + consts.ghostVisibility);
+    });
+  }
+
+
+  // Decoder_CompositeToSVideo: cathode-retro-decoder-composite-to-svideo.hlsl
+  inline void DecoderCompositeToSVideo(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    uint32_t samplesPerColorburstCycle = ctx.Constants<uint32_t>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+
+    if (ctx.outputWidth == sourceTexture.Width() && ctx.outputHeight == sourceTexture.Height())
+    {
+      // Every output texel is exactly on top of an input texel, so we can run the box filter a whole row (of the
+      //  region) at a time.
+      uint32_t left = ctx.region.left;
+      uint32_t width = ctx.region.right - left;
+      RowScratch &scratch = ThreadRowScratch();
+      scratch.boxFilterOutput.resize(size_t(width) * 2);
+      Float4 *luma = scratch.boxFilterOutput.data();
+      Float4 *centerSamples = luma + width;
+      for (uint32_t y = rowBegin; y < rowEnd; y++)
+      {
+        BoxFilterRow(
+          sourceTexture,
+          int32_t(y),
+          int32_t(left),
+          width,
+          samplesPerColorburstCycle,
+          &scratch.boxFilterRow,
+          luma,
+          centerSamples);
+
+        for (uint32_t x = left; x < ctx.region.right; x++)
+        {
+          const Float4 &l = luma[x - left];
+          const Float4 &c = centerSamples[x - left];
+          ctx.output->Store(ctx.outputMip, x, y, Float4{l.x, c.x - l.x, l.y, c.y - l.y});
+        }
+      }
+
+      return;
+    }
+
+    Float2 invInputTexDim = Float2{1.0f, 1.0f} / sourceTexture.Size();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTex)
+    {
+      Float4 centerSample;
+      Float4 luma = BoxFilter(sourceTexture, invInputTexDim, samplesPerColorburstCycle, inTex, &centerSample);
+
+      return Float4{luma.x, centerSample.x - luma.x, luma.y, centerSample.y - luma.y};
+    });
+  }
+
+
+  // Decoder_SVideoToModulatedChroma: cathode-retro-decoder-svideo-to-modulated-chroma.hlsl
+  struct SVideoToModulatedChromaConstants
+  {
+    uint32_t samplesPerColorburstCycle;
+    float tint;
+    uint32_t inputWidth;
+  };
+
+
+  inline void DecoderSVideoToModulatedChroma(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<SVideoToModulatedChromaConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &scanlinePhases = ctx.inputs[1];
+
+    // The phases texture has one texel per scanline, so the carrier only needs to be worked out once per row.
+    ScanlineCarrier carrier0;
+    ScanlineCarrier carrier1;
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+      float v = (float(y) + 0.5f) / float(ctx.outputHeight);
+
+      Float4 phases = scanlinePhases.Sample({v, v});
+      carrier0.Reset(phases.x + consts.tint, consts.samplesPerColorburstCycle);
+      carrier1.Reset(phases.y + consts.tint, consts.samplesPerColorburstCycle);
+
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        Float2 inTexCoord = {(float(x) + 0.5f) / float(ctx.outputWidth), v};
+        uint32_t sampleXIndex = uint32_t(std::floor(inTexCoord.x * float(consts.inputWidth)));
+
+        Float4 source = sourceTexture.Sample(inTexCoord);
+        Float4 chroma = {source.y, source.y, source.w, source.w};
+
+        Float2 sinCos0 = carrier0.SinCos(sampleXIndex);
+        Float2 sinCos1 = carrier1.SinCos(sampleXIndex);
+        ctx.output->Store(ctx.outputMip, x, y, chroma * Float4{sinCos0.x, -sinCos0.y, sinCos1.x, -sinCos1.y});
+      }
+    }
+  }
+
+
+  // Decoder_SVideoToRGB: cathode-retro-decoder-svideo-to-rgb.hlsl
+  struct SVideoToRGBConstants
+  {
+    uint32_t samplesPerColorburstCycle;
+    float saturation;
+    float brightness;
+    float blackLevel;
+    float whiteLevel;
+    float temporalArtifactReduction;
+    uint32_t inputWidth;
+    uint32_t outputWidth;
+  };
+
+
+  // The part of Decoder_SVideoToRGB that happens after the sampling and filtering, up to the conversion back to RGB:
+  //  adjust the levels and blend the two phases together. Returns {y, i, q} (in x, y, and z).
+  inline Float4 SVideoToRGBAdjustYIQ(const SVideoToRGBConstants &consts, Float4 source, Float4 IQ)
+  {
+    Float2 Y = {source.x, source.z};
+
+    Y = (Y - consts.blackLevel) / (consts.whiteLevel - consts.blackLevel) * consts.brightness;
+    IQ *= consts.saturation;
+
+    float y = Lerp(Y.x, Y.y, consts.temporalArtifactReduction * 0.5f);
+    Float2 iq = Lerp(Float2{IQ.x, IQ.y}, Float2{IQ.z, IQ.w}, consts.temporalArtifactReduction * 0.5f);
+    return Float4{y, iq.x, iq.y, 0.0f};
+  }
+
+
+  // The part of Decoder_SVideoToRGB that happens after the sampling and filtering: adjust the levels and convert YIQ
+  //  to RGB.
+  inline Float4 SVideoToRGBFromYIQ(const SVideoToRGBConstants &consts, Float4 source, Float4 IQ)
+  {
+    Float4 yiq = SVideoToRGBAdjustYIQ(consts, source, IQ);
+    Float4 rgb = {0.0f, 0.0f, 0.0f, 1.0f};
+    CPUYIQKernels::Scalar::YIQToRGB(yiq.x, yiq.y, yiq.z, &rgb.x, &rgb.y, &rgb.z);
+    return rgb;
+  }
+
+
+  inline void DecoderSVideoToRGB(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<SVideoToRGBConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &modulatedChromaTexture = ctx.inputs[1];
+    uint32_t filterWidth = 2U * consts.samplesPerColorburstCycle;
+
+    // The output is centered in the (wider) signal, so if the difference in widths is even then every output texel
+    //  lands exactly on a signal texel and we can box filter whole rows at a time.
+    if (consts.inputWidth >= consts.outputWidth
+      && (consts.inputWidth - consts.outputWidth) % 2U == 0
+      && sourceTexture.Width() == consts.inputWidth
+      && modulatedChromaTexture.Width() == consts.inputWidth
+      && sourceTexture.Height() == ctx.outputHeight
+      && modulatedChromaTexture.Height() == ctx.outputHeight)
+    {
+      int32_t firstSignalX = int32_t((consts.inputWidth - consts.outputWidth) / 2U);
+      uint32_t left = ctx.region.left;
+      uint32_t width = ctx.region.right - left;
+      RowScratch &scratch = ThreadRowScratch();
+      scratch.boxFilterOutput.resize(width);
+      Float4 *IQ = scratch.boxFilterOutput.data();
+
+      // The adjusted YIQ values go into separate rows so that the conversion to RGB can run on the whole row at once
+      //  (see CPUYIQKernels.h).
+      scratch.channels.resize(size_t(ctx.outputWidth) * 6);
+      float *yRow = scratch.channels.data();
+      float *iRow = yRow + ctx.outputWidth;
+      float *qRow = iRow + ctx.outputWidth;
+      float *rRow = qRow + ctx.outputWidth;
+      float *gRow = rRow + ctx.outputWidth;
+      float *bRow = gRow + ctx.outputWidth;
+      for (uint32_t y = rowBegin; y < rowEnd; y++)
+      {
+        BoxFilterRow(
+          modulatedChromaTexture,
+          int32_t(y),
+          firstSignalX + int32_t(left),
+          width,
+          filterWidth,
+          &scratch.boxFilterRow,
+          IQ,
+          nullptr);
+
+        for (uint32_t x = left; x < ctx.region.right; x++)
+        {
+          Float4 source = sourceTexture.Load(firstSignalX + int32_t(x), int32_t(y));
+          Float4 yiq = SVideoToRGBAdjustYIQ(consts, source, IQ[x - left]);
+          yRow[x] = yiq.x;
+          iRow[x] = yiq.y;
+          qRow[x] = yiq.z;
+        }
+
+        CPUYIQKernels::YIQToRGBRow(
+          yRow + left, iRow + left, qRow + left,
+          rRow + left, gRow + left, bRow + left,
+          width);
+
+        for (uint32_t x = left; x < ctx.region.right; x++)
+        {
+          ctx.output->Store(ctx.outputMip, x, y, Float4{rRow[x], gRow[x], bRow[x], 1.0f});
+        }
+      }
+
+      return;
+    }
+
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      inTexCoord.x = (inTexCoord.x - 0.5f) * float(consts.outputWidth) / float(consts.inputWidth) + 0.5f;
+
+      Float4 IQ = BoxFilter(
+        modulatedChromaTexture,
+        {1.0f / float(consts.inputWidth), 0.0f},
+        filterWidth,
+        inTexCoord,
+        nullptr);
+
+      return SVideoToRGBFromYIQ(consts, sourceTexture.Sample(inTexCoord), IQ);
+    });
+  }
+
+
+  // Decoder_SVideoToDecimatedIQ: cathode-retro-decoder-svideo-to-decimated-iq.hlsl
+  struct SVideoToDecimatedIQConstants
+  {
+    uint32_t samplesPerColorburstCycle;
+    float tint;
+    uint32_t inputWidth;
+    uint32_t outputWidth;
+  };
+
+
+  inline void DecoderSVideoToDecimatedIQ(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<SVideoToDecimatedIQConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &scanlinePhases = ctx.inputs[1];
+    int32_t filterRadius = int32_t(consts.samplesPerColorburstCycle);
+    float invFilterWidth = 1.0f / float(2U * consts.samplesPerColorburstCycle);
+
+    if (ctx.region.left == ctx.region.right)
+    {
+      return;
+    }
+
+    // Modulate each scanline's chroma once, then every output texel is a weighted sum of a window of it.
+    //  modulated[i] is the modulated chroma of signal texel (i - filterRadius), and it extends far enough past either
+    //  end of the scanline (repeating the edge texel and its carrier, as clamped addressing would) to cover every
+    //  output texel's window. Only the texels in the windows of the region's output texels get modulated (which
+    //  includes an edge texel whenever a window reaches past it).
+    uint32_t signalTexelCount = std::max(consts.inputWidth, ctx.outputWidth * consts.samplesPerColorburstCycle);
+    uint32_t firstCenter = ctx.region.left * consts.samplesPerColorburstCycle + consts.samplesPerColorburstCycle / 2U;
+    uint32_t lastCenter = (ctx.region.right - 1) * consts.samplesPerColorburstCycle
+      + consts.samplesPerColorburstCycle / 2U;
+    uint32_t modulateBegin = (firstCenter > uint32_t(filterRadius)) ? firstCenter - uint32_t(filterRadius) : 0;
+    uint32_t modulateEnd = std::min(lastCenter + uint32_t(filterRadius) + 1, consts.inputWidth);
+
+    ScanlineCarrier carrier0;
+    ScanlineCarrier carrier1;
+    std::vector<Float4> &modulated = ThreadRowScratch().modulatedChroma;
+    modulated.resize(signalTexelCount + 2U * uint32_t(filterRadius));
+    for (uint32_t y = rowBegin; y < rowEnd; y++)
+    {
+      float v = (float(y) + 0.5f) / float(ctx.outputHeight);
+
+      Float4 phases = scanlinePhases.Sample({v, v});
+      carrier0.Reset(phases.x + consts.tint, consts.samplesPerColorburstCycle);
+      carrier1.Reset(phases.y + consts.tint, consts.samplesPerColorburstCycle);
+
+      // The carrier index is tracked alongside x, rather than taking it modulo samplesPerColorburstCycle every texel.
+      uint32_t carrierIndex = modulateBegin % consts.samplesPerColorburstCycle;
+      for (uint32_t x = modulateBegin; x < modulateEnd; x++)
+      {
+        Float4 source = sourceTexture.Load(int32_t(x), int32_t(y));
+        Float4 chroma = {source.y, source.y, source.w, source.w};
+
+        Float2 sinCos0 = carrier0.SinCos(carrierIndex);
+        Float2 sinCos1 = carrier1.SinCos(carrierIndex);
+        modulated[x + uint32_t(filterRadius)] = chroma * Float4{sinCos0.x, -sinCos0.y, sinCos1.x, -sinCos1.y};
+
+        carrierIndex = (carrierIndex + 1 == consts.samplesPerColorburstCycle) ? 0 : carrierIndex + 1;
+      }
+
+      // Past the ends, both the texel and its carrier are the edge texel's, so the modulated value is too.
+      if (modulateBegin == 0)
+      {
+        std::fill(modulated.begin(), modulated.begin() + filterRadius, modulated[uint32_t(filterRadius)]);
+      }
+
+      if (modulateEnd == consts.inputWidth)
+      {
+        std::fill(
+          modulated.begin() + filterRadius + int32_t(consts.inputWidth),
+          modulated.end(),
+          modulated[uint32_t(filterRadius) + consts.inputWidth - 1]);
+      }
+
+      for (uint32_t x = ctx.region.left; x < ctx.region.right; x++)
+      {
+        // The window for the signal texel at center starts at modulated[center], since that's filterRadius texels to
+        //  its left. The texels at either end get half weight.
+        uint32_t center = x * consts.samplesPerColorburstCycle + consts.samplesPerColorburstCycle / 2U;
+        uint32_t begin = center;
+        uint32_t end = center + 2U * uint32_t(filterRadius);
+
+        Float4 IQ = (modulated[begin] + modulated[end]) * 0.5f;
+        for (uint32_t i = begin + 1; i < end; i++)
+        {
+          IQ += modulated[i];
+        }
+
+        ctx.output->Store(ctx.outputMip, x, y, IQ * invFilterWidth);
+      }
+    }
+  }
+
+
+  // Decoder_SVideoAndDecimatedIQToRGB: cathode-retro-decoder-svideo-and-decimated-iq-to-rgb.hlsl
+  struct SVideoAndDecimatedIQToRGBConstants
+  {
+    SVideoToRGBConstants common;
+    uint32_t iqWidth;
+  };
+
+
+  inline void DecoderSVideoAndDecimatedIQToRGB(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<SVideoAndDecimatedIQToRGBConstants>();
+    const SVideoToRGBConstants &common = consts.common;
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    const CPUTextureView &decimatedIQTexture = ctx.inputs[1];
+    float samplesPerCycle = float(common.samplesPerColorburstCycle);
+
+    // Same as the full-resolution decode: if every output texel lands exactly on a signal texel, go a row at a time.
+    if (common.inputWidth >= common.outputWidth
+      && (common.inputWidth - common.outputWidth) % 2U == 0
+      && sourceTexture.Width() == common.inputWidth
+      && decimatedIQTexture.Width() == consts.iqWidth
+      && sourceTexture.Height() == ctx.outputHeight
+      && decimatedIQTexture.Height() == ctx.outputHeight)
+    {
+      int32_t firstSignalX = int32_t((common.inputWidth - common.outputWidth) / 2U);
+      uint32_t left = ctx.region.left;
+      uint32_t width = ctx.region.right - left;
+
+      // Signal texel k = m * samplesPerCycle + p lines up with position m + p / samplesPerCycle in the decimated
+      //  texture (see the shader), so it blends between decimated texels m + floor(p / samplesPerCycle - 0.5) and the
+      //  one after it. Only the part that depends on p changes within a color cycle, so that's worked out up front.
+      RowScratch &scratch = ThreadRowScratch();
+      std::vector<DecimatedIQBlend> &blends = scratch.decimatedIQBlends;
+      blends.resize(common.samplesPerColorburstCycle);
+      for (uint32_t i = 0; i < common.samplesPerColorburstCycle; i++)
+      {
+        float position = float(i) / samplesPerCycle - 0.5f;
+        blends[i] = {int32_t(std::floor(position)), position - std::floor(position)};
+      }
+
+      // Each row of the decimated IQ is loaded once (with an extra texel on either end, for the clamping) rather than
+      //  twice per output texel.
+      std::vector<Float4> &iqRow = scratch.decimatedIQRow;
+      iqRow.resize(consts.iqWidth + 2);
+      scratch.channels.resize(size_t(ctx.outputWidth) * 6);
+      float *yRow = scratch.channels.data();
+      float *iRow = yRow + ctx.outputWidth;
+      float *qRow = iRow + ctx.outputWidth;
+      float *rRow = qRow + ctx.outputWidth;
+      float *gRow = rRow + ctx.outputWidth;
+      float *bRow = gRow + ctx.outputWidth;
+      for (uint32_t y = rowBegin; y < rowEnd; y++)
+      {
+        for (uint32_t i = 0; i < iqRow.size(); i++)
+        {
+          iqRow[i] = decimatedIQTexture.Load(int32_t(i) - 1, int32_t(y));
+        }
+
+        uint32_t cycle = (uint32_t(firstSignalX) + left) / common.samplesPerColorburstCycle;
+        uint32_t phaseIndex = (uint32_t(firstSignalX) + left) % common.samplesPerColorburstCycle;
+        for (uint32_t x = left; x < ctx.region.right; x++)
+        {
+          const DecimatedIQBlend &blend = blends[phaseIndex];
+          int32_t iqX = std::min(std::max(int32_t(cycle) + blend.offset, -1), int32_t(consts.iqWidth) - 1);
+          Float4 IQ = Lerp(iqRow[size_t(iqX + 1)], iqRow[size_t(iqX + 2)], blend.amount);
+
+          Float4 yiq = SVideoToRGBAdjustYIQ(common, sourceTexture.Load(firstSignalX + int32_t(x), int32_t(y)), IQ);
+          yRow[x] = yiq.x;
+          iRow[x] = yiq.y;
+          qRow[x] = yiq.z;
+
+          if (++phaseIndex == common.samplesPerColorburstCycle)
+          {
+            phaseIndex = 0;
+            cycle++;
+          }
+        }
+
+        CPUYIQKernels::YIQToRGBRow(
+          yRow + left, iRow + left, qRow + left,
+          rRow + left, gRow + left, bRow + left,
+          width);
+
+        for (uint32_t x = left; x < ctx.region.right; x++)
+        {
+          ctx.output->Store(ctx.outputMip, x, y, Float4{rRow[x], gRow[x], bRow[x], 1.0f});
+        }
+      }
+
+      return;
+    }
+
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      inTexCoord.x = (inTexCoord.x - 0.5f) * float(common.outputWidth) / float(common.inputWidth) + 0.5f;
+
+      float iqX = (inTexCoord.x * float(common.inputWidth) - 0.5f) / samplesPerCycle;
+      Float4 IQ = decimatedIQTexture.Sample({iqX / float(consts.iqWidth), inTexCoord.y});
+
+      return SVideoToRGBFromYIQ(common, sourceTexture.Sample(inTexCoord), IQ);
+    });
+  }
+
+
+  // Decoder_FilterRGB: cathode-retro-decoder-filter-rgb.hlsl
+  struct FilterRGBConstants
+  {
+    float blurStrength;
+    float stepSize;
+  };
+
+
+  inline void DecoderFilterRGB(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<FilterRGBConstants>();
+    const CPUTextureView &sourceTexture = ctx.inputs[0];
+    Float2 step = {consts.stepSize / float(ctx.outputWidth), 0.0f};
+    float blurSide = consts.blurStrength / 3.0f;
+    float blurCenter = 1.0f - 2.0f * blurSide;
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      return sourceTexture.Sample(inTexCoord - step) * blurSide
+        + sourceTexture.Sample(inTexCoord) * blurCenter
+        + sourceTexture.Sample(inTexCoord + step) * blurSide;
+    });
+  }
+
+
+  // CRT_GenerateScreenTexture: cathode-retro-crt-generate-screen-texture.hlsl
+  struct GenerateScreenTextureConstants
+  {
+    Float2 viewScale;
+    Float2 overscanScale;
+    Float2 overscanOffset;
+    Float2 distortion;
+    Float2 maskDistortion;
+    Float2 maskScale;
+    float aspect;
+    float roundedCornerSize;
+  };
+
+
+  inline void CRTGenerateScreenTexture(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    // 64-tap poisson disc, from https://www.geeks3d.com/20100628/3d-programming-ready-to-use-64-sample-poisson-disc/
+    static constexpr Float2 k_samplingPattern[] =
+    {
+      {-0.613392f, 0.617481f}, {0.170019f, -0.040254f}, {-0.299417f, 0.791925f}, {0.645680f, 0.493210f},
+      {-0.651784f, 0.717887f}, {0.421003f, 0.027070f}, {-0.817194f, -0.271096f}, {-0.705374f, -0.668203f},
+      {0.977050f, -0.108615f}, {0.063326f, 0.142369f}, {0.203528f, 0.214331f}, {-0.667531f, 0.326090f},
+      {-0.098422f, -0.295755f}, {-0.885922f, 0.215369f}, {0.566637f, 0.605213f}, {0.039766f, -0.396100f},
+      {0.751946f, 0.453352f}, {0.078707f, -0.715323f}, {-0.075838f, -0.529344f}, {0.724479f, -0.580798f},
+      {0.222999f, -0.215125f}, {-0.467574f, -0.405438f}, {-0.248268f, -0.814753f}, {0.354411f, -0.887570f},
+      {0.175817f, 0.382366f}, {0.487472f, -0.063082f}, {-0.084078f, 0.898312f}, {0.488876f, -0.783441f},
+      {0.470016f, 0.217933f}, {-0.696890f, -0.549791f}, {-0.149693f, 0.605762f}, {0.034211f, 0.979980f},
+      {0.503098f, -0.308878f}, {-0.016205f, -0.872921f}, {0.385784f, -0.393902f}, {-0.146886f, -0.859249f},
+      {0.643361f, 0.164098f}, {0.634388f, -0.049471f}, {-0.688894f, 0.007843f}, {0.464034f, -0.188818f},
+      {-0.440840f, 0.137486f}, {0.364483f, 0.511704f}, {0.034028f, 0.325968f}, {0.099094f, -0.308023f},
+      {0.693960f, -0.366253f}, {0.678884f, -0.204688f}, {0.001801f, 0.780328f}, {0.145177f, -0.898984f},
+      {0.062655f, -0.611866f}, {0.315226f, -0.604297f}, {-0.780145f, 0.486251f}, {-0.371868f, 0.882138f},
+      {0.200476f, 0.494430f}, {-0.494552f, -0.711051f}, {0.612476f, 0.705252f}, {-0.578845f, -0.768792f},
+      {-0.772454f, -0.090976f}, {0.504440f, 0.372295f}, {0.155736f, 0.065157f}, {0.391522f, 0.849605f},
+      {-0.620106f, -0.328104f}, {0.789239f, -0.419965f}, {-0.545396f, 0.538133f}, {-0.178564f, -0.596057f},
+    };
+
+    constexpr uint32_t k_samplePointCount = uint32_t(sizeof(k_samplingPattern) / sizeof(k_samplingPattern[0]));
+
+    const auto &consts = ctx.Constants<GenerateScreenTextureConstants>();
+    const CPUTextureView &maskTexture = ctx.inputs[0];
+
+    // This doesn't read the distortion texture, even when there is one: it also needs the x derivative of t and the
+    //  separately-distorted mask coordinate (neither of which that texture holds), it has to work without one, and it
+    //  only runs when the screen texture's settings change (just like the distortion texture itself).
+    CRTDistortion distortion = PrepareCRTDistortion(consts.distortion);
+    CRTDistortion maskDistortion = PrepareCRTDistortion({consts.maskDistortion.y, consts.maskDistortion.x});
+
+    // The shader uses ddx/ddy on a couple of values, so this calculates them at a given coordinate so we can get the
+    //  derivatives using the neighboring pixels.
+    auto calculateCoordinates = [&](Float2 inTexCoord, Float2 *t, Float2 *maskT)
+    {
+      Float2 scaledTexCoord = (inTexCoord * 2.0f - 1.0f) * consts.viewScale;
+      *t = DistortCRTCoordinates(scaledTexCoord, distortion);
+      *maskT = DistortCRTCoordinates(*t, maskDistortion);
+      *t = *t * consts.overscanScale + consts.overscanOffset * 2.0f;
+      return scaledTexCoord;
+    };
+
+    Float2 texelSize = {1.0f / float(ctx.outputWidth), 1.0f / float(ctx.outputHeight)};
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float2 t;
+      Float2 maskT;
+      Float2 scaledTexCoord = calculateCoordinates(inTexCoord, &t, &maskT);
+
+      Float2 ddxT;
+      Float2 ddxMaskT;
+      calculateCoordinates(inTexCoord + Float2{texelSize.x, 0.0f}, &ddxT, &ddxMaskT);
+      ddxT -= t;
+      ddxMaskT -= maskT;
+
+      Float2 ddyT;
+      Float2 ddyMaskT;
+      calculateCoordinates(inTexCoord + Float2{0.0f, texelSize.y}, &ddyT, &ddyMaskT);
+      ddyT -= t;
+      ddyMaskT -= maskT;
+
+      float edgeDist;
+      {
+        Float2 sq = Float2{consts.aspect, 1.0f} / std::max(1.0f, consts.aspect);
+        Float2 upperQuadrantT = {std::abs(maskT.x), std::abs(maskT.y)};
+
+        Float2 q = upperQuadrantT * sq - sq + consts.roundedCornerSize;
+        edgeDist = std::min(std::max(q.x, q.y), 0.0f)
+          + Length({std::max(q.x, 0.0f), std::max(q.y, 0.0f)})
+          - consts.roundedCornerSize;
+      }
+
+      float maskAlpha = 1.0f - Smoothstep(-Length(ddxMaskT + ddyMaskT), 0.0f, edgeDist);
+      if (std::max(std::abs(scaledTexCoord.x), std::abs(scaledTexCoord.y)) > 1.1f)
+      {
+        maskAlpha = 0.0f;
+      }
+
+      float angle = Noise2D(t * 1000.0f, 10.0f) * 6.28318531f;
+      Float2 rotX = Float2{std::sin(angle), std::cos(angle)} * 1.414f;
+      Float2 rotY = {-rotX.y, rotX.x};
+
+      Float2 dxT = {Dot(rotX, ddxT), Dot(rotY, ddxT)};
+      Float2 dyT = {Dot(rotX, ddyT), Dot(rotY, ddyT)};
+
+      // Every one of the samples has (effectively) the same derivatives, so the mip level only needs calculating once.
+      float level = maskTexture.CalculateLevel(ddxT * consts.maskScale, ddyT * consts.maskScale, -2.0f);
+      Float4 color = {0.0f, 0.0f, 0.0f, 0.0f};
+      for (uint32_t i = 0; i < k_samplePointCount; i++)
+      {
+        color += maskTexture.SampleLevel(
+          (t + k_samplingPattern[i].x * dxT + k_samplingPattern[i].y * dyT) * consts.maskScale,
+          level);
+      }
+
+      color *= 1.0f / float(k_samplePointCount);
+
+      return Float4{color.x, color.y, color.z, maskAlpha};
+    });
+  }
+
+
+  // CRT_GenerateSlotMask: cathode-retro-crt-generate-slot-mask.hlsl
+  inline void CRTGenerateSlotMask(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    Float2 texSize = ctx.Constants<Float2>();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float2 texelIndex = inTexCoord * texSize - 0.5f;
+      Float2 t = Float2{float(uint32_t(texelIndex.x)), float(uint32_t(texelIndex.y))} / texSize.x * Float2{1.0f, 2.0f};
+
+      if (t.x > 0.5f)
+      {
+        t.y = Frac(t.y + 0.5f);
+        t.x = t.x * 2.0f - 1.0f;
+      }
+      else
+      {
+        t.x *= 2.0f;
+      }
+
+      t.x *= 3.0f;
+
+      Float4 color = {1.0f, 0.0f, 0.0f, 1.0f};
+      if (t.x >= 2.0f)
+      {
+        color = {0.0f, 0.0f, 1.0f, 1.0f};
+      }
+      else if (t.x >= 1.0f)
+      {
+        color = {0.0f, 1.0f, 0.0f, 1.0f};
+      }
+
+      t.x = Frac(t.x);
+      t.x /= 3.0f;
+
+      Float2 border = {1.0f / 3.0f * (1.0f / 4.0f), 1.0f / 6.0f};
+      float rounding = border.x / 3.0f;
+      border = border - rounding;
+
+      t -= Float2{1.0f / 6.0f, 0.5f};
+      t = {std::abs(t.x), std::abs(t.y)};
+      t -= Float2{1.0f / 6.0f, 0.5f} - (border + rounding);
+      t = t / rounding;
+      t = {std::max(0.0f, t.x), std::max(0.0f, t.y)};
+
+      float distance = Length(t);
+      float delta = 1.0f / (texSize.x * rounding);
+      float mul = Saturate(1.0f - Smoothstep(1.0f - delta * 0.5f, 1.0f + delta * 0.5f, distance));
+
+      return Float4{color.x * mul, color.y * mul, color.z * mul, 1.0f};
+    });
+  }
+
+
+  // CRT_GenerateShadowMask: cathode-retro-crt-generate-shadow-mask.hlsl
+  inline void CRTGenerateShadowMask(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float2 hexGridF = inTexCoord * Float2{6.0f, 4.0f};
+
+      bool isOddBlock = (Frac(hexGridF.y * 0.5f) >= 0.5f);
+      if (isOddBlock)
+      {
+        hexGridF.x += 0.5f;
+      }
+
+      int32_t hexIDX = int32_t(std::floor(hexGridF.x));
+      int32_t hexIDY = int32_t(std::floor(hexGridF.y));
+
+      Float2 cellCoord = Frac(hexGridF);
+
+      constexpr float t = 0.5773502691f; // tan(30 degrees)
+      constexpr float c = 0.5f * t;
+
+      if (cellCoord.y < (-t * cellCoord.x) + c)
+      {
+        hexIDY--;
+        hexGridF.x += isOddBlock ? -0.5f : 0.5f;
+        hexIDX -= int32_t(isOddBlock);
+      }
+      else if (cellCoord.y < (t * cellCoord.x) - c)
+      {
+        hexIDY--;
+        hexGridF.x += isOddBlock ? -0.5f : 0.5f;
+        hexIDX += int32_t(!isOddBlock);
+      }
+
+      if (Frac(float(hexIDY) * 0.5f) >= 0.5f)
+      {
+        hexGridF.x++;
+        hexIDX++;
+      }
+
+      Float4 color;
+
+      uint32_t hx = uint32_t(hexIDX + 1);
+      if ((hx % 3U) == 0U)
+      {
+        color = {1.0f, 0.0f, 0.0f, 1.0f};
+      }
+      else if ((hx % 3U) == 1U)
+      {
+        color = {0.0f, 1.0f, 0.0f, 1.0f};
+      }
+      else
+      {
+        color = {0.0f, 0.0f, 1.0f, 1.0f};
+      }
+
+      cellCoord = (hexGridF - Float2{float(hexIDX), float(hexIDY)}) * Float2{1.0f, 1.0f / (1.0f + c)};
+      cellCoord = cellCoord * 2.0f - 1.0f;
+
+      float dist = 1.0f - Smoothstep(0.75f, 0.8f, Length(cellCoord));
+
+      return Float4{color.x * dist, color.y * dist, color.z * dist, 1.0f};
+    });
+  }
+
+
+  // CRT_GenerateApertureGrille: cathode-retro-crt-generate-aperture-grille.hlsl
+  inline void CRTGenerateApertureGrille(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    Float2 texSize = ctx.Constants<Float2>();
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      uint32_t texelIndex = uint32_t(inTexCoord.x * texSize.x - 0.5f);
+      float x = float(texelIndex) / texSize.x;
+
+      x = Frac(x * 2.0f) * 3.0f;
+
+      Float4 color = {1.0f, 0.0f, 0.0f, 1.0f};
+      if (x >= 2.0f)
+      {
+        color = {0.0f, 0.0f, 1.0f, 1.0f};
+      }
+      else if (x >= 1.0f)
+      {
+        color = {0.0f, 1.0f, 0.0f, 1.0f};
+      }
+
+      x = Frac(x);
+      x /= 3.0f;
+
+      float border = 1.0f / 12.0f;
+      float smoothing = border / 3.0f;
+      border -= smoothing;
+
+      x = std::abs(x - 1.0f / 6.0f);
+      x -= 1.0f / 6.0f - (smoothing + border);
+      x /= smoothing;
+      x = std::max(0.0f, x);
+
+      float delta = 1.0f / (texSize.x * smoothing);
+      float mul = Saturate(1.0f - Smoothstep(1.0f - delta * 0.5f, 1.0f + delta * 0.5f, x));
+
+      return Float4{color.x * mul, color.y * mul, color.z * mul, 1.0f};
+    });
+  }
+
+
+  // CRT_GenerateDistortionTexture: cathode-retro-crt-generate-distortion-texture.hlsl
+  struct GenerateDistortionTextureConstants
+  {
+    Float2 viewScale;
+    Float2 overscanScale;
+    Float2 overscanOffset;
+    Float2 distortion;
+  };
+
+
+  // The texture coordinate that CRTRGBToCRT samples the current frame at (before its even/odd adjustment), for a given
+  //  output texture coordinate. The constants only need the four values that both shaders start with, and distortion
+  //  is PrepareCRTDistortion(consts.distortion).
+  template <typename ConstantsType>
+  inline Float2 CalculateDistortedCoordinate(
+    const ConstantsType &consts,
+    const CRTDistortion &distortion,
+    Float2 inTexCoord)
+  {
+    return DistortCRTCoordinates((inTexCoord * 2.0f - 1.0f) * consts.viewScale, distortion)
+      * consts.overscanScale
+      + consts.overscanOffset * 2.0f;
+  }
+
+
+  inline void CRTGenerateDistortionTexture(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    const auto &consts = ctx.Constants<GenerateDistortionTextureConstants>();
+    CRTDistortion distortion = PrepareCRTDistortion(consts.distortion);
+
+    float texelHeight = 1.0f / float(ctx.outputHeight);
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float2 t = CalculateDistortedCoordinate(consts, distortion, inTexCoord);
+      Float2 ddyT = CalculateDistortedCoordinate(consts, distortion, inTexCoord + Float2{0.0f, texelHeight}) - t;
+      return Float4{t.x, t.y, ddyT.x, ddyT.y};
+    });
+  }
+
+
+  // CRT_RGBToCRT: cathode-retro-crt-rgb-to-crt.hlsl
+  struct RGBToCRTConstants
+  {
+    Float2 viewScale;
+    Float2 overscanScale;
+    Float2 overscanOffset;
+    Float2 distortion;
+    Float4 backgroundColor;
+    float phosphorPersistence;
+    float scanlineCount;
+    float scanlineStrength;
+    float curEvenOddTexelOffset;
+    float prevEvenOddTexelOffset;
+    float diffusionStrength;
+    float maskStrength;
+    float maskDepth;
+  };
+
+
+  // Every permutation (see CathodeRetro::RGBToCRTFeature) is its own instantiation of this, with the features that
+  //  aren't in it compiled out, matching the CRT_NO_* defines in the shader.
+  template <uint32_t features>
+  inline void CRTRGBToCRT(const CPUShaderContext &ctx, uint32_t rowBegin, uint32_t rowEnd)
+  {
+    using CathodeRetro::RGBToCRTFeature;
+    constexpr bool k_distortion = (features & uint32_t(RGBToCRTFeature::Distortion)) != 0;
+    constexpr bool k_phosphorPersistence = (features & uint32_t(RGBToCRTFeature::PhosphorPersistence)) != 0;
+    constexpr bool k_diffusion = (features & uint32_t(RGBToCRTFeature::Diffusion)) != 0;
+    constexpr bool k_mask = (features & uint32_t(RGBToCRTFeature::Mask)) != 0;
+    constexpr bool k_scanlines = (features & uint32_t(RGBToCRTFeature::Scanlines)) != 0;
+    constexpr bool k_distortionTexture = (features & uint32_t(RGBToCRTFeature::DistortionTexture)) != 0;
+
+    const auto &consts = ctx.Constants<RGBToCRTConstants>();
+    const CPUTextureView &currentFrameTexture = ctx.inputs[0];
+    const CPUTextureView &previousFrameTexture = ctx.inputs[1];
+    const CPUTextureView &screenMaskTexture = ctx.inputs[2];
+    const CPUTextureView &diffusionTexture = ctx.inputs[3];
+    const CPUTextureView &distortionTexture = ctx.inputs[4];
+    CRTDistortion distortion = PrepareCRTDistortion(consts.distortion);
+
+    auto calculateT = [&](Float2 inTexCoord)
+    {
+      if (!k_distortion)
+      {
+        return (inTexCoord * 2.0f - 1.0f) * consts.viewScale * consts.overscanScale + consts.overscanOffset * 2.0f;
+      }
+
+      return CalculateDistortedCoordinate(consts, distortion, inTexCoord);
+    };
+
+    float texelHeight = 1.0f / float(ctx.outputHeight);
+
+    // The scanline anti-aliasing fade only depends on the output resolution, so it's the same for every pixel.
+    float scanlineStrength = Lerp(
+      consts.scanlineStrength,
+      0.0f,
+      Smoothstep(1.0f, 1.4f, texelHeight * consts.scanlineCount * 2.0f));
+
+    RunPixelShader(ctx, rowBegin, rowEnd, [&](Float2 inTexCoord)
+    {
+      Float4 screenMask = screenMaskTexture.Sample(inTexCoord);
+
+      Float2 t;
+      Float2 ddyT = {};
+      if (k_distortionTexture)
+      {
+        Float4 distortedCoordinates = distortionTexture.Sample(inTexCoord);
+        t = {distortedCoordinates.x, distortedCoordinates.y};
+        ddyT = {distortedCoordinates.z, distortedCoordinates.w};
+      }
+      else
+      {
+        t = calculateT(inTexCoord);
+
+        // The derivative is only needed for the scanlines (and with distortion it's the most expensive part of this).
+        if (k_scanlines)
+        {
+          ddyT = calculateT(inTexCoord + Float2{0.0f, texelHeight}) - t;
+        }
+      }
+
+      Float4 diffusionColor = {};
+      if (k_diffusion)
+      {
+        diffusionColor = diffusionTexture.Sample(t * 0.5f + 0.5f);
+      }
+
+      t.y += consts.curEvenOddTexelOffset / consts.scanlineCount;
+
+      float scanlineSpaceY = 0.0f;
+      float pixelLengthInScanlineSpace = 0.0f;
+      if (k_scanlines)
+      {
+        scanlineSpaceY = t.y * consts.scanlineCount + consts.scanlineCount;
+        pixelLengthInScanlineSpace = Length(ddyT) * consts.scanlineCount;
+      }
+
+      {
+        float scanlineIndex = (t.y * 0.5f + 0.5f) * consts.scanlineCount;
+        float scanlineFrac = Frac(scanlineIndex);
+        scanlineIndex -= scanlineFrac;
+        scanlineFrac -= 0.5f;
+        float ySharpening = 0.1f;
+        scanlineFrac = Sign(scanlineFrac) * Saturate(std::abs(scanlineFrac) - ySharpening) * 0.5f
+          / (0.5f - ySharpening);
+
+        scanlineIndex += scanlineFrac + 0.5f;
+        t.y = scanlineIndex / consts.scanlineCount * 2.0f - 1.0f;
+      }
+
+      Float4 sourceColor;
+      {
+        t = t * 0.5f + 0.5f;
+        sourceColor = currentFrameTexture.Sample(t);
+
+        float scanline = 1.0f;
+        if (k_scanlines)
+        {
+          float scale = std::pow(std::abs(pixelLengthInScanlineSpace), 2.6f) * 7.0f;
+
+          float ya = scanlineSpaceY - scale;
+          float yb = scanlineSpaceY + scale;
+          scanline = (0.5f * (yb - ya) + 1.0f / (2.0f * k_pi) * (std::sin(k_pi * ya) - std::sin(k_pi * yb)))
+            / (2.0f * scale);
+
+          sourceColor *= Lerp(1.0f - scanlineStrength, 1.0f, scanline);
+        }
+
+        if (k_phosphorPersistence)
+        {
+          Float2 prevT = t;
+          float prevScanline = scanline;
+          if (consts.prevEvenOddTexelOffset != consts.curEvenOddTexelOffset)
+          {
+            prevT.y += consts.prevEvenOddTexelOffset / consts.scanlineCount;
+            prevScanline = 1.0f - prevScanline;
+          }
+
+          Float4 prevSourceColor = previousFrameTexture.Sample(prevT);
+          if (k_scanlines)
+          {
+            prevSourceColor *= Lerp(1.0f - scanlineStrength, 1.0f, prevScanline);
+          }
+
+          sourceColor = {
+            std::max(prevSourceColor.x * consts.phosphorPersistence, sourceColor.x),
+            std::max(prevSourceColor.y * consts.phosphorPersistence, sourceColor.y),
+            std::max(prevSourceColor.z * consts.phosphorPersistence, sourceColor.z),
+            0.0f };
+        }
+
+        if (k_scanlines)
+        {
+          sourceColor *= 1.0f / (1.0f - scanlineStrength * 0.5f);
+        }
+      }
+
+      Float4 result = { sourceColor.x, sourceColor.y, sourceColor.z, 1.0f };
+      if (k_mask)
+      {
+        Float4 mask = screenMask * (3.0f - consts.maskDepth) + consts.maskDepth;
+        result = {
+          sourceColor.x * Lerp(1.0f, mask.x, consts.maskStrength),
+          sourceColor.y * Lerp(1.0f, mask.y, consts.maskStrength),
+          sourceColor.z * Lerp(1.0f, mask.z, consts.maskStrength),
+          1.0f };
+      }
+
+      if (k_diffusion)
+      {
+        result = {
+          std::max(diffusionColor.x * consts.diffusionStrength, result.x),
+          std::max(diffusionColor.y * consts.diffusionStrength, result.y),
+          std::max(diffusionColor.z * consts.diffusionStrength, result.z),
+          1.0f };
+      }
+
+      return Lerp(consts.backgroundColor, result, screenMask.w);
+    });
+  }
+
+
+  template <uint32_t... permutations>
+  inline ShaderFunc CRTRGBToCRTPermutation(uint32_t permutation, std::integer_sequence<uint32_t, permutations...>)
+  {
+    static constexpr ShaderFunc k_shaders[] = { &CRTRGBToCRT<permutations>... };
+    return k_shaders[permutation];
+  }
+
+
+  // Get the CPU port for the given shader ID (and permutation, for the shaders that have them).
+  inline ShaderFunc ShaderFromID(CathodeRetro::ShaderID id, uint32_t permutation = CathodeRetro::k_rgbToCRTAllFeatures)
+  {
+    using CathodeRetro::ShaderID;
+    switch (id)
+    {
+      case ShaderID::Util_Copy: return &UtilCopy;
+      case ShaderID::Util_Downsample2X: return &UtilDownsample2X;
+      case ShaderID::Util_TonemapAndDownsample: return &UtilTonemapAndDownsample;
+      case ShaderID::Util_GaussianBlur13: return &UtilGaussianBlur13;
+      case ShaderID::Generator_GeneratePhaseTexture: return &GeneratorGeneratePhaseTexture;
+      case ShaderID::Generator_RGBToSVideoOrComposite: return &GeneratorRGBToSVideoOrComposite;
+      case ShaderID::Generator_IndexedToSVideoOrComposite: return &GeneratorIndexedToSVideoOrComposite;
+      case ShaderID::Generator_GeneratePaletteSignalTable: return &GeneratorGeneratePaletteSignalTable;
+      case ShaderID::Generator_ApplyArtifacts: return &GeneratorApplyArtifacts;
+      case ShaderID::Decoder_CompositeToSVideo: return &DecoderCompositeToSVideo;
+      case ShaderID::Decoder_SVideoToModulatedChroma: return &DecoderSVideoToModulatedChroma;
+      case ShaderID::Decoder_SVideoToRGB: return &DecoderSVideoToRGB;
+      case ShaderID::Decoder_SVideoToDecimatedIQ: return &DecoderSVideoToDecimatedIQ;
+      case ShaderID::Decoder_SVideoAndDecimatedIQToRGB: return &DecoderSVideoAndDecimatedIQToRGB;
+      case ShaderID::Decoder_FilterRGB: return &DecoderFilterRGB;
+      case ShaderID::CRT_GenerateScreenTexture: return &CRTGenerateScreenTexture;
+      case ShaderID::CRT_GenerateDistortionTexture: return &CRTGenerateDistortionTexture;
+      case ShaderID::CRT_GenerateSlotMask: return &CRTGenerateSlotMask;
+      case ShaderID::CRT_GenerateShadowMask: return &CRTGenerateShadowMask;
+      case ShaderID::CRT_GenerateApertureGrille: return &CRTGenerateApertureGrille;
+      case ShaderID::CRT_RGBToCRT:
+        assert(permutation < CathodeRetro::k_rgbToCRTPermutationCount);
+        return CRTRGBToCRTPermutation(
+          permutation,
+          std::make_integer_sequence<uint32_t, CathodeRetro::k_rgbToCRTPermutationCount>());
+    }
+
+    assert(false);
+    return nullptr;
+  }
+
+
+  // Whether row y of a shader's output only ever reads row y of any of its inputs that are the same height as the
+  //  output (which is true of the whole signal generation and decode chain).
+  inline bool IsRowLocal(CathodeRetro::ShaderID id)
+  {
+    using CathodeRetro::ShaderID;
+    switch (id)
+    {
+      case ShaderID::Util_Copy:
+      case ShaderID::Generator_GeneratePhaseTexture:
+      case ShaderID::Generator_RGBToSVideoOrComposite:
+      case ShaderID::Generator_IndexedToSVideoOrComposite:
+      case ShaderID::Generator_ApplyArtifacts:
+      case ShaderID::Decoder_CompositeToSVideo:
+      case ShaderID::Decoder_SVideoToModulatedChroma:
+      case ShaderID::Decoder_SVideoToRGB:
+      case ShaderID::Decoder_SVideoToDecimatedIQ:
+      case ShaderID::Decoder_SVideoAndDecimatedIQToRGB:
+      case ShaderID::Decoder_FilterRGB:
+        return true;
+
+      default:
+        return false;
+    }
+  }
+
+
+  // Work out which rows of one of a pass's inputs it reads in order to render rows [rowBegin, rowEnd) of its output,
+  //  as [*firstRowOut, *endRowOut) in the most detailed mip of the input view. CPUGraphicsDevice uses this to work
+  //  out which tiles of earlier passes a tile of rows has to wait for, so this can be conservative (any shader that
+  //  it knows nothing about reads every row) but must never leave out a row that gets read.
+  inline void InputRowRange(
+    CathodeRetro::ShaderID id,
+    const CPUShaderContext &ctx,
+    uint32_t inputIndex,
+    uint32_t rowBegin,
+    uint32_t rowEnd,
+    uint32_t *firstRowOut,
+    uint32_t *endRowOut)
+  {
+    using CathodeRetro::ShaderID;
+
+    const CPUTextureView &input = ctx.inputs[inputIndex];
+    uint32_t inputHeight = input.Height();
+    *firstRowOut = 0;
+    *endRowOut = inputHeight;
+
+    // A view of multiple mips reads from all of them, and a wrapping sampler can read from the opposite edge.
+    if (input.MipCount() != 1 || input.IsWrap())
+    {
+      return;
+    }
+
+    if (IsRowLocal(id))
+    {
+      if (inputHeight == ctx.outputHeight)
+      {
+        *firstRowOut = rowBegin;
+        *endRowOut = rowEnd;
+      }
+
+      return;
+    }
+
+    // The filtering shaders sample the input at the same relative position as the output texel, plus or minus the
+    //  furthest tap (in input texels) along y.
+    float radius;
+    switch (id)
+    {
+      case ShaderID::Util_Downsample2X:
+        radius = std::abs(ctx.Constants<Float2>().y) * 2.67647052f;
+        break;
+
+      case ShaderID::Util_TonemapAndDownsample:
+        radius = std::abs(ctx.Constants<TonemapAndDownsampleConstants>().downsampleDir.y) * 2.67647052f;
+        break;
+
+      case ShaderID::Util_GaussianBlur13:
+        radius = std::abs(ctx.Constants<Float2>().y) * 5.308886854f;
+        break;
+
+      default:
+        return;
+    }
+
+    // A bilinear sample at (input-texel-space) position p reads rows floor(p) and floor(p) + 1; an extra row on
+    //  either side covers any rounding.
+    float scale = float(inputHeight) / float(ctx.outputHeight);
+    float first = std::floor((float(rowBegin) + 0.5f) * scale - 0.5f - radius) - 1.0f;
+    float last = std::floor((float(rowEnd) - 0.5f) * scale - 0.5f + radius) + 2.0f;
+    *firstRowOut = uint32_t(std::min(std::max(first, 0.0f), float(inputHeight)));
+    *endRowOut = uint32_t(std::min(std::max(last + 1.0f, 0.0f), float(inputHeight)));
+  }
+}
@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "CathodeRetro/GraphicsDevice.h"
+
+#include "CPUShaderHelpers.h"
+
+
+// A texture (and render target) that lives in system memory. Texels are stored tightly packed in their native format
+//  (so an R_Float32 texture is 4 bytes per texel, RGBA_Float16 is 8 bytes per texel and RGBA_Unorm8 is 4 bytes per
+//  texel), with each mip level stored one after the other in the same allocation.
+//
+// A streaming texture (see CPUGraphicsDevice::CreateStreamingTexture) has more than one such allocation: one is the
+//  current contents, and new contents get written into the next one in the ring (which nothing is reading from) and
+//  then swapped in, so nothing is ever copied or reallocated. Alternately, the texture can be pointed directly at
+//  memory that the caller owns.
+class CPUTexture : public CathodeRetro::IRenderTarget
+{
+public:
+  CPUTexture(
+    uint32_t widthIn,
+    uint32_t heightIn,
+    uint32_t mipCountIn, // 0 means "all mip levels"
+    CathodeRetro::TextureFormat formatIn,
+    const void *optionalInitialDataTexels)
+    : width(widthIn)
+    , height(heightIn)
+    , mipCount(mipCountIn)
+    , format(formatIn)
+  {
+    if (mipCount == 0)
+    {
+      mipCount = 1 + uint32_t(std::floor(std::log2(float(std::max(width, height)))));
+    }
+
+    size_t totalSize = 0;
+    mipOffsets.resize(mipCount);
+    for (uint32_t mip = 0; mip < mipCount; mip++)
+    {
+      mipOffsets[mip] = totalSize;
+      totalSize += MipRowPitch(mip) * MipHeight(mip);
+    }
+
+    buffers.resize(1);
+    buffers[0].resize(totalSize);
+
+    if (optionalInitialDataTexels != nullptr)
+    {
+      memcpy(buffers[0].data(), optionalInitialDataTexels, MipRowPitch(0) * height);
+    }
+  }
+
+
+  uint32_t Width() const override
+    { return width; }
+
+  uint32_t Height() const override
+    { return height; }
+
+  uint32_t MipCount() const override
+    { return mipCount; }
+
+  CathodeRetro::TextureFormat Format() const override
+    { return format; }
+
+
+  static uint32_t BytesPerTexel(CathodeRetro::TextureFormat format)
+  {
+    switch (format)
+    {
+    case CathodeRetro::TextureFormat::RGBA_Unorm8: return 4;
+    case CathodeRetro::TextureFormat::R_Float32: return 4;
+    case CathodeRetro::TextureFormat::RG_Float32: return 8;
+    case CathodeRetro::TextureFormat::RGBA_Float32: return 16;
+    case CathodeRetro::TextureFormat::R_Float16: return 2;
+    case CathodeRetro::TextureFormat::RG_Float16: return 4;
+    case CathodeRetro::TextureFormat::RGBA_Float16: return 8;
+    case CathodeRetro::TextureFormat::R_Unorm8: return 1;
+    }
+
+    assert(false);
+    return 0;
+  }
+
+
+  uint32_t MipWidth(uint32_t mip) const
+    { return std::max(1U, width >> mip); }
+
+  uint32_t MipHeight(uint32_t mip) const
+    { return std::max(1U, height >> mip); }
+
+  size_t MipRowPitch(uint32_t mip) const
+    { return size_t(MipWidth(mip)) * BytesPerTexel(format); }
+
+  uint8_t *MipData(uint32_t mip)
+  {
+    // External texels are read-only.
+    assert(externalTexels == nullptr);
+    return buffers[currentBuffer].data() + mipOffsets[mip];
+  }
+
+  const uint8_t *MipData(uint32_t mip) const
+  {
+    if (externalTexels != nullptr)
+    {
+      assert(mip == 0);
+      return externalTexels;
+    }
+
+    return buffers[currentBuffer].data() + mipOffsets[mip];
+  }
+
+  // The total number of bytes of texel storage across all mip levels (of a single buffer, for a streaming texture).
+  size_t ByteCount() const
+    { return buffers[0].size(); }
+
+
+  // Give the texture bufferCount copies of its texels (including the current one) to cycle through when mapping.
+  //  Only single-mip textures can be streamed.
+  void SetBufferCount(uint32_t bufferCount)
+  {
+    assert(mipCount == 1);
+    assert(bufferCount > 0);
+    assert(mappedBuffer < 0);
+    buffers.resize(bufferCount);
+    for (std::vector<uint8_t> &buffer : buffers)
+    {
+      buffer.resize(buffers[0].size());
+    }
+
+    currentBuffer %= bufferCount;
+  }
+
+
+  // Get the next buffer in the ring to write new contents into. The current contents stay as they are (and can still
+  //  be read from) until Unmap is called. A texture with a single buffer just maps its current contents.
+  uint8_t *Map()
+  {
+    assert(mappedBuffer < 0);
+    mappedBuffer = int32_t((currentBuffer + 1) % uint32_t(buffers.size()));
+    return buffers[uint32_t(mappedBuffer)].data();
+  }
+
+
+  // Make the mapped buffer the current contents of the texture.
+  void Unmap()
+  {
+    assert(mappedBuffer >= 0);
+    currentBuffer = uint32_t(mappedBuffer);
+    mappedBuffer = -1;
+    externalTexels = nullptr;
+  }
+
+
+  // Read the texels directly out of the given (tightly-packed) memory rather than out of the texture's own buffers,
+  //  until the next Unmap. The memory needs to stay valid for as long as the texture might be read from.
+  void SetExternalTexels(const void *texels)
+  {
+    assert(mipCount == 1);
+    externalTexels = static_cast<const uint8_t *>(texels);
+  }
+
+
+  // Load a single texel, converted to float. Like a GPU texture fetch, any components that the format does not have
+  //  come back as 0 (or 1 for alpha).
+  Float4 Load(uint32_t mip, uint32_t x, uint32_t y) const
+  {
+    const uint8_t *row = MipData(mip) + MipRowPitch(mip) * y;
+    switch (format)
+    {
+    case CathodeRetro::TextureFormat::RGBA_Unorm8:
+      {
+        const uint8_t *t = row + x * 4;
+        constexpr float k_scale = 1.0f / 255.0f;
+        return {float(t[0]) * k_scale, float(t[1]) * k_scale, float(t[2]) * k_scale, float(t[3]) * k_scale};
+      }
+
+    case CathodeRetro::TextureFormat::R_Float32:
+      {
+        const float *t = reinterpret_cast<const float *>(row) + x;
+        return {t[0], 0.0f, 0.0f, 1.0f};
+      }
+
+    case CathodeRetro::TextureFormat::RG_Float32:
+      {
+        const float *t = reinterpret_cast<const float *>(row) + x * 2;
+        return {t[0], t[1], 0.0f, 1.0f};
+      }
+
+    case CathodeRetro::TextureFormat::RGBA_Float32:
+      {
+        const float *t = reinterpret_cast<const float *>(row) + x * 4;
+        return {t[0], t[1], t[2], t[3]};
+      }
+
+    case CathodeRetro::TextureFormat::R_Float16:
+      {
+        const uint16_t *t = reinterpret_cast<const uint16_t *>(row) + x;
+        return {HalfToFloat(t[0]), 0.0f, 0.0f, 1.0f};
+      }
+
+    case CathodeRetro::TextureFormat::RG_Float16:
+      {
+        const uint16_t *t = reinterpret_cast<const uint16_t *>(row) + x * 2;
+        return {HalfToFloat(t[0]), HalfToFloat(t[1]), 0.0f, 1.0f};
+      }
+
+    case CathodeRetro::TextureFormat::RGBA_Float16:
+      {
+        const uint16_t *t = reinterpret_cast<const uint16_t *>(row) + x * 4;
+        return {HalfToFloat(t[0]), HalfToFloat(t[1]), HalfToFloat(t[2]), HalfToFloat(t[3])};
+      }
+
+    case CathodeRetro::TextureFormat::R_Unorm8:
+      return {float(row[x]) * (1.0f / 255.0f), 0.0f, 0.0f, 1.0f};
+    }
+
+    return {0.0f, 0.0f, 0.0f, 1.0f};
+  }
+
+
+  // Store a single texel, dropping any components that the format does not have (and saturating/rounding for unorm).
+  void Store(uint32_t mip, uint32_t x, uint32_t y, const Float4 &v)
+  {
+    uint8_t *row = MipData(mip) + MipRowPitch(mip) * y;
+    switch (format)
+    {
+    case CathodeRetro::TextureFormat::RGBA_Unorm8:
+      {
+        uint8_t *t = row + x * 4;
+        t[0] = uint8_t(Saturate(v.x) * 255.0f + 0.5f);
+        t[1] = uint8_t(Saturate(v.y) * 255.0f + 0.5f);
+        t[2] = uint8_t(Saturate(v.z) * 255.0f + 0.5f);
+        t[3] = uint8_t(Saturate(v.w) * 255.0f + 0.5f);
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::R_Float32:
+      {
+        float *t = reinterpret_cast<float *>(row) + x;
+        t[0] = v.x;
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::RG_Float32:
+      {
+        float *t = reinterpret_cast<float *>(row) + x * 2;
+        t[0] = v.x;
+        t[1] = v.y;
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::RGBA_Float32:
+      {
+        float *t = reinterpret_cast<float *>(row) + x * 4;
+        t[0] = v.x;
+        t[1] = v.y;
+        t[2] = v.z;
+        t[3] = v.w;
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::R_Float16:
+      {
+        uint16_t *t = reinterpret_cast<uint16_t *>(row) + x;
+        t[0] = FloatToHalf(v.x);
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::RG_Float16:
+      {
+        uint16_t *t = reinterpret_cast<uint16_t *>(row) + x * 2;
+        t[0] = FloatToHalf(v.x);
+        t[1] = FloatToHalf(v.y);
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::RGBA_Float16:
+      {
+        uint16_t *t = reinterpret_cast<uint16_t *>(row) + x * 4;
+        t[0] = FloatToHalf(v.x);
+        t[1] = FloatToHalf(v.y);
+        t[2] = FloatToHalf(v.z);
+        t[3] = FloatToHalf(v.w);
+      }
+      break;
+
+    case CathodeRetro::TextureFormat::R_Unorm8:
+      row[x] = uint8_t(Saturate(v.x) * 255.0f + 0.5f);
+      break;
+    }
+  }
+
+private:
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  CathodeRetro::TextureFormat format;
+  std::vector<size_t> mipOffsets;
+  std::vector<std::vector<uint8_t>> buffers;
+  uint32_t currentBuffer = 0;
+  int32_t mappedBuffer = -1;
+  const uint8_t *externalTexels = nullptr;
+};
+
+
+// This is the CPU equivalent of a bound shader resource view plus its sampler: it does texture filtering (nearest,
+//  bilinear, or trilinear) with clamp or wrap addressing the way that a GPU sampler would.
+class CPUTextureView
+{
+public:
+  CPUTextureView() = default;
+
+  CPUTextureView(const CPUTexture *tex, int32_t mipLevel, CathodeRetro::SamplerType samplerType)
+    : texture(tex)
+    , baseMip((mipLevel < 0) ? 0 : uint32_t(mipLevel))
+    , mipCount((mipLevel < 0) ? tex->MipCount() : 1)
+    , isLinear(
+        samplerType == CathodeRetro::SamplerType::LinearClamp
+        || samplerType == CathodeRetro::SamplerType::LinearWrap)
+    , isWrap(
+        samplerType == CathodeRetro::SamplerType::LinearWrap
+        || samplerType == CathodeRetro::SamplerType::NearestWrap)
+    { }
+
+  const CPUTexture *Texture() const
+    { return texture; }
+
+  // The most detailed mip level that the view can see, and how many it can see starting there.
+  uint32_t BaseMip() const
+    { return baseMip; }
+
+  uint32_t MipCount() const
+    { return mipCount; }
+
+  bool IsWrap() const
+    { return isWrap; }
+
+  // The dimensions of the view (which, if the view is restricted to a specific mip level, is that mip's size).
+  uint32_t Width() const
+    { return texture->MipWidth(baseMip); }
+
+  uint32_t Height() const
+    { return texture->MipHeight(baseMip); }
+
+  Float2 Size() const
+    { return {float(Width()), float(Height())}; }
+
+
+  // Fetch a single unfiltered texel from the most detailed mip level of the view, applying the sampler's addressing
+  //  mode to out-of-range coordinates.
+  Float4 Load(int32_t x, int32_t y) const
+  {
+    return texture->Load(
+      baseMip,
+      uint32_t(Address(x, int32_t(Width()))),
+      uint32_t(Address(y, int32_t(Height()))));
+  }
+
+
+  // Sample the most detailed mip level of the view.
+  Float4 Sample(Float2 uv) const
+    { return SampleMip(baseMip, uv); }
+
+
+  // Calculate the mip level that a GPU would pick for the given texture coordinate derivatives (plus a bias).
+  float CalculateLevel(Float2 ddx, Float2 ddy, float bias = 0.0f) const
+  {
+    if (mipCount == 1)
+    {
+      return 0.0f;
+    }
+
+    Float2 size = Size();
+    float rho = std::max(Length(ddx * size), Length(ddy * size));
+    float level = std::log2(std::fmax(rho, 1e-8f)) + bias;
+    return std::fmin(std::fmax(level, 0.0f), float(mipCount - 1));
+  }
+
+
+  // Sample at a specific (fractional) mip level relative to the view's most detailed level, blending between the two
+  //  nearest levels for linear samplers.
+  Float4 SampleLevel(Float2 uv, float level) const
+  {
+    if (!isLinear)
+    {
+      return SampleMip(baseMip + uint32_t(level + 0.5f), uv);
+    }
+
+    uint32_t levelBase = uint32_t(level);
+    float levelFrac = level - float(levelBase);
+    Float4 a = SampleMip(baseMip + levelBase, uv);
+    if (levelFrac == 0.0f)
+    {
+      return a;
+    }
+
+    return Lerp(a, SampleMip(baseMip + levelBase + 1, uv), levelFrac);
+  }
+
+
+  // Sample using the given texture coordinate derivatives to select the mip level(s), like the GPU would do
+  //  implicitly for a Sample/SampleBias call.
+  Float4 SampleGrad(Float2 uv, Float2 ddx, Float2 ddy, float bias = 0.0f) const
+    { return SampleLevel(uv, CalculateLevel(ddx, ddy, bias)); }
+
+private:
+  int32_t Address(int32_t i, int32_t size) const
+  {
+    if (isWrap)
+    {
+      i %= size;
+      return (i < 0) ? i + size : i;
+    }
+
+    return std::min(std::max(i, 0), size - 1);
+  }
+
+
+  Float4 SampleMip(uint32_t mip, Float2 uv) const
+  {
+    int32_t w = int32_t(texture->MipWidth(mip));
+    int32_t h = int32_t(texture->MipHeight(mip));
+
+    // Keep the texel-space coordinates in a range that safely converts to an integer (this also flushes NaNs, which
+    //  can show up in the far corners of a heavily-distorted screen).
+    constexpr float k_maxCoord = 16777216.0f;
+    float fx = std::fmin(std::fmax(uv.x * float(w), -k_maxCoord), k_maxCoord);
+    float fy = std::fmin(std::fmax(uv.y * float(h), -k_maxCoord), k_maxCoord);
+
+    if (!isLinear)
+    {
+      return texture->Load(
+        mip,
+        uint32_t(Address(int32_t(std::floor(fx)), w)),
+        uint32_t(Address(int32_t(std::floor(fy)), h)));
+    }
+
+    // Like GPU hardware, snap the filter position to 8 bits of sub-texel precision. Other than matching the GPU more
+    //  closely, this means that sampling at a texel center really does only read that texel (rather than picking up
+    //  a tiny fraction of its neighbor due to rounding), which the row-by-row pass fusion in CPUGraphicsDevice relies
+    //  on.
+    fx = std::round((fx - 0.5f) * 256.0f) * (1.0f / 256.0f);
+    fy = std::round((fy - 0.5f) * 256.0f) * (1.0f / 256.0f);
+    float x0f = std::floor(fx);
+    float y0f = std::floor(fy);
+    fx -= x0f;
+    fy -= y0f;
+
+    uint32_t x0 = uint32_t(Address(int32_t(x0f), w));
+    uint32_t x1 = uint32_t(Address(int32_t(x0f) + 1, w));
+    uint32_t y0 = uint32_t(Address(int32_t(y0f), h));
+
+    Float4 top = Lerp(texture->Load(mip, x0, y0), texture->Load(mip, x1, y0), fx);
+    if (fy == 0.0f)
+    {
+      return top;
+    }
+
+    uint32_t y1 = uint32_t(Address(int32_t(y0f) + 1, h));
+    Float4 bottom = Lerp(texture->Load(mip, x0, y1), texture->Load(mip, x1, y1), fx);
+    return Lerp(top, bottom, fy);
+  }
+
+  const CPUTexture *texture = nullptr;
+  uint32_t baseMip = 0;
+  uint32_t mipCount = 1;
+  bool isLinear = false;
+  bool isWrap = false;
+};
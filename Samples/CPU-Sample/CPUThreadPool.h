@@ -0,0 +1,397 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// A set of tasks to run on a CPUThreadPool, some of which have to wait for others to finish first. Tasks are just
+//  indices, in [0, TaskCount()); what they actually do is up to the function handed to CPUThreadPool::Run.
+class CPUTaskGraph
+{
+public:
+  void Clear()
+  {
+    dependencyCounts.clear();
+    edges.clear();
+  }
+
+
+  // Add a task, returning its index.
+  uint32_t AddTask()
+  {
+    dependencyCounts.push_back(0);
+    return uint32_t(dependencyCounts.size() - 1);
+  }
+
+
+  // Make the given task wait for another (earlier) task to finish before it runs.
+  void AddDependency(uint32_t task, uint32_t dependsOn)
+  {
+    assert(dependsOn < task);
+    dependencyCounts[task]++;
+    edges.push_back({dependsOn, task});
+  }
+
+
+  uint32_t TaskCount() const
+    { return uint32_t(dependencyCounts.size()); }
+
+private:
+  struct Edge
+  {
+    uint32_t from;
+    uint32_t to;
+  };
+
+  std::vector<uint32_t> dependencyCounts;
+  std::vector<Edge> edges;
+
+  friend class CPUThreadPool;
+};
+
+
+// A work-stealing thread pool that runs CPUTaskGraphs: every thread (including the calling thread, which also does
+//  work) has its own queue of tasks that are ready to go. When a task finishes, any tasks that were only waiting on it
+//  go onto the front of the same thread's queue so that they run next, while the data the finished task wrote is
+//  still in that core's cache. Threads that run out of work steal from the back of the other threads' queues.
+//
+// There is no barrier anywhere in a graph: a task starts as soon as the specific tasks it depends on are done. A thread
+//  that can't find anything to do spins for a moment (the next task is usually only a moment away) and then sleeps
+//  until another thread has tasks ready for it to steal or the graph is done, so that waiting on a long chain of
+//  dependent tasks doesn't keep every core busy.
+class CPUThreadPool
+{
+public:
+  // A thread count of 0 means "use one thread per hardware thread". The calling thread counts as one of the threads.
+  explicit CPUThreadPool(uint32_t threadCount = 0)
+  {
+    if (threadCount == 0)
+    {
+      threadCount = std::max(1U, std::thread::hardware_concurrency());
+    }
+
+    queues = std::make_unique<TaskQueue[]>(threadCount);
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+      workers.emplace_back([this, i] { WorkerMain(i); });
+    }
+  }
+
+
+  ~CPUThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      isShuttingDown = true;
+    }
+
+    wakeCondition.notify_all();
+    for (auto &worker : workers)
+    {
+      worker.join();
+    }
+  }
+
+
+  CPUThreadPool(const CPUThreadPool &) = delete;
+  void operator=(const CPUThreadPool &) = delete;
+
+
+  uint32_t ThreadCount() const
+    { return uint32_t(workers.size()) + 1; }
+
+
+  // Call func(task) for every task in the graph, each one only after everything it depends on has finished, and
+  //  return once they're all done.
+  void Run(const CPUTaskGraph &graph, const std::function<void(uint32_t)> &func)
+  {
+    uint32_t taskCount = graph.TaskCount();
+    if (taskCount == 0)
+    {
+      return;
+    }
+
+    // Turn the edge list into a list of dependents per task.
+    dependentsBegin.assign(taskCount + 1, 0);
+    for (const CPUTaskGraph::Edge &edge : graph.edges)
+    {
+      dependentsBegin[edge.from + 1]++;
+    }
+
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+      dependentsBegin[i + 1] += dependentsBegin[i];
+    }
+
+    dependents.resize(graph.edges.size());
+    std::vector<uint32_t> fill(dependentsBegin.begin(), dependentsBegin.end() - 1);
+    for (const CPUTaskGraph::Edge &edge : graph.edges)
+    {
+      dependents[fill[edge.from]++] = edge.to;
+    }
+
+    if (remainingDependencyCapacity < taskCount)
+    {
+      remainingDependencies = std::make_unique<std::atomic<uint32_t>[]>(taskCount);
+      remainingDependencyCapacity = taskCount;
+    }
+
+    // Deal the tasks that are ready to go out to the threads in contiguous runs, so that each thread starts out
+    //  working on neighboring tasks (which, for row tiles, means neighboring rows).
+    std::vector<uint32_t> readyTasks;
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+      remainingDependencies[i].store(graph.dependencyCounts[i], std::memory_order_relaxed);
+      if (graph.dependencyCounts[i] == 0)
+      {
+        readyTasks.push_back(i);
+      }
+    }
+
+    uint32_t threadCount = ThreadCount();
+    for (uint32_t t = 0; t < threadCount; t++)
+    {
+      size_t begin = readyTasks.size() * t / threadCount;
+      size_t end = readyTasks.size() * (t + 1) / threadCount;
+      std::lock_guard<std::mutex> lock(queues[t].mutex);
+      queues[t].tasks.assign(readyTasks.begin() + ptrdiff_t(begin), readyTasks.begin() + ptrdiff_t(end));
+    }
+
+    tasksLeft.store(taskCount, std::memory_order_relaxed);
+    taskFunc = &func;
+
+    if (!workers.empty())
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        activeWorkerCount = uint32_t(workers.size());
+        runGeneration++;
+      }
+
+      wakeCondition.notify_all();
+    }
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return activeWorkerCount == 0; });
+    taskFunc = nullptr;
+  }
+
+private:
+  struct TaskQueue
+  {
+    std::mutex mutex;
+    std::deque<uint32_t> tasks;
+  };
+
+
+  bool PopOwnTask(uint32_t threadIndex, uint32_t *taskOut)
+  {
+    TaskQueue &queue = queues[threadIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+      return false;
+    }
+
+    *taskOut = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+  }
+
+
+  bool StealTask(uint32_t threadIndex, uint32_t *taskOut)
+  {
+    uint32_t threadCount = ThreadCount();
+    for (uint32_t i = 1; i < threadCount; i++)
+    {
+      TaskQueue &queue = queues[(threadIndex + i) % threadCount];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty())
+      {
+        *taskOut = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  void RunTasks(uint32_t threadIndex)
+  {
+    uint32_t idleSpinCount = 0;
+    while (tasksLeft.load(std::memory_order_acquire) != 0)
+    {
+      // This has to be read before looking for a task, so that any tasks pushed after we look change it.
+      uint64_t epoch = readyEpoch.load();
+
+      uint32_t task;
+      if (!PopOwnTask(threadIndex, &task) && !StealTask(threadIndex, &task))
+      {
+        // Everything that's left is waiting on tasks that other threads are still running.
+        if (idleSpinCount < k_idleSpinCount)
+        {
+          idleSpinCount++;
+          std::this_thread::yield();
+        }
+        else
+        {
+          WaitForReadyTasks(epoch);
+          idleSpinCount = 0;
+        }
+
+        continue;
+      }
+
+      idleSpinCount = 0;
+      (*taskFunc)(task);
+
+      // Anything that was only waiting on this task can go now. These go on the front of our own queue (in order)
+      //  so that they're the next thing that this thread runs.
+      uint32_t readyCount = 0;
+      uint32_t readyTasks[16];
+      for (uint32_t i = dependentsBegin[task]; i < dependentsBegin[task + 1]; i++)
+      {
+        uint32_t dependent = dependents[i];
+        if (remainingDependencies[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+          if (readyCount == 16)
+          {
+            PushReadyTasks(threadIndex, readyTasks, readyCount);
+            readyCount = 0;
+          }
+
+          readyTasks[readyCount++] = dependent;
+        }
+      }
+
+      PushReadyTasks(threadIndex, readyTasks, readyCount);
+      if (tasksLeft.fetch_sub(1) == 1)
+      {
+        // That was the last task, so every sleeping thread needs to wake up and return.
+        WakeIdleThreads(ThreadCount());
+      }
+    }
+  }
+
+
+  void PushReadyTasks(uint32_t threadIndex, const uint32_t *tasks, uint32_t count)
+  {
+    if (count > 0)
+    {
+      TaskQueue &queue = queues[threadIndex];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.insert(queue.tasks.begin(), tasks, tasks + count);
+    }
+
+    // This thread is going to run the first of these itself, but the rest are there for the taking.
+    if (count > 1)
+    {
+      readyEpoch.fetch_add(1);
+      WakeIdleThreads(count - 1);
+    }
+  }
+
+
+  // Sleep until the ready epoch moves past the given one (meaning there may be tasks to steal) or the graph is done.
+  void WaitForReadyTasks(uint64_t epoch)
+  {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    idleThreadCount.fetch_add(1);
+    idleCondition.wait(lock, [&] { return readyEpoch.load() != epoch || tasksLeft.load() == 0; });
+    idleThreadCount.fetch_sub(1);
+  }
+
+
+  // These (and the idle thread count and ready epoch changes around them) are sequentially consistent: a thread going
+  //  to sleep bumps the idle thread count and then checks the epoch (and tasks left), while a thread with tasks ready
+  //  bumps the epoch (or drops the tasks left) and then checks the idle thread count, so at least one of them always
+  //  sees the other's change and no thread sleeps through the tasks it was waiting for.
+  void WakeIdleThreads(uint32_t count)
+  {
+    if (idleThreadCount.load() == 0)
+    {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(idleMutex);
+    if (count >= ThreadCount() - 1)
+    {
+      idleCondition.notify_all();
+    }
+    else
+    {
+      for (uint32_t i = 0; i < count; i++)
+      {
+        idleCondition.notify_one();
+      }
+    }
+  }
+
+
+  void WorkerMain(uint32_t threadIndex)
+  {
+    uint64_t seenGeneration = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wakeCondition.wait(lock, [&] { return isShuttingDown || runGeneration != seenGeneration; });
+        if (isShuttingDown)
+        {
+          return;
+        }
+
+        seenGeneration = runGeneration;
+      }
+
+      RunTasks(threadIndex);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        activeWorkerCount--;
+      }
+
+      doneCondition.notify_one();
+    }
+  }
+
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<TaskQueue[]> queues;
+
+  // The graph currently being run.
+  const std::function<void(uint32_t)> *taskFunc = nullptr;
+  std::vector<uint32_t> dependentsBegin;
+  std::vector<uint32_t> dependents;
+  std::unique_ptr<std::atomic<uint32_t>[]> remainingDependencies;
+  uint32_t remainingDependencyCapacity = 0;
+  std::atomic<uint32_t> tasksLeft{0};
+
+  // How many times a thread with nothing to do yields before it goes to sleep.
+  static constexpr uint32_t k_idleSpinCount = 64;
+
+  std::mutex idleMutex;
+  std::condition_variable idleCondition;
+  std::atomic<uint32_t> idleThreadCount{0};
+  std::atomic<uint64_t> readyEpoch{0};
+
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  std::condition_variable doneCondition;
+  uint64_t runGeneration = 0;
+  uint32_t activeWorkerCount = 0;
+  bool isShuttingDown = false;
+};
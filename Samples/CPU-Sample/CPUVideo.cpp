@@ -0,0 +1,990 @@
+// A command-line tool for batch processing video through the full Cathode Retro pipeline on the CPU: it reads raw RGBA
+//  or Y4M frames from a file or a pipe, renders each one through Cathode Retro using the presets from
+//  SettingPresets.h, and writes the result out as Y4M or raw RGBA (again to a file or a pipe, so it can sit between,
+//  say, two ffmpeg invocations).
+//
+// Reading (and converting the input to RGBA), rendering, and writing (and converting the output from RGBA) each run on
+//  their own thread, handing frames to each other through bounded queues of recycled frame buffers. That way the
+//  throughput is that of the slowest of the three rather than the sum of them, and memory use doesn't depend on how
+//  long the video is.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CathodeRetro/CathodeRetro.h"
+#include "CathodeRetro/SettingPresets.h"
+
+#include "CPUGraphicsDevice.h"
+
+
+template <typename T, size_t N>
+constexpr uint32_t ArrayLength(const T (&)[N])
+  { return uint32_t(N); }
+
+
+// A fixed-capacity blocking queue. Once it's closed, pushes fail and pops fail as soon as whatever was already in the
+//  queue has been popped.
+template <typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(size_t capacityIn)
+    : capacity(capacityIn)
+    { }
+
+
+  bool Push(T value)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+    if (closed)
+    {
+      return false;
+    }
+
+    items.push_back(std::move(value));
+    notEmpty.notify_one();
+    return true;
+  }
+
+
+  bool Pop(T *valueOut)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+    if (items.empty())
+    {
+      return false;
+    }
+
+    *valueOut = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return true;
+  }
+
+
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+
+private:
+  size_t capacity;
+  std::deque<T> items;
+  std::mutex mutex;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+  bool closed = false;
+};
+
+
+// Closes files when done with them, unless they're stdin/stdout.
+struct FileCloser
+{
+  void operator()(FILE *file) const
+  {
+    if (file != stdin && file != stdout)
+    {
+      fclose(file);
+    }
+  }
+};
+
+using FilePtr = std::unique_ptr<FILE, FileCloser>;
+
+
+static FilePtr OpenFile(const char *path, const char *mode)
+{
+  FilePtr file;
+  if (strcmp(path, "-") == 0)
+  {
+    file.reset((mode[0] == 'r') ? stdin : stdout);
+  }
+  else
+  {
+    file.reset(fopen(path, mode));
+    if (file == nullptr)
+    {
+      throw std::runtime_error(std::string("Could not open ") + path);
+    }
+  }
+
+  // Frames are big, so use a bigger buffer than the default to cut down on the number of reads/writes.
+  setvbuf(file.get(), nullptr, _IOFBF, 1 << 20);
+  return file;
+}
+
+
+static uint8_t ClampToByte(int32_t valueTimes256)
+  { return uint8_t(std::min(std::max(valueTimes256, 0), 255 * 256 + 255) >> 8); }
+
+
+enum class FieldOrder
+{
+  Progressive,      // Every frame is a single full image.
+  TopFieldFirst,    // Every frame is two interlaced fields, with the odd (1-based) scanlines being the earlier one.
+  BottomFieldFirst, // Every frame is two interlaced fields, with the even (1-based) scanlines being the earlier one.
+};
+
+
+struct VideoInfo
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t frameRateNumerator = 60;
+  uint32_t frameRateDenominator = 1;
+  FieldOrder fieldOrder = FieldOrder::Progressive;
+};
+
+
+// Reads video frames (converted to tightly-packed RGBA8 texels) from either a Y4M stream or a stream of raw RGBA8
+//  frames. Y4M input can be 8-bit 4:2:0, 4:2:2, 4:4:4, or monochrome, and is assumed to be BT.601 limited range.
+class VideoReader
+{
+public:
+  // Read raw RGBA frames with the given properties.
+  VideoReader(FILE *fileIn, const VideoInfo &rawInfo)
+    : file(fileIn)
+    , info(rawInfo)
+    , isY4M(false)
+    { }
+
+
+  // Read a Y4M stream, getting the properties from its header.
+  explicit VideoReader(FILE *fileIn)
+    : file(fileIn)
+    , isY4M(true)
+  {
+    std::string header;
+    if (!ReadLine(&header) || header.compare(0, 10, "YUV4MPEG2 ") != 0)
+    {
+      throw std::runtime_error("Input is not a Y4M stream");
+    }
+
+    std::string colorSpace = "420";
+    for (size_t start = 10; start < header.size();)
+    {
+      size_t end = std::min(header.find(' ', start), header.size());
+      std::string param = header.substr(start, end - start);
+      start = end + 1;
+      if (param.empty())
+      {
+        continue;
+      }
+
+      switch (param[0])
+      {
+      case 'W':
+        info.width = uint32_t(atoi(param.c_str() + 1));
+        break;
+
+      case 'H':
+        info.height = uint32_t(atoi(param.c_str() + 1));
+        break;
+
+      case 'F':
+        if (sscanf(param.c_str() + 1, "%u:%u", &info.frameRateNumerator, &info.frameRateDenominator) != 2
+          || info.frameRateNumerator == 0
+          || info.frameRateDenominator == 0)
+        {
+          throw std::runtime_error("Invalid Y4M frame rate: " + param);
+        }
+        break;
+
+      case 'I':
+        // Mixed-mode ('m') streams flag interlacing per frame, which we don't handle, so treat them as progressive.
+        info.fieldOrder = (param == "It") ? FieldOrder::TopFieldFirst
+          : (param == "Ib") ? FieldOrder::BottomFieldFirst
+          : FieldOrder::Progressive;
+        break;
+
+      case 'C':
+        colorSpace = param.substr(1);
+        break;
+      }
+    }
+
+    if (info.width == 0 || info.height == 0)
+    {
+      throw std::runtime_error("Y4M header is missing the frame size");
+    }
+
+    // All of the 4:2:0 variants only differ in where the chroma samples sit, which we don't bother with.
+    if (colorSpace == "420" || colorSpace == "420jpeg" || colorSpace == "420paldv" || colorSpace == "420mpeg2")
+    {
+      chromaShiftX = 1;
+      chromaShiftY = 1;
+    }
+    else if (colorSpace == "422")
+    {
+      chromaShiftX = 1;
+    }
+    else if (colorSpace == "mono")
+    {
+      isMono = true;
+    }
+    else if (colorSpace != "444")
+    {
+      throw std::runtime_error("Unsupported Y4M color space: C" + colorSpace);
+    }
+
+    uint32_t chromaWidth = (info.width + (1 << chromaShiftX) - 1) >> chromaShiftX;
+    uint32_t chromaHeight = (info.height + (1 << chromaShiftY) - 1) >> chromaShiftY;
+    planes.resize(size_t(info.width) * info.height + (isMono ? 0 : size_t(chromaWidth) * chromaHeight * 2));
+  }
+
+
+  const VideoInfo &Info() const
+    { return info; }
+
+
+  // Override the field order (for raw input, or for a Y4M stream whose header has it wrong).
+  void SetFieldOrder(FieldOrder order)
+    { info.fieldOrder = order; }
+
+
+  // Read the next frame into rgbaOut (which must have room for width * height texels). Returns false if there are no
+  //  more frames.
+  bool ReadFrame(uint8_t *rgbaOut)
+  {
+    size_t texelCount = size_t(info.width) * info.height;
+    if (!isY4M)
+    {
+      return ReadBytes(rgbaOut, texelCount * 4);
+    }
+
+    std::string frameHeader;
+    if (!ReadLine(&frameHeader))
+    {
+      return false;
+    }
+
+    if (frameHeader.compare(0, 5, "FRAME") != 0)
+    {
+      throw std::runtime_error("Corrupt Y4M stream (expected a FRAME marker)");
+    }
+
+    if (!ReadBytes(planes.data(), planes.size()))
+    {
+      throw std::runtime_error("Unexpected end of input in the middle of a frame");
+    }
+
+    uint32_t chromaWidth = (info.width + (1 << chromaShiftX) - 1) >> chromaShiftX;
+    uint32_t chromaHeight = (info.height + (1 << chromaShiftY) - 1) >> chromaShiftY;
+    const uint8_t *yPlane = planes.data();
+    const uint8_t *uPlane = yPlane + texelCount;
+    const uint8_t *vPlane = uPlane + size_t(chromaWidth) * chromaHeight;
+    for (uint32_t y = 0; y < info.height; y++)
+    {
+      const uint8_t *yRow = yPlane + size_t(y) * info.width;
+      const uint8_t *uRow = uPlane + size_t(y >> chromaShiftY) * chromaWidth;
+      const uint8_t *vRow = vPlane + size_t(y >> chromaShiftY) * chromaWidth;
+      uint8_t *out = rgbaOut + size_t(y) * info.width * 4;
+      for (uint32_t x = 0; x < info.width; x++, out += 4)
+      {
+        // BT.601 limited range to full range RGB (in fixed point, scaled by 256).
+        int32_t c = 298 * (int32_t(yRow[x]) - 16) + 128;
+        int32_t d = isMono ? 0 : int32_t(uRow[x >> chromaShiftX]) - 128;
+        int32_t e = isMono ? 0 : int32_t(vRow[x >> chromaShiftX]) - 128;
+        out[0] = ClampToByte(c + 409 * e);
+        out[1] = ClampToByte(c - 100 * d - 208 * e);
+        out[2] = ClampToByte(c + 516 * d);
+        out[3] = 0xFF;
+      }
+    }
+
+    return true;
+  }
+
+private:
+  // Read a line (not including the newline). Returns false if the stream ended before anything was read.
+  bool ReadLine(std::string *lineOut)
+  {
+    lineOut->clear();
+    int ch = fgetc(file);
+    if (ch == EOF)
+    {
+      return false;
+    }
+
+    for (; ch != EOF && ch != '\n'; ch = fgetc(file))
+    {
+      lineOut->push_back(char(ch));
+    }
+
+    return true;
+  }
+
+
+  // Read exactly byteCount bytes. Returns false if the stream had already ended, and throws if it ends partway.
+  bool ReadBytes(void *dest, size_t byteCount)
+  {
+    size_t readCount = fread(dest, 1, byteCount, file);
+    if (readCount == byteCount)
+    {
+      return true;
+    }
+
+    if (readCount == 0 && feof(file))
+    {
+      return false;
+    }
+
+    throw std::runtime_error(ferror(file) ? "Error reading input" : "Unexpected end of input in the middle of a frame");
+  }
+
+
+  FILE *file;
+  VideoInfo info;
+  bool isY4M;
+  bool isMono = false;
+  uint32_t chromaShiftX = 0;
+  uint32_t chromaShiftY = 0;
+  std::vector<uint8_t> planes;
+};
+
+
+// Writes RGBA8 frames out either as a (progressive, 4:4:4, BT.601 limited range) Y4M stream or as raw RGBA8.
+class VideoWriter
+{
+public:
+  VideoWriter(FILE *fileIn, bool isY4MIn, const VideoInfo &infoIn)
+    : file(fileIn)
+    , info(infoIn)
+    , isY4M(isY4MIn)
+  {
+    if (isY4M)
+    {
+      fprintf(
+        file,
+        "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n",
+        info.width,
+        info.height,
+        info.frameRateNumerator,
+        info.frameRateDenominator);
+      planes.resize(size_t(info.width) * info.height * 3);
+    }
+  }
+
+
+  void WriteFrame(const uint8_t *rgba)
+  {
+    size_t texelCount = size_t(info.width) * info.height;
+    if (!isY4M)
+    {
+      WriteBytes(rgba, texelCount * 4);
+      return;
+    }
+
+    uint8_t *yPlane = planes.data();
+    uint8_t *uPlane = yPlane + texelCount;
+    uint8_t *vPlane = uPlane + texelCount;
+    for (size_t i = 0; i < texelCount; i++, rgba += 4)
+    {
+      // Full range RGB to BT.601 limited range (in fixed point, scaled by 256, offsets folded in so that nothing goes
+      //  negative).
+      int32_t r = rgba[0];
+      int32_t g = rgba[1];
+      int32_t b = rgba[2];
+      yPlane[i] = uint8_t((66 * r + 129 * g + 25 * b + 128 + (16 << 8)) >> 8);
+      uPlane[i] = uint8_t((-38 * r - 74 * g + 112 * b + 128 + (128 << 8)) >> 8);
+      vPlane[i] = uint8_t((112 * r - 94 * g - 18 * b + 128 + (128 << 8)) >> 8);
+    }
+
+    static const char k_frameHeader[] = "FRAME\n";
+    WriteBytes(k_frameHeader, sizeof(k_frameHeader) - 1);
+    WriteBytes(planes.data(), planes.size());
+  }
+
+
+  void Flush()
+  {
+    if (fflush(file) != 0)
+    {
+      throw std::runtime_error("Error writing output");
+    }
+  }
+
+private:
+  void WriteBytes(const void *src, size_t byteCount)
+  {
+    if (fwrite(src, 1, byteCount, file) != byteCount)
+    {
+      throw std::runtime_error("Error writing output");
+    }
+  }
+
+
+  FILE *file;
+  VideoInfo info;
+  bool isY4M;
+  std::vector<uint8_t> planes;
+};
+
+
+// A single frame (or, for interlaced input, field) of input, ready to render.
+struct InputFrame
+{
+  std::vector<uint8_t> rgbaTexels;
+  CathodeRetro::ScanlineType scanlineType = CathodeRetro::ScanlineType::Progressive;
+};
+
+
+// Everything that the pipeline threads share. The queues only ever hold pointers to frames owned by the pools, and
+//  there are only as many frames in each pool as the queues can hold, so nothing gets allocated once things start.
+struct Pipeline
+{
+  explicit Pipeline(uint32_t poolSize)
+    : freeInputs(poolSize)
+    , readInputs(poolSize)
+    , freeOutputs(poolSize)
+    , renderedOutputs(poolSize)
+    { }
+
+
+  // Record the first error that any thread hits and shut every queue down so that all of the threads finish up.
+  void Fail(std::exception_ptr exception)
+  {
+    {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (error == nullptr)
+      {
+        error = exception;
+      }
+    }
+
+    freeInputs.Close();
+    readInputs.Close();
+    freeOutputs.Close();
+    renderedOutputs.Close();
+  }
+
+
+  BoundedQueue<InputFrame *> freeInputs;
+  BoundedQueue<InputFrame *> readInputs;
+  BoundedQueue<CPUTexture *> freeOutputs;
+  BoundedQueue<CPUTexture *> renderedOutputs;
+
+  std::mutex errorMutex;
+  std::exception_ptr error;
+};
+
+
+// Measures how much of a thread's time is spent doing actual work, as opposed to waiting on the other threads.
+class BusyTimer
+{
+public:
+  void Start()
+    { startTime = std::chrono::steady_clock::now(); }
+
+  void Stop()
+    { busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count(); }
+
+  double BusySeconds() const
+    { return busySeconds; }
+
+private:
+  std::chrono::steady_clock::time_point startTime;
+  double busySeconds = 0.0;
+};
+
+
+// Read frames from the input, splitting interlaced frames into their two fields (in the order that they were
+//  captured).
+static void ReadThread(Pipeline *pipeline, VideoReader *reader, BusyTimer *timer)
+{
+  const VideoInfo &info = reader->Info();
+  size_t rowByteCount = size_t(info.width) * 4;
+  bool isInterlaced = (info.fieldOrder != FieldOrder::Progressive);
+  std::vector<uint8_t> interlacedFrame(isInterlaced ? rowByteCount * info.height : 0);
+
+  for (;;)
+  {
+    InputFrame *frame;
+    if (!pipeline->freeInputs.Pop(&frame))
+    {
+      break;
+    }
+
+    timer->Start();
+    if (!isInterlaced)
+    {
+      bool hasFrame = reader->ReadFrame(frame->rgbaTexels.data());
+      timer->Stop();
+      if (!hasFrame || !pipeline->readInputs.Push(frame))
+      {
+        break;
+      }
+
+      continue;
+    }
+
+    bool hasFrame = reader->ReadFrame(interlacedFrame.data());
+    timer->Stop();
+    if (!hasFrame)
+    {
+      break;
+    }
+
+    // The odd (1-based) scanlines are the even (0-based) rows of the frame.
+    bool oddFirst = (info.fieldOrder == FieldOrder::TopFieldFirst);
+    for (uint32_t field = 0; field < 2; field++)
+    {
+      if (field == 1 && !pipeline->freeInputs.Pop(&frame))
+      {
+        break;
+      }
+
+      timer->Start();
+      bool isOdd = (field == 0) == oddFirst;
+      uint32_t firstRow = isOdd ? 0 : 1;
+      for (uint32_t y = 0; y < info.height / 2; y++)
+      {
+        memcpy(
+          frame->rgbaTexels.data() + y * rowByteCount,
+          interlacedFrame.data() + (y * 2 + firstRow) * rowByteCount,
+          rowByteCount);
+      }
+
+      frame->scanlineType = isOdd ? CathodeRetro::ScanlineType::Odd : CathodeRetro::ScanlineType::Even;
+      timer->Stop();
+      if (!pipeline->readInputs.Push(frame))
+      {
+        break;
+      }
+    }
+  }
+
+  pipeline->readInputs.Close();
+}
+
+
+static void WriteThread(Pipeline *pipeline, VideoWriter *writer, BusyTimer *timer, uint32_t *frameCountOut)
+{
+  CPUTexture *output;
+  while (pipeline->renderedOutputs.Pop(&output))
+  {
+    timer->Start();
+    writer->WriteFrame(output->MipData(0));
+    timer->Stop();
+    (*frameCountOut)++;
+    pipeline->freeOutputs.Push(output);
+  }
+
+  timer->Start();
+  writer->Flush();
+  timer->Stop();
+}
+
+
+// Run a function on its own thread, reporting anything that it throws to the pipeline.
+template <typename Func>
+static std::thread StartPipelineThread(Pipeline *pipeline, Func func)
+{
+  return std::thread(
+    [pipeline, func]
+    {
+      try
+      {
+        func();
+      }
+      catch (...)
+      {
+        pipeline->Fail(std::current_exception());
+      }
+    });
+}
+
+
+static void PrintUsage()
+{
+  fprintf(
+    stderr,
+    "Usage: cathode-retro-cpu-video <input> <output> [options]\n"
+    "  Either path can be - to use stdin/stdout. Input is Y4M (8-bit 4:2:0, 4:2:2, 4:4:4, or mono) unless\n"
+    "  --raw-input is given, output is 4:4:4 Y4M unless --raw-output is given.\n"
+    "\n"
+    "  --raw-input <W>x<H>     Input is raw RGBA8 frames of the given size\n"
+    "  --fps <num>[:<den>]     Frame rate of raw input (default 60)\n"
+    "  --interlace <order>     progressive, tff, or bff: whether each input frame is a pair of interlaced fields\n"
+    "                          (which get rendered as two output frames, alternating between odd and even\n"
+    "                          scanlines) and which of them comes first (default: from the Y4M header, or\n"
+    "                          progressive for raw input)\n"
+    "  --raw-output            Write raw RGBA8 frames instead of Y4M\n"
+    "  --size <W>x<H>          Output size (default 1920x1080)\n"
+    "  --signal <type>         rgb, svideo, or composite (default composite)\n"
+    "  --source <index>        Source preset index (default 1)\n"
+    "  --artifacts <index>     Artifact preset index (default 1)\n"
+    "  --screen <index>        Screen preset index (default 4)\n"
+    "  --threads <count>       Render thread count (default: one per hardware thread)\n"
+    "  --queue-depth <count>   How many frames can wait between each pipeline stage (default 4)\n"
+    "  --tile-rows <count>     Rows per tile of work, or \"auto\" to time a few and pick the fastest (default auto)\n"
+    "  --no-fusion             Finish each pass before starting the next instead of overlapping their tiles\n"
+    "  --half-precision        Store the intermediate signal textures as 16-bit floats\n"
+    "  --static-frames         Skip the signal generation and decoding of frames that match one of the last few\n"
+    "\n"
+    "  For example, to process a video file with ffmpeg on either end:\n"
+    "    ffmpeg -i in.mkv -f yuv4mpegpipe - | cathode-retro-cpu-video - - | ffmpeg -i - out.mkv\n");
+
+  fprintf(stderr, "\nSource presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_sourcePresets); i++)
+  {
+    fprintf(stderr, "  %u: %s\n", i, CathodeRetro::k_sourcePresets[i].name);
+  }
+
+  fprintf(stderr, "\nArtifact presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_artifactPresets); i++)
+  {
+    fprintf(stderr, "  %u: %s\n", i, CathodeRetro::k_artifactPresets[i].name);
+  }
+
+  fprintf(stderr, "\nScreen presets:\n");
+  for (uint32_t i = 0; i < ArrayLength(CathodeRetro::k_screenPresets); i++)
+  {
+    fprintf(stderr, "  %u: %s\n", i, CathodeRetro::k_screenPresets[i].name);
+  }
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    PrintUsage();
+    return 1;
+  }
+
+  const char *inputPath = argv[1];
+  const char *outputPath = argv[2];
+  bool rawInput = false;
+  VideoInfo rawInputInfo;
+  bool overrideFieldOrder = false;
+  FieldOrder fieldOrder = FieldOrder::Progressive;
+  bool rawOutput = false;
+  uint32_t outputWidth = 1920;
+  uint32_t outputHeight = 1080;
+  CathodeRetro::SignalType signalType = CathodeRetro::SignalType::Composite;
+  uint32_t sourcePreset = 1;
+  uint32_t artifactPreset = 1;
+  uint32_t screenPreset = 4;
+  uint32_t threadCount = 0;
+  uint32_t rowsPerTile = CPUGraphicsDevice::k_autoRowsPerTile;
+  uint32_t queueDepth = 4;
+  bool enablePassFusion = true;
+  bool halfPrecision = false;
+  bool useStaticFrameDetection = false;
+
+  for (int i = 3; i < argc; i++)
+  {
+    bool hasValue = (i + 1 < argc);
+    if (strcmp(argv[i], "--raw-input") == 0 && hasValue)
+    {
+      rawInput = true;
+      if (sscanf(argv[++i], "%ux%u", &rawInputInfo.width, &rawInputInfo.height) != 2
+        || rawInputInfo.width == 0
+        || rawInputInfo.height == 0)
+      {
+        fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--fps") == 0 && hasValue)
+    {
+      rawInputInfo.frameRateDenominator = 1;
+      if (sscanf(argv[++i], "%u:%u", &rawInputInfo.frameRateNumerator, &rawInputInfo.frameRateDenominator) < 1
+        || rawInputInfo.frameRateNumerator == 0
+        || rawInputInfo.frameRateDenominator == 0)
+      {
+        fprintf(stderr, "Invalid frame rate: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--interlace") == 0 && hasValue)
+    {
+      i++;
+      overrideFieldOrder = true;
+      if (strcmp(argv[i], "progressive") == 0)
+      {
+        fieldOrder = FieldOrder::Progressive;
+      }
+      else if (strcmp(argv[i], "tff") == 0)
+      {
+        fieldOrder = FieldOrder::TopFieldFirst;
+      }
+      else if (strcmp(argv[i], "bff") == 0)
+      {
+        fieldOrder = FieldOrder::BottomFieldFirst;
+      }
+      else
+      {
+        fprintf(stderr, "Unknown interlace order: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--raw-output") == 0)
+    {
+      rawOutput = true;
+    }
+    else if (strcmp(argv[i], "--size") == 0 && hasValue)
+    {
+      if (sscanf(argv[++i], "%ux%u", &outputWidth, &outputHeight) != 2 || outputWidth == 0 || outputHeight == 0)
+      {
+        fprintf(stderr, "Invalid size: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--signal") == 0 && hasValue)
+    {
+      i++;
+      if (strcmp(argv[i], "rgb") == 0)
+      {
+        signalType = CathodeRetro::SignalType::RGB;
+      }
+      else if (strcmp(argv[i], "svideo") == 0)
+      {
+        signalType = CathodeRetro::SignalType::SVideo;
+      }
+      else if (strcmp(argv[i], "composite") == 0)
+      {
+        signalType = CathodeRetro::SignalType::Composite;
+      }
+      else
+      {
+        fprintf(stderr, "Unknown signal type: %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--source") == 0 && hasValue)
+    {
+      sourcePreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--artifacts") == 0 && hasValue)
+    {
+      artifactPreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--screen") == 0 && hasValue)
+    {
+      screenPreset = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && hasValue)
+    {
+      threadCount = uint32_t(atoi(argv[++i]));
+    }
+    else if (strcmp(argv[i], "--queue-depth") == 0 && hasValue)
+    {
+      queueDepth = uint32_t(std::max(1, atoi(argv[++i])));
+    }
+    else if (strcmp(argv[i], "--tile-rows") == 0 && hasValue)
+    {
+      i++;
+      rowsPerTile = (strcmp(argv[i], "auto") == 0)
+        ? CPUGraphicsDevice::k_autoRowsPerTile
+        : uint32_t(std::max(1, atoi(argv[i])));
+    }
+    else if (strcmp(argv[i], "--no-fusion") == 0)
+    {
+      enablePassFusion = false;
+    }
+    else if (strcmp(argv[i], "--half-precision") == 0)
+    {
+      halfPrecision = true;
+    }
+    else if (strcmp(argv[i], "--static-frames") == 0)
+    {
+      useStaticFrameDetection = true;
+    }
+    else
+    {
+      PrintUsage();
+      return 1;
+    }
+  }
+
+  if (sourcePreset >= ArrayLength(CathodeRetro::k_sourcePresets)
+    || artifactPreset >= ArrayLength(CathodeRetro::k_artifactPresets)
+    || screenPreset >= ArrayLength(CathodeRetro::k_screenPresets))
+  {
+    fprintf(stderr, "Preset index out of range\n");
+    return 1;
+  }
+
+  try
+  {
+    FilePtr inputFile = OpenFile(inputPath, "rb");
+    std::unique_ptr<VideoReader> reader = rawInput
+      ? std::make_unique<VideoReader>(inputFile.get(), rawInputInfo)
+      : std::make_unique<VideoReader>(inputFile.get());
+
+    if (overrideFieldOrder)
+    {
+      reader->SetFieldOrder(fieldOrder);
+    }
+
+    const VideoInfo &inputInfo = reader->Info();
+    bool isInterlaced = (inputInfo.fieldOrder != FieldOrder::Progressive);
+    if (isInterlaced && (inputInfo.height % 2) != 0)
+    {
+      throw std::runtime_error("Interlaced input must have an even height");
+    }
+
+    // Interlaced frames get rendered one field at a time, so there are twice as many output frames as input frames.
+    uint32_t fieldHeight = isInterlaced ? inputInfo.height / 2 : inputInfo.height;
+    VideoInfo outputInfo;
+    outputInfo.width = outputWidth;
+    outputInfo.height = outputHeight;
+    outputInfo.frameRateNumerator = inputInfo.frameRateNumerator * (isInterlaced ? 2 : 1);
+    outputInfo.frameRateDenominator = inputInfo.frameRateDenominator;
+
+    FilePtr outputFile = OpenFile(outputPath, "wb");
+    VideoWriter writer(outputFile.get(), !rawOutput, outputInfo);
+
+    CPUGraphicsDevice device(threadCount, rowsPerTile, enablePassFusion);
+
+    CathodeRetro::CathodeRetro cathodeRetro(
+      &device,
+      signalType,
+      inputInfo.width,
+      fieldHeight,
+      CathodeRetro::k_sourcePresets[sourcePreset].settings);
+    cathodeRetro.SetOutputSize(outputWidth, outputHeight);
+    cathodeRetro.UpdateSettings(
+      CathodeRetro::k_artifactPresets[artifactPreset].settings,
+      CathodeRetro::TVKnobSettings(),
+      CathodeRetro::OverscanSettings(),
+      CathodeRetro::k_screenPresets[screenPreset].settings);
+    cathodeRetro.SetStaticFrameDetection(useStaticFrameDetection);
+    if (halfPrecision)
+    {
+      cathodeRetro.SetSignalPrecision(CathodeRetro::SignalPrecision::Float16);
+    }
+
+    // Each pool has enough frames to fill the queue between two stages, plus one for each of those stages to be
+    //  working on.
+    uint32_t poolSize = queueDepth + 2;
+    Pipeline pipeline(poolSize);
+
+    std::vector<std::unique_ptr<InputFrame>> inputFrames(poolSize);
+    std::vector<std::unique_ptr<CathodeRetro::IRenderTarget>> outputFrames(poolSize);
+    for (uint32_t i = 0; i < poolSize; i++)
+    {
+      inputFrames[i] = std::make_unique<InputFrame>();
+      inputFrames[i]->rgbaTexels.resize(size_t(inputInfo.width) * fieldHeight * 4);
+      pipeline.freeInputs.Push(inputFrames[i].get());
+
+      outputFrames[i] = device.CreateRenderTarget(
+        outputWidth,
+        outputHeight,
+        1,
+        CathodeRetro::TextureFormat::RGBA_Unorm8);
+      pipeline.freeOutputs.Push(static_cast<CPUTexture *>(outputFrames[i].get()));
+    }
+
+    // The input texture reads directly out of whichever input frame is being rendered, so there's no upload copy.
+    auto inputTexture = device.CreateTexture(
+      inputInfo.width,
+      fieldHeight,
+      CathodeRetro::TextureFormat::RGBA_Unorm8,
+      nullptr);
+
+    BusyTimer readTimer;
+    BusyTimer renderTimer;
+    BusyTimer writeTimer;
+    uint32_t writtenFrameCount = 0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::thread readThread = StartPipelineThread(
+      &pipeline,
+      [&pipeline, &reader, &readTimer] { ReadThread(&pipeline, reader.get(), &readTimer); });
+    std::thread writeThread = StartPipelineThread(
+      &pipeline,
+      [&pipeline, &writer, &writeTimer, &writtenFrameCount]
+        { WriteThread(&pipeline, &writer, &writeTimer, &writtenFrameCount); });
+
+    try
+    {
+      InputFrame *frame;
+      CPUTexture *output;
+      while (pipeline.readInputs.Pop(&frame) && pipeline.freeOutputs.Pop(&output))
+      {
+        renderTimer.Start();
+        device.SetExternalTexels(inputTexture.get(), frame->rgbaTexels.data());
+        cathodeRetro.Render(
+          inputTexture.get(),
+          frame->scanlineType,
+          output,
+          frame->rgbaTexels.data(),
+          size_t(inputInfo.width) * 4);
+        renderTimer.Stop();
+
+        pipeline.freeInputs.Push(frame);
+        pipeline.renderedOutputs.Push(output);
+      }
+    }
+    catch (...)
+    {
+      pipeline.Fail(std::current_exception());
+    }
+
+    pipeline.renderedOutputs.Close();
+    readThread.join();
+    writeThread.join();
+
+    if (pipeline.error != nullptr)
+    {
+      std::rethrow_exception(pipeline.error);
+    }
+
+    // Everything that would have gone to stdout is the video, so the report goes to stderr.
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    fprintf(
+      stderr,
+      "Wrote %u frame(s) at %ux%u in %.2f s (%.2f frames/s) using %u render thread(s)\n",
+      writtenFrameCount,
+      outputWidth,
+      outputHeight,
+      seconds,
+      double(writtenFrameCount) / std::max(seconds, 1e-9),
+      device.ThreadCount());
+
+    fprintf(
+      stderr,
+      "Busy time: read %.1f%%, render %.1f%%, write %.1f%%\n",
+      readTimer.BusySeconds() * 100.0 / std::max(seconds, 1e-9),
+      renderTimer.BusySeconds() * 100.0 / std::max(seconds, 1e-9),
+      writeTimer.BusySeconds() * 100.0 / std::max(seconds, 1e-9));
+
+    if (useStaticFrameDetection)
+    {
+      const CathodeRetro::CathodeRetro::StaticFrameStats &stats = cathodeRetro.StaticFrameDetectionStats();
+      fprintf(
+        stderr,
+        "Static frames: %llu of %llu frame(s) reused an earlier decode, %llu changed scanline(s)\n",
+        (unsigned long long)stats.reusedFrameCount,
+        (unsigned long long)stats.checkedFrameCount,
+        (unsigned long long)stats.changedScanlineCount);
+    }
+  }
+  catch (const std::exception &e)
+  {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,364 @@
+// Vectorized versions of the RGB -> YIQ and YIQ -> RGB conversions (along with the gamma adjustment that goes with
+//  each) that Generator_RGBToSVideoOrComposite and Decoder_SVideoToRGB do for every texel. These work on whole rows
+//  of texels at a time in structure-of-arrays layout (one array per channel), so that every instruction converts 4,
+//  8, or 16 texels at once depending on the instruction set.
+//
+// The kernels are written once using GCC/Clang vector extensions and then compiled for each instruction set that the
+//  compiler can target (SSE4.1, AVX2, and AVX-512 on x86, NEON on 64-bit ARM), and the best one that the CPU running
+//  the app supports is picked at runtime. Anything else (including MSVC builds) gets the scalar versions, which are
+//  the exact shader math.
+//
+// The vector versions replace the shaders' pow calls with a polynomial exp2/log2 approximation, which is within
+//  k_maxVectorError of the scalar versions (far below what any output format can represent). ValidateKernels checks
+//  that against the scalar math, including I and Q well past a length of 1 (where the saturation knob often puts
+//  them).
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "CPUShaderHelpers.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define CPU_YIQ_KERNELS_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+  #define CPU_YIQ_KERNELS_NEON 1
+#endif
+
+
+namespace CPUYIQKernels
+{
+  enum class InstructionSet
+  {
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512,
+    NEON,
+  };
+
+  constexpr uint32_t k_instructionSetCount = uint32_t(InstructionSet::NEON) + 1;
+
+  // The largest difference between the output of a vector kernel and the scalar version, for inputs in [0..1].
+  constexpr float k_maxVectorError = 2e-6f;
+
+  // The gamma adjustments that the generator and decoder apply to their YIQ values.
+  constexpr float k_encodeGamma = 2.2f / 2.0f;
+  constexpr float k_decodeGamma = 2.0f / 2.2f;
+
+
+  inline const char *InstructionSetName(InstructionSet set)
+  {
+    switch (set)
+    {
+      case InstructionSet::Scalar: return "scalar";
+      case InstructionSet::SSE41: return "sse4.1";
+      case InstructionSet::AVX2: return "avx2";
+      case InstructionSet::AVX512: return "avx512";
+      case InstructionSet::NEON: return "neon";
+    }
+
+    return "unknown";
+  }
+
+
+  // The scalar versions of the conversions, which are exactly what the shaders do for a single texel.
+  namespace Scalar
+  {
+    inline void RGBToYIQ(float r, float g, float b, float *YOut, float *IOut, float *QOut)
+    {
+      float Y = r * 0.3000f + g *  0.5900f + b *  0.1100f;
+      float I = r * 0.5990f + g * -0.2773f + b * -0.3217f;
+      float Q = r * 0.2130f + g * -0.5251f + b *  0.3121f;
+
+      Y = std::pow(Saturate(Y), k_encodeGamma);
+      float iqSat = Saturate(std::sqrt(I * I + Q * Q));
+      float iqScale = std::pow(iqSat, k_encodeGamma) / std::max(0.00001f, iqSat);
+
+      *YOut = Y;
+      *IOut = I * iqScale;
+      *QOut = Q * iqScale;
+    }
+
+
+    inline void YIQToRGB(float y, float i, float q, float *rOut, float *gOut, float *bOut)
+    {
+      y = std::pow(Saturate(y), k_decodeGamma);
+      float iqSat = Saturate(std::sqrt(i * i + q * q));
+      float iqScale = std::pow(iqSat, k_decodeGamma) / std::max(0.00001f, iqSat);
+      i *= iqScale;
+      q *= iqScale;
+
+      *rOut = y + i *  0.946882f + q *  0.623557f;
+      *gOut = y + i * -0.274788f + q * -0.635691f;
+      *bOut = y + i * -1.108545f + q *  1.7090047f;
+    }
+
+
+    inline void RGBToYIQRow(
+      const float *r, const float *g, const float *b,
+      float *Y, float *I, float *Q,
+      uint32_t count)
+    {
+      for (uint32_t x = 0; x < count; x++)
+      {
+        RGBToYIQ(r[x], g[x], b[x], &Y[x], &I[x], &Q[x]);
+      }
+    }
+
+
+    inline void YIQToRGBRow(
+      const float *y, const float *i, const float *q,
+      float *r, float *g, float *b,
+      uint32_t count)
+    {
+      for (uint32_t x = 0; x < count; x++)
+      {
+        YIQToRGB(y[x], i[x], q[x], &r[x], &g[x], &b[x]);
+      }
+    }
+  }
+
+
+#if defined(CPU_YIQ_KERNELS_X86)
+  // The vector kernels are compiled once per instruction set by including CPUYIQVectorKernels.h with that instruction
+  //  set enabled for every function in it (so that even the helpers that pass vectors around are compiled for it).
+  #if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("sse4.1"))), apply_to = function)
+  #else
+    #pragma GCC push_options
+    #pragma GCC target("sse4.1")
+  #endif
+  namespace SSE41
+  {
+    typedef float VF __attribute__((vector_size(16)));
+    typedef int32_t VI __attribute__((vector_size(16)));
+    #include "CPUYIQVectorKernels.h"
+  }
+  #if defined(__clang__)
+    #pragma clang attribute pop
+    #pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+  #else
+    #pragma GCC pop_options
+    #pragma GCC push_options
+    #pragma GCC target("avx2,fma")
+  #endif
+  namespace AVX2
+  {
+    typedef float VF __attribute__((vector_size(32)));
+    typedef int32_t VI __attribute__((vector_size(32)));
+    #include "CPUYIQVectorKernels.h"
+  }
+  #if defined(__clang__)
+    #pragma clang attribute pop
+    #pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+  #else
+    #pragma GCC pop_options
+    #pragma GCC push_options
+    #pragma GCC target("avx512f")
+  #endif
+  namespace AVX512
+  {
+    typedef float VF __attribute__((vector_size(64)));
+    typedef int32_t VI __attribute__((vector_size(64)));
+    #include "CPUYIQVectorKernels.h"
+  }
+  #if defined(__clang__)
+    #pragma clang attribute pop
+  #else
+    #pragma GCC pop_options
+  #endif
+#elif defined(CPU_YIQ_KERNELS_NEON)
+  // NEON is always there on 64-bit ARM, so its kernels don't need anything special to compile.
+  namespace NEON
+  {
+    typedef float VF __attribute__((vector_size(16)));
+    typedef int32_t VI __attribute__((vector_size(16)));
+    #include "CPUYIQVectorKernels.h"
+  }
+#endif
+
+
+  using RowFunc = void (*)(const float *, const float *, const float *, float *, float *, float *, uint32_t);
+
+  struct KernelTable
+  {
+    InstructionSet set;
+    RowFunc rgbToYIQRow;
+    RowFunc yiqToRGBRow;
+  };
+
+
+  // Get the kernels for the given instruction set, or null if this build or the CPU doesn't support it.
+  inline const KernelTable *Kernels(InstructionSet set)
+  {
+    static const KernelTable k_scalar = {InstructionSet::Scalar, Scalar::RGBToYIQRow, Scalar::YIQToRGBRow};
+
+    switch (set)
+    {
+    case InstructionSet::Scalar:
+      return &k_scalar;
+
+#if defined(CPU_YIQ_KERNELS_X86)
+    case InstructionSet::SSE41:
+      {
+        static const KernelTable k_sse41 = {set, SSE41::RGBToYIQRow, SSE41::YIQToRGBRow};
+        return __builtin_cpu_supports("sse4.1") ? &k_sse41 : nullptr;
+      }
+
+    case InstructionSet::AVX2:
+      {
+        static const KernelTable k_avx2 = {set, AVX2::RGBToYIQRow, AVX2::YIQToRGBRow};
+        return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? &k_avx2 : nullptr;
+      }
+
+    case InstructionSet::AVX512:
+      {
+        static const KernelTable k_avx512 = {set, AVX512::RGBToYIQRow, AVX512::YIQToRGBRow};
+        return __builtin_cpu_supports("avx512f") ? &k_avx512 : nullptr;
+      }
+#elif defined(CPU_YIQ_KERNELS_NEON)
+    case InstructionSet::NEON:
+      {
+        static const KernelTable k_neon = {set, NEON::RGBToYIQRow, NEON::YIQToRGBRow};
+        return &k_neon;
+      }
+#endif
+
+    default:
+      return nullptr;
+    }
+  }
+
+
+  inline bool IsSupported(InstructionSet set)
+    { return Kernels(set) != nullptr; }
+
+
+  // The widest instruction set that both this build and the CPU support.
+  inline InstructionSet BestSupportedInstructionSet()
+  {
+    static const InstructionSet k_preferenceOrder[] =
+      { InstructionSet::AVX512, InstructionSet::AVX2, InstructionSet::SSE41, InstructionSet::NEON };
+    for (InstructionSet set : k_preferenceOrder)
+    {
+      if (IsSupported(set))
+      {
+        return set;
+      }
+    }
+
+    return InstructionSet::Scalar;
+  }
+
+
+  inline std::atomic<const KernelTable *> &ActiveKernels()
+  {
+    static std::atomic<const KernelTable *> active(Kernels(BestSupportedInstructionSet()));
+    return active;
+  }
+
+
+  // Choose which kernels the row functions use (by default, the best supported ones). Returns false (and changes
+  //  nothing) if the instruction set isn't supported.
+  inline bool SetInstructionSet(InstructionSet set)
+  {
+    const KernelTable *kernels = Kernels(set);
+    if (kernels == nullptr)
+    {
+      return false;
+    }
+
+    ActiveKernels().store(kernels, std::memory_order_relaxed);
+    return true;
+  }
+
+
+  inline InstructionSet ActiveInstructionSet()
+    { return ActiveKernels().load(std::memory_order_relaxed)->set; }
+
+
+  // Convert a row of RGB texels (in separate channel arrays) to gamma-adjusted YIQ, as the generator does.
+  inline void RGBToYIQRow(
+    const float *r, const float *g, const float *b,
+    float *Y, float *I, float *Q,
+    uint32_t count)
+    { ActiveKernels().load(std::memory_order_relaxed)->rgbToYIQRow(r, g, b, Y, I, Q, count); }
+
+
+  // Convert a row of YIQ texels (in separate channel arrays) back to RGB, undoing the gamma adjustment, as the
+  //  decoder does.
+  inline void YIQToRGBRow(
+    const float *y, const float *i, const float *q,
+    float *r, float *g, float *b,
+    uint32_t count)
+    { ActiveKernels().load(std::memory_order_relaxed)->yiqToRGBRow(y, i, q, r, g, b, count); }
+
+
+  // Run both of the given instruction set's kernels over a sweep of inputs (covering [0..1] RGB and the matching YIQ
+  //  range) and return the largest difference from the scalar math, or a negative value if it isn't supported.
+  inline float ValidateKernels(InstructionSet set)
+  {
+    const KernelTable *kernels = Kernels(set);
+    if (kernels == nullptr)
+    {
+      return -1.0f;
+    }
+
+    constexpr uint32_t k_steps = 41;
+    constexpr uint32_t k_count = k_steps * k_steps * k_steps;
+    std::vector<float> in[3];
+    std::vector<float> expected[3];
+    std::vector<float> actual[3];
+    for (uint32_t c = 0; c < 3; c++)
+    {
+      in[c].resize(k_count);
+      expected[c].resize(k_count);
+      actual[c].resize(k_count);
+    }
+
+    float maxError = 0.0f;
+    for (uint32_t pass = 0; pass < 2; pass++)
+    {
+      // The first pass is RGB in [0..1], the second is YIQ over well past the range that RGB maps to, since the
+      //  saturation knob scales I and Q up before they're converted back (so lengths over 1 are common).
+      static const float k_minimums[2][3] = {{0.0f, 0.0f, 0.0f}, {-0.1f, -1.5f, -1.5f}};
+      static const float k_maximums[2][3] = {{1.0f, 1.0f, 1.0f}, {1.1f, 1.5f, 1.5f}};
+      for (uint32_t index = 0; index < k_count; index++)
+      {
+        uint32_t steps[3] = {index % k_steps, (index / k_steps) % k_steps, index / (k_steps * k_steps)};
+        for (uint32_t c = 0; c < 3; c++)
+        {
+          float t = float(steps[c]) / float(k_steps - 1);
+          in[c][index] = k_minimums[pass][c] + (k_maximums[pass][c] - k_minimums[pass][c]) * t;
+        }
+      }
+
+      RowFunc scalarFunc = (pass == 0) ? Scalar::RGBToYIQRow : Scalar::YIQToRGBRow;
+      RowFunc vectorFunc = (pass == 0) ? kernels->rgbToYIQRow : kernels->yiqToRGBRow;
+      scalarFunc(
+        in[0].data(), in[1].data(), in[2].data(),
+        expected[0].data(), expected[1].data(), expected[2].data(),
+        k_count);
+      vectorFunc(
+        in[0].data(), in[1].data(), in[2].data(),
+        actual[0].data(), actual[1].data(), actual[2].data(),
+        k_count);
+
+      for (uint32_t c = 0; c < 3; c++)
+      {
+        for (uint32_t index = 0; index < k_count; index++)
+        {
+          maxError = std::max(maxError, std::abs(actual[c][index] - expected[c][index]));
+        }
+      }
+    }
+
+    return maxError;
+  }
+}
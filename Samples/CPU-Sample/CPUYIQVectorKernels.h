@@ -0,0 +1,173 @@
+// The vector versions of the YIQ conversions (see CPUYIQKernels.h). This file has no include guard: CPUYIQKernels.h
+//  includes it once per instruction set, inside a namespace that defines VF and VI (the float and int32 vector types
+//  of the width to use) and with that instruction set enabled for every function in it.
+
+
+// Select a where mask is set and b everywhere else.
+inline VF Select(VI mask, VF a, VF b)
+  { return (VF)(((VI)a & mask) | ((VI)b & ~mask)); }
+
+// Like Saturate, these map NaN to the constant.
+inline VF Max(VF v, float s)
+  { return Select(v > s, v, v * 0.0f + s); }
+
+inline VF Min(VF v, float s)
+  { return Select(v < s, v, v * 0.0f + s); }
+
+
+// log2 of a (positive, normal) value, using the Cephes logf polynomial on the mantissa.
+inline VF Log2(VF x)
+{
+  VI bits = (VI)x;
+  VI e = ((bits >> 23) & 0xff) - 127;
+  VF m = (VF)((bits & 0x007fffff) | 0x3f800000);
+
+  // Move the mantissa into [sqrt(0.5), sqrt(2)) so that the polynomial is centered on 1.
+  VI isLarge = (m > 1.41421356f);
+  m = Select(isLarge, m * 0.5f, m);
+  e -= isLarge;
+
+  VF f = m - 1.0f;
+  VF f2 = f * f;
+  VF p = f * 7.0376836292e-2f - 1.1514610310e-1f;
+  p = p * f + 1.1676998740e-1f;
+  p = p * f - 1.2420140846e-1f;
+  p = p * f + 1.4249322787e-1f;
+  p = p * f - 1.6668057665e-1f;
+  p = p * f + 2.0000714765e-1f;
+  p = p * f - 2.4999993993e-1f;
+  p = p * f + 3.3333331174e-1f;
+  VF ln = f + (p * f * f2 - 0.5f * f2);
+
+  return __builtin_convertvector(e, VF) + ln * 1.44269504f;
+}
+
+
+// 2^v, using the Cephes exp2f polynomial on the fractional part. v is clamped to [-126, 16], which covers every value
+//  that the conversions need.
+inline VF Exp2(VF v)
+{
+  v = Max(Min(v, 16.0f), -126.0f);
+
+  // n is round(v) + 127 (v + 127.5 is always positive, so truncating it is the same as flooring it).
+  VI n = __builtin_convertvector(v + 127.5f, VI);
+  VF f = v - (__builtin_convertvector(n, VF) - 127.0f);
+
+  VF p = f * 1.535336188319500e-4f + 1.339887440266574e-3f;
+  p = p * f + 9.618437357674640e-3f;
+  p = p * f + 5.550332471162809e-2f;
+  p = p * f + 2.402264791363012e-1f;
+  p = p * f + 6.931472028550421e-1f;
+  p = p * f + 1.0f;
+
+  return p * (VF)(n << 23);
+}
+
+
+// pow(saturate(v), gamma)
+inline VF SaturatePow(VF v, float gamma)
+{
+  v = Min(Max(v, 0.0f), 1.0f);
+  VF result = Exp2(Log2(Max(v, FLT_MIN)) * gamma);
+  return Select(v > 0.0f, result, v * 0.0f);
+}
+
+
+// pow(saturate(length(iq)), gamma) / max(0.00001, saturate(length(iq))), worked out as a single exp2 of the log of the
+//  squared length (so there's no sqrt or divide). Since the length is saturated before the divide as well, anything
+//  longer than 1 has a scale of exactly 1.
+inline VF IQScale(VF i, VF q, float gamma)
+{
+  VF lengthSq = i * i + q * q;
+  VF logLength = Log2(Max(lengthSq, FLT_MIN)) * 0.5f;
+  VF exponent = Select(
+    lengthSq >= 0.00001f * 0.00001f,
+    Min(logLength, 0.0f) * (gamma - 1.0f),
+    logLength * gamma + 16.6096404744f); // log2(1 / 0.00001)
+  return Exp2(exponent);
+}
+
+
+inline VF Load(const float *p)
+{
+  VF v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+
+inline void Store(float *p, VF v)
+  { memcpy(p, &v, sizeof(v)); }
+
+
+// Each block converts a single vector's worth of texels.
+inline void RGBToYIQBlock(const float *rIn, const float *gIn, const float *bIn, float *YOut, float *IOut, float *QOut)
+{
+  VF r = Load(rIn);
+  VF g = Load(gIn);
+  VF b = Load(bIn);
+
+  VF Y = r * 0.3000f + g *  0.5900f + b *  0.1100f;
+  VF I = r * 0.5990f + g * -0.2773f + b * -0.3217f;
+  VF Q = r * 0.2130f + g * -0.5251f + b *  0.3121f;
+
+  VF iqScale = IQScale(I, Q, k_encodeGamma);
+  Store(YOut, SaturatePow(Y, k_encodeGamma));
+  Store(IOut, I * iqScale);
+  Store(QOut, Q * iqScale);
+}
+
+
+inline void YIQToRGBBlock(const float *yIn, const float *iIn, const float *qIn, float *rOut, float *gOut, float *bOut)
+{
+  VF y = SaturatePow(Load(yIn), k_decodeGamma);
+  VF i = Load(iIn);
+  VF q = Load(qIn);
+
+  VF iqScale = IQScale(i, q, k_decodeGamma);
+  i *= iqScale;
+  q *= iqScale;
+
+  Store(rOut, y + i *  0.946882f + q *  0.623557f);
+  Store(gOut, y + i * -0.274788f + q * -0.635691f);
+  Store(bOut, y + i * -1.108545f + q *  1.7090047f);
+}
+
+
+// Run a block function over a whole row, with the leftover texels at the end going through a padded copy.
+template <typename BlockFunc>
+inline void RunRow(
+  const float *in0, const float *in1, const float *in2,
+  float *out0, float *out1, float *out2,
+  uint32_t count,
+  BlockFunc block)
+{
+  constexpr uint32_t k_width = sizeof(VF) / sizeof(float);
+
+  uint32_t x = 0;
+  for (; x + k_width <= count; x += k_width)
+  {
+    block(in0 + x, in1 + x, in2 + x, out0 + x, out1 + x, out2 + x);
+  }
+
+  if (x < count)
+  {
+    float scratch[6][k_width] = {};
+    uint32_t remaining = count - x;
+    memcpy(scratch[0], in0 + x, remaining * sizeof(float));
+    memcpy(scratch[1], in1 + x, remaining * sizeof(float));
+    memcpy(scratch[2], in2 + x, remaining * sizeof(float));
+    block(scratch[0], scratch[1], scratch[2], scratch[3], scratch[4], scratch[5]);
+    memcpy(out0 + x, scratch[3], remaining * sizeof(float));
+    memcpy(out1 + x, scratch[4], remaining * sizeof(float));
+    memcpy(out2 + x, scratch[5], remaining * sizeof(float));
+  }
+}
+
+
+inline void RGBToYIQRow(const float *r, const float *g, const float *b, float *Y, float *I, float *Q, uint32_t count)
+  { RunRow(r, g, b, Y, I, Q, count, RGBToYIQBlock); }
+
+
+inline void YIQToRGBRow(const float *y, const float *i, const float *q, float *r, float *g, float *b, uint32_t count)
+  { RunRow(y, i, q, r, g, b, count, YIQToRGBBlock); }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <assert.h>
 #include <cmath>
 #include <exception>
@@ -55,6 +56,11 @@ private:
   uint32_t height;
   uint32_t mipCount;
   CathodeRetro::TextureFormat format;
+  uint32_t texelByteCount;
+
+  // For streaming textures, the ring of staging textures that updates get written into (and the one to use next).
+  std::vector<ComPtr<ID3D11Texture2D>> stagingTextures;
+  uint32_t nextStagingIndex = 0;
 
   friend class D3D11GraphicsDevice;
 };
@@ -220,6 +226,93 @@ public:
   }
 
 
+  // Create a texture whose contents get replaced regularly (for instance, with each frame of a video). New contents
+  //  are written into the next one of a ring of stagingBufferCount staging textures and then copied into the texture
+  //  by the GPU, so writing a new frame doesn't have to wait for the GPU to be done with the previous ones (as long as
+  //  there are more staging textures than frames in flight) and nothing gets created after this.
+  //
+  // There's no way in D3D11 to have a texture read straight out of caller-owned memory, so UpdateTexture (which does a
+  //  single copy into the staging texture) is as close to zero-copy as this gets. Writing directly into the mapped
+  //  staging texture (via MapTexture) avoids the copy entirely, if the texel data can be generated in place.
+  std::unique_ptr<CathodeRetro::ITexture> CreateStreamingTexture(
+    uint32_t width,
+    uint32_t height,
+    CathodeRetro::TextureFormat format,
+    uint32_t stagingBufferCount = 3)
+  {
+    assert(stagingBufferCount > 0);
+    auto texture = CreateTexture(width, height, 1, format, false, nullptr);
+    auto d3dTexture = static_cast<D3DTexture *>(texture.get());
+
+    D3D11_TEXTURE2D_DESC desc;
+    d3dTexture->texture->GetDesc(&desc);
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    d3dTexture->stagingTextures.resize(stagingBufferCount);
+    for (ComPtr<ID3D11Texture2D> &staging : d3dTexture->stagingTextures)
+    {
+      CHECK_HRESULT(device->CreateTexture2D(&desc, nullptr, staging.AddressForReplace()), "create staging texture");
+    }
+
+    return texture;
+  }
+
+
+  // Get a pointer to write new contents for a streaming texture into (rows are *rowPitchOut bytes apart, which may be
+  //  more than the width of the texture). The new contents get copied into the texture when UnmapTexture is called,
+  //  which cannot be done during rendering.
+  void *MapTexture(CathodeRetro::ITexture *texture, size_t *rowPitchOut)
+  {
+    auto d3dTexture = static_cast<D3DTexture *>(texture);
+    assert(!d3dTexture->stagingTextures.empty());
+
+    D3D11_MAPPED_SUBRESOURCE map;
+    CHECK_HRESULT(
+      context->Map(d3dTexture->stagingTextures[d3dTexture->nextStagingIndex], 0, D3D11_MAP_WRITE, 0, &map),
+      "map staging texture");
+    *rowPitchOut = map.RowPitch;
+    return map.pData;
+  }
+
+
+  void UnmapTexture(CathodeRetro::ITexture *texture)
+  {
+    assert(!isRendering);
+    auto d3dTexture = static_cast<D3DTexture *>(texture);
+    ID3D11Texture2D *staging = d3dTexture->stagingTextures[d3dTexture->nextStagingIndex];
+    context->Unmap(staging, 0);
+    context->CopyResource(d3dTexture->texture, staging);
+    d3dTexture->nextStagingIndex = (d3dTexture->nextStagingIndex + 1) % uint32_t(d3dTexture->stagingTextures.size());
+  }
+
+
+  // Replace the contents of a texture with the given (tightly packed) texels. Streaming textures go through their
+  //  staging ring, anything else gets a plain UpdateSubresource.
+  void UpdateTexture(CathodeRetro::ITexture *texture, const void *texels)
+  {
+    assert(!isRendering);
+    auto d3dTexture = static_cast<D3DTexture *>(texture);
+    size_t srcRowPitch = size_t(d3dTexture->width) * d3dTexture->texelByteCount;
+    if (d3dTexture->stagingTextures.empty())
+    {
+      context->UpdateSubresource(d3dTexture->texture, 0, nullptr, texels, UINT(srcRowPitch), 0);
+      return;
+    }
+
+    size_t destRowPitch;
+    auto dest = static_cast<uint8_t *>(MapTexture(texture, &destRowPitch));
+    auto src = static_cast<const uint8_t *>(texels);
+    for (uint32_t y = 0; y < d3dTexture->height; y++)
+    {
+      memcpy(dest + y * destRowPitch, src + y * srcRowPitch, srcRowPitch);
+    }
+
+    UnmapTexture(texture);
+  }
+
+
   // CathodeRetro::IGraphicsDevice Implementations ////////////////////////////////////////////////////////////////////
 
 
@@ -237,12 +330,23 @@ public:
       case CathodeRetro::ShaderID::Generator_RGBToSVideoOrComposite:
         resourceID = IDR_RGB_TO_SVIDEO_OR_COMPOSITE;
         break;
+      case CathodeRetro::ShaderID::Generator_IndexedToSVideoOrComposite:
+        resourceID = IDR_INDEXED_TO_SVIDEO_OR_COMPOSITE;
+        break;
+      case CathodeRetro::ShaderID::Generator_GeneratePaletteSignalTable:
+        resourceID = IDR_GENERATE_PALETTE_SIGNAL_TABLE;
+        break;
       case CathodeRetro::ShaderID::Generator_ApplyArtifacts: resourceID = IDR_APPLY_ARTIFACTS; break;
       case CathodeRetro::ShaderID::Decoder_CompositeToSVideo: resourceID = IDR_COMPOSITE_TO_SVIDEO; break;
       case CathodeRetro::ShaderID::Decoder_SVideoToModulatedChroma: resourceID = IDR_SVIDEO_TO_MODULATED_CHROMA; break;
       case CathodeRetro::ShaderID::Decoder_SVideoToRGB: resourceID = IDR_SVIDEO_TO_RGB; break;
+      case CathodeRetro::ShaderID::Decoder_SVideoToDecimatedIQ: resourceID = IDR_SVIDEO_TO_DECIMATED_IQ; break;
+      case CathodeRetro::ShaderID::Decoder_SVideoAndDecimatedIQToRGB:
+        resourceID = IDR_SVIDEO_AND_DECIMATED_IQ_TO_RGB;
+        break;
       case CathodeRetro::ShaderID::Decoder_FilterRGB: resourceID = IDR_FILTER_RGB; break;
       case CathodeRetro::ShaderID::CRT_GenerateScreenTexture: resourceID = IDR_GENERATE_SCREEN_TEXTURE; break;
+      case CathodeRetro::ShaderID::CRT_GenerateDistortionTexture: resourceID = IDR_GENERATE_DISTORTION_TEXTURE; break;
       case CathodeRetro::ShaderID::CRT_GenerateSlotMask: resourceID = IDR_GENERATE_SLOT_MASK; break;
       case CathodeRetro::ShaderID::CRT_GenerateShadowMask: resourceID = IDR_GENERATE_SHADOW_MASK; break;
       case CathodeRetro::ShaderID::CRT_GenerateApertureGrille: resourceID = IDR_GENERATE_APERTURE_GRILLE; break;
@@ -382,6 +486,16 @@ public:
       vp.MaxDepth = 1.0f;
 
       context->RSSetViewports(1, &vp);
+
+      // Only the output's region needs rendering, so scissor everything else out (the rasterizer state has scissoring
+      //  enabled, and the default region covers the whole viewport).
+      D3D11_RECT scissor;
+      scissor.left = LONG(std::min(output.region.left, viewportWidth));
+      scissor.top = LONG(std::min(output.region.top, viewportHeight));
+      scissor.right = LONG(std::min(output.region.right, viewportWidth));
+      scissor.bottom = LONG(std::min(output.region.bottom, viewportHeight));
+
+      context->RSSetScissorRects(1, &scissor);
     }
 
     context->PSSetShader(pixelShadersByID[uint32_t(shader)], nullptr, 0);
@@ -424,6 +538,67 @@ public:
   }
 
 
+  bool ReadTexels(const CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, void *texelsOut) override
+  {
+    assert(!isRendering);
+    auto d3dTexture = static_cast<const D3DTexture *>(texture);
+    uint32_t mipWidth = std::max(1U, d3dTexture->width >> mipLevel);
+    uint32_t mipHeight = std::max(1U, d3dTexture->height >> mipLevel);
+
+    // Copy the mip into a (CPU-readable) staging texture the size of the mip and read it out of that. This stalls
+    //  until the GPU catches up, but it's only done when saving a newly-generated texture.
+    D3D11_TEXTURE2D_DESC desc;
+    d3dTexture->texture->GetDesc(&desc);
+    desc.Width = mipWidth;
+    desc.Height = mipHeight;
+    desc.MipLevels = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    ComPtr<ID3D11Texture2D> staging;
+    if (FAILED(device->CreateTexture2D(&desc, nullptr, staging.AddressForReplace())))
+    {
+      return false;
+    }
+
+    context->CopySubresourceRegion(staging, 0, 0, 0, 0, d3dTexture->texture, mipLevel, nullptr);
+
+    D3D11_MAPPED_SUBRESOURCE map;
+    if (FAILED(context->Map(staging, 0, D3D11_MAP_READ, 0, &map)))
+    {
+      return false;
+    }
+
+    size_t destRowPitch = size_t(mipWidth) * d3dTexture->texelByteCount;
+    auto src = static_cast<const uint8_t *>(map.pData);
+    auto dest = static_cast<uint8_t *>(texelsOut);
+    for (uint32_t y = 0; y < mipHeight; y++)
+    {
+      memcpy(dest + y * destRowPitch, src + y * map.RowPitch, destRowPitch);
+    }
+
+    context->Unmap(staging, 0);
+    return true;
+  }
+
+
+  bool WriteTexels(CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, const void *texels) override
+  {
+    assert(!isRendering);
+    auto d3dTexture = static_cast<D3DTexture *>(texture);
+    uint32_t mipWidth = std::max(1U, d3dTexture->width >> mipLevel);
+    context->UpdateSubresource(
+      d3dTexture->texture,
+      mipLevel,
+      nullptr,
+      texels,
+      UINT(size_t(mipWidth) * d3dTexture->texelByteCount),
+      0);
+    return true;
+  }
+
+
 private:
   struct Vertex
   {
@@ -464,6 +639,26 @@ private:
       dxgiFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
       texelByteCount = 4 * sizeof(float);
       break;
+
+    case CathodeRetro::TextureFormat::R_Float16:
+      dxgiFormat = DXGI_FORMAT_R16_FLOAT;
+      texelByteCount = 1 * sizeof(uint16_t);
+      break;
+
+    case CathodeRetro::TextureFormat::RG_Float16:
+      dxgiFormat = DXGI_FORMAT_R16G16_FLOAT;
+      texelByteCount = 2 * sizeof(uint16_t);
+      break;
+
+    case CathodeRetro::TextureFormat::RGBA_Float16:
+      dxgiFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+      texelByteCount = 4 * sizeof(uint16_t);
+      break;
+
+    case CathodeRetro::TextureFormat::R_Unorm8:
+      dxgiFormat = DXGI_FORMAT_R8_UNORM;
+      texelByteCount = 1 * sizeof(uint8_t);
+      break;
     }
 
     {
@@ -495,6 +690,7 @@ private:
       tex->width = width;
       tex->height = height;
       tex->format = format;
+      tex->texelByteCount = texelByteCount;
 
       CHECK_HRESULT(
         device->CreateTexture2D(&desc, initialData, tex->texture.AddressForReplace()),
@@ -691,6 +887,7 @@ private:
       D3D11_RASTERIZER_DESC desc = {};
       desc.FillMode = D3D11_FILL_SOLID;
       desc.CullMode = D3D11_CULL_NONE;
+      desc.ScissorEnable = TRUE;
       CHECK_HRESULT(
         device->CreateRasterizerState(&desc, rasterizerState.AddressForReplace()),
         "create rasterizer state");
@@ -725,7 +922,7 @@ private:
   uint32_t prevSamplerCount = 0;
   bool isRendering = false;
 
-  ComPtr<ID3D11PixelShader> pixelShadersByID[16]; // This size needs to match the number of entries in ShaderID
+  ComPtr<ID3D11PixelShader> pixelShadersByID[21]; // This size needs to match the number of entries in ShaderID
 };
 
 
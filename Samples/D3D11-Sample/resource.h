@@ -21,12 +21,17 @@
 #define IDR_TONEMAP_AND_DOWNSAMPLE      115
 #define IDR_SVIDEO_TO_MODULATED_CHROMA  116
 #define IDR_COPY                        117
+#define IDR_GENERATE_DISTORTION_TEXTURE 118
+#define IDR_INDEXED_TO_SVIDEO_OR_COMPOSITE 119
+#define IDR_GENERATE_PALETTE_SIGNAL_TABLE 120
+#define IDR_SVIDEO_TO_DECIMATED_IQ      121
+#define IDR_SVIDEO_AND_DECIMATED_IQ_TO_RGB 122
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        118
+#define _APS_NEXT_RESOURCE_VALUE        123
 #define _APS_NEXT_COMMAND_VALUE         40005
 #define _APS_NEXT_CONTROL_VALUE         1054
 #define _APS_NEXT_SYMED_VALUE           101
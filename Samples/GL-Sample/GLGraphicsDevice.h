@@ -61,10 +61,11 @@ private:
 class GLShader
 {
 public:
-  // Build a GLShader given a vertex shader handle and a path to the pixel shader.
-  GLShader(GLuint vsHandle, const char *path)
+  // Build a GLShader given a vertex shader handle and a path to the pixel shader (and, optionally, extra "#define"
+  //  lines to compile the pixel shader with).
+  GLShader(GLuint vsHandle, const char *path, const char *defines = nullptr)
   {
-    GLuint fsHandle = CompileShaderFromFile(GL_FRAGMENT_SHADER, path);
+    GLuint fsHandle = CompileShaderFromFile(GL_FRAGMENT_SHADER, path, defines);
     shaderProgramHandle = LinkShaderProgram(vsHandle, fsHandle, path);
     glDeleteShader(fsHandle);
     CheckGLError();
@@ -112,34 +113,63 @@ public:
     CheckGLError();
 
     GLint internalFormat = 0;
-    GLenum glformat = 0;
-    GLenum type = 0;
     switch (format)
     {
     case CathodeRetro::TextureFormat::RGBA_Unorm8:
       internalFormat = GL_RGBA8;
-      glformat = GL_RGBA;
-      type = GL_UNSIGNED_BYTE;
+      glFormat = GL_RGBA;
+      glType = GL_UNSIGNED_BYTE;
+      texelByteCount = 4;
       break;
     case CathodeRetro::TextureFormat::RGBA_Float32:
       internalFormat = GL_RGBA32F;
-      glformat = GL_RGBA;
-      type = GL_FLOAT;
+      glFormat = GL_RGBA;
+      glType = GL_FLOAT;
+      texelByteCount = 16;
       break;
     case CathodeRetro::TextureFormat::R_Float32:
       internalFormat = GL_R32F;
-      glformat = GL_RED;
-      type = GL_FLOAT;
+      glFormat = GL_RED;
+      glType = GL_FLOAT;
+      texelByteCount = 4;
       break;
     case CathodeRetro::TextureFormat::RG_Float32:
       internalFormat = GL_RG32F;
-      glformat = GL_RG;
-      type = GL_FLOAT;
+      glFormat = GL_RG;
+      glType = GL_FLOAT;
+      texelByteCount = 8;
+      break;
+    case CathodeRetro::TextureFormat::RGBA_Float16:
+      internalFormat = GL_RGBA16F;
+      glFormat = GL_RGBA;
+      glType = GL_HALF_FLOAT;
+      texelByteCount = 8;
+      break;
+    case CathodeRetro::TextureFormat::R_Float16:
+      internalFormat = GL_R16F;
+      glFormat = GL_RED;
+      glType = GL_HALF_FLOAT;
+      texelByteCount = 2;
+      break;
+    case CathodeRetro::TextureFormat::RG_Float16:
+      internalFormat = GL_RG16F;
+      glFormat = GL_RG;
+      glType = GL_HALF_FLOAT;
+      texelByteCount = 4;
+      break;
+    case CathodeRetro::TextureFormat::R_Unorm8:
+      internalFormat = GL_R8;
+      glFormat = GL_RED;
+      glType = GL_UNSIGNED_BYTE;
+      texelByteCount = 1;
       break;
     }
 
-    // Initialize the image to the correct size (with the correct initial contents)
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, glformat, type, optionalInitialDataTexels);
+    // Initialize the image to the correct size (with the correct initial contents). The initial texels are tightly
+    //  packed, which (for single-byte texels) isn't necessarily 4-byte aligned.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, glFormat, glType, optionalInitialDataTexels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
     if (mipCount != 1)
     {
@@ -186,6 +216,11 @@ public:
       glDeleteFramebuffers(GLsizei(fboHandles.size()), fboHandles.data());
     }
 
+    if (!pboHandles.empty())
+    {
+      glDeleteBuffers(GLsizei(pboHandles.size()), pboHandles.data());
+    }
+
     glDeleteTextures(1, &texHandle);
   }
 
@@ -223,7 +258,104 @@ public:
     return texHandle;
   }
 
+
+  // Give this texture a ring of pixel buffer objects to stream new contents through (see
+  //  GLGraphicsDevice::CreateStreamingTexture).
+  void CreateUploadBuffers(uint32_t count)
+  {
+    assert(pboHandles.empty());
+    pboHandles.resize(count);
+    glGenBuffers(GLsizei(count), pboHandles.data());
+    for (GLuint pbo : pboHandles)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(UploadByteCount()), nullptr, GL_STREAM_DRAW);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    CheckGLError();
+  }
+
+
+  // Map the next pixel buffer in the ring for writing. Invalidating the buffer means that if the GPU is somehow still
+  //  reading from it, the driver can hand us fresh memory rather than waiting.
+  void *MapUploadBuffer()
+  {
+    assert(!pboHandles.empty());
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboHandles[nextPBOIndex]);
+    void *data = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER,
+      0,
+      GLsizeiptr(UploadByteCount()),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    CheckGLError();
+    return data;
+  }
+
+
+  // Unmap the current pixel buffer and kick off the (asynchronous) copy from it into the texture.
+  void UnmapUploadBuffer()
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pboHandles[nextPBOIndex]);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    Upload(nullptr); // With a pixel unpack buffer bound, this is an offset into the buffer.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    CheckGLError();
+
+    nextPBOIndex = (nextPBOIndex + 1) % uint32_t(pboHandles.size());
+  }
+
+
+  // Replace the contents of the given mip level with the given tightly-packed texels.
+  void Upload(const void *texels, uint32_t mipLevel = 0)
+  {
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(
+      GL_TEXTURE_2D,
+      GLint(mipLevel),
+      0,
+      0,
+      std::max(1U, width >> mipLevel),
+      std::max(1U, height >> mipLevel),
+      glFormat,
+      glType,
+      texels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    CheckGLError();
+  }
+
+
+  // Read the contents of the given mip level out as tightly-packed texels.
+  void Download(void *texelsOut, uint32_t mipLevel) const
+  {
+    glBindTexture(GL_TEXTURE_2D, texHandle);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, GLint(mipLevel), glFormat, glType, texelsOut);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    CheckGLError();
+  }
+
+
+  bool IsStreaming() const
+  {
+    return !pboHandles.empty();
+  }
+
+
+  size_t UploadRowPitch() const
+  {
+    return size_t(width) * texelByteCount;
+  }
+
 private:
+  size_t UploadByteCount() const
+  {
+    return UploadRowPitch() * height;
+  }
+
+
   GLTexture(uint32_t w, uint32_t h)
     : width(w)
     , height(h)
@@ -239,7 +371,12 @@ private:
   uint32_t mipCount = 0;
   GLuint texHandle = 0;
   CathodeRetro::TextureFormat format = CathodeRetro::TextureFormat::RGBA_Unorm8;
+  GLenum glFormat = 0;
+  GLenum glType = 0;
+  uint32_t texelByteCount = 0;
   std::vector<GLuint> fboHandles;
+  std::vector<GLuint> pboHandles;
+  uint32_t nextPBOIndex = 0;
 };
 
 
@@ -301,6 +438,61 @@ public:
   }
 
 
+  // Create a texture whose contents get replaced regularly (for instance, with each frame of a video). New contents
+  //  are written into the next one of a ring of stagingBufferCount pixel buffer objects, and the copy from there into
+  //  the texture happens on the GPU's timeline, so writing a new frame doesn't have to wait for the GPU to be done
+  //  with the previous ones and nothing gets reallocated after this.
+  //
+  // Plain GL has no way to have a texture read straight out of caller-owned memory, so UpdateTexture (which does a
+  //  single copy into the mapped buffer) is as close to zero-copy as this gets. Writing directly into the mapped
+  //  buffer (via MapTexture) avoids the copy entirely, if the texel data can be generated in place.
+  std::unique_ptr<CathodeRetro::ITexture> CreateStreamingTexture(
+    uint32_t width,
+    uint32_t height,
+    CathodeRetro::TextureFormat format,
+    uint32_t stagingBufferCount = 3)
+  {
+    assert(stagingBufferCount > 0);
+    auto texture = std::make_unique<GLTexture>(width, height, 1, format, false, nullptr);
+    texture->CreateUploadBuffers(stagingBufferCount);
+    return texture;
+  }
+
+
+  // Get a pointer to write new contents for a streaming texture into (rows are *rowPitchOut bytes apart). The new
+  //  contents get copied into the texture when UnmapTexture is called.
+  void *MapTexture(CathodeRetro::ITexture *texture, size_t *rowPitchOut)
+  {
+    auto glTexture = static_cast<GLTexture *>(texture);
+    *rowPitchOut = glTexture->UploadRowPitch();
+    return glTexture->MapUploadBuffer();
+  }
+
+
+  void UnmapTexture(CathodeRetro::ITexture *texture)
+  {
+    static_cast<GLTexture *>(texture)->UnmapUploadBuffer();
+  }
+
+
+  // Replace the contents of a texture with the given (tightly packed) texels. Streaming textures go through their
+  //  pixel buffer ring, anything else gets a plain glTexSubImage2D.
+  void UpdateTexture(CathodeRetro::ITexture *texture, const void *texels)
+  {
+    auto glTexture = static_cast<GLTexture *>(texture);
+    if (!glTexture->IsStreaming())
+    {
+      glTexture->Upload(texels);
+      return;
+    }
+
+    size_t rowPitch;
+    void *dest = MapTexture(texture, &rowPitch);
+    memcpy(dest, texels, rowPitch * glTexture->Height());
+    UnmapTexture(texture);
+  }
+
+
   // CathodeRetro::IGraphicsDevice implementations ////////////////////////////////////////////////////////////////////
 
 
@@ -322,8 +514,10 @@ public:
 
   void BeginRendering() override
   {
-    // All of our quads use the same vertex array.
+    // All of our quads use the same vertex array, and each only renders the region of its output (see
+    //  RenderQuadWithShader).
     glBindVertexArray(vertexArrayObject);
+    glEnable(GL_SCISSOR_TEST);
     CheckGLError();
   }
 
@@ -333,17 +527,99 @@ public:
     CathodeRetro::RenderTargetView output,
     std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
     CathodeRetro::IConstantBuffer *constantBuffer) override
+  {
+    RenderQuadWithShader(shadersByID[uint32_t(id)].get(), output, inputs, constantBuffer);
+  }
+
+
+  bool SupportsShaderPermutations() const override
+    { return true; }
+
+
+  void RenderQuadPermutation(
+    CathodeRetro::ShaderID id,
+    uint32_t permutation,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer) override
+  {
+    if (id != CathodeRetro::ShaderID::CRT_RGBToCRT || permutation == CathodeRetro::k_rgbToCRTAllFeatures)
+    {
+      RenderQuad(id, output, inputs, constantBuffer);
+      return;
+    }
+
+    // The permutations get compiled the first time that they're used (since most of them never will be).
+    assert(permutation < CathodeRetro::k_rgbToCRTPermutationCount);
+    auto &shader = rgbToCRTPermutations[permutation];
+    if (shader == nullptr)
+    {
+      shader = CreateShader(id, permutation);
+    }
+
+    RenderQuadWithShader(shader.get(), output, inputs, constantBuffer);
+  }
+
+
+  void EndRendering() override
+  {
+    // Set our framebuffer back to the render target.
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDisable(GL_SCISSOR_TEST);
+    CheckGLError();
+  }
+
+
+  bool ReadTexels(const CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, void *texelsOut) override
+  {
+    auto glTexture = static_cast<const GLTexture *>(texture);
+    if (glTexture->TexHandle() == 0)
+    {
+      // The backbuffer isn't a texture that we can read from.
+      return false;
+    }
+
+    glTexture->Download(texelsOut, mipLevel);
+    return true;
+  }
+
+
+  bool WriteTexels(CathodeRetro::IRenderTarget *texture, uint32_t mipLevel, const void *texels) override
+  {
+    auto glTexture = static_cast<GLTexture *>(texture);
+    if (glTexture->TexHandle() == 0)
+    {
+      return false;
+    }
+
+    glTexture->Upload(texels, mipLevel);
+    return true;
+  }
+
+
+private:
+  void RenderQuadWithShader(
+    const GLShader *shader,
+    CathodeRetro::RenderTargetView output,
+    std::initializer_list<CathodeRetro::ShaderResourceView> inputs,
+    CathodeRetro::IConstantBuffer *constantBuffer)
   {
     // Start rendering to the correct mip level of the given texture and set up the viewport properly.
     glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLTexture *>(output.texture)->FBOHandle(output.mipLevel));
-    glViewport(
-      0,
-      0,
-      std::max(output.texture->Width() >> output.mipLevel, 1U),
-      std::max(output.texture->Height() >> output.mipLevel, 1U));
+    uint32_t viewportWidth = std::max(output.texture->Width() >> output.mipLevel, 1U);
+    uint32_t viewportHeight = std::max(output.texture->Height() >> output.mipLevel, 1U);
+    glViewport(0, 0, viewportWidth, viewportHeight);
+
+    // Scissor out everything but the output's region. The region's rows count down from the top of the texture as the
+    //  shaders see it, which (with the basic vertex shader's flip) is the last row of the GL texture.
+    uint32_t left = std::min(output.region.left, viewportWidth);
+    uint32_t top = std::min(output.region.top, viewportHeight);
+    uint32_t right = std::max(left, std::min(output.region.right, viewportWidth));
+    uint32_t bottom = std::max(top, std::min(output.region.bottom, viewportHeight));
+    glScissor(GLint(left), GLint(viewportHeight - bottom), GLsizei(right - left), GLsizei(bottom - top));
 
     // Bind our shaders
-    auto programHandle = shadersByID[uint32_t(id)]->ShaderProgramHandle();
+    auto programHandle = shader->ShaderProgramHandle();
     glUseProgram(programHandle);
 
     // Set up our constants if we have any
@@ -427,16 +703,9 @@ public:
   }
 
 
-  void EndRendering() override
-  {
-    // Set our framebuffer back to the render target.
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    CheckGLError();
-  }
-
-
-private:
-  std::unique_ptr<GLShader> CreateShader(CathodeRetro::ShaderID id)
+  std::unique_ptr<GLShader> CreateShader(
+    CathodeRetro::ShaderID id,
+    uint32_t permutation = CathodeRetro::k_rgbToCRTAllFeatures)
   {
     struct SShaderStuff
     {
@@ -485,12 +754,64 @@ private:
           "g_previousFrameTexture",
           "g_screenMaskTexture",
           "g_diffusionTexture",
+          "g_distortionTexture",
         }
       },
+
+      { .path = "Content/cathode-retro-crt-generate-distortion-texture.hlsl", .textureNames = {} },
+
+      {
+        .path = "Content/cathode-retro-generator-indexed-to-svideo-or-composite.hlsl",
+        .textureNames = { "g_sourceTexture", "g_scanlinePhases", "g_paletteSignalTable" }
+      },
+      { .path = "Content/cathode-retro-generator-gen-palette-signal-table.hlsl", .textureNames = {} },
+
+      {
+        .path = "Content/cathode-retro-decoder-svideo-to-decimated-iq.hlsl",
+        .textureNames = { "g_sourceTexture", "g_scanlinePhases"}
+      },
+      {
+        .path = "Content/cathode-retro-decoder-svideo-and-decimated-iq-to-rgb.hlsl",
+        .textureNames = { "g_sourceTexture", "g_decimatedIQTexture"}
+      },
     };
 
+    // Any features that aren't in the permutation get compiled out (see cathode-retro-crt-rgb-to-crt.hlsl).
+    std::string defines;
+    if (id == CathodeRetro::ShaderID::CRT_RGBToCRT)
+    {
+      struct SFeatureDefine
+      {
+        CathodeRetro::RGBToCRTFeature feature;
+        const char *define;
+      };
+
+      constexpr SFeatureDefine k_featureDefines[]
+      {
+        { CathodeRetro::RGBToCRTFeature::Distortion, "#define CRT_NO_DISTORTION\n" },
+        { CathodeRetro::RGBToCRTFeature::PhosphorPersistence, "#define CRT_NO_PHOSPHOR_PERSISTENCE\n" },
+        { CathodeRetro::RGBToCRTFeature::Diffusion, "#define CRT_NO_DIFFUSION\n" },
+        { CathodeRetro::RGBToCRTFeature::Mask, "#define CRT_NO_MASK\n" },
+        { CathodeRetro::RGBToCRTFeature::Scanlines, "#define CRT_NO_SCANLINES\n" },
+      };
+
+      for (auto &featureDefine : k_featureDefines)
+      {
+        if ((permutation & uint32_t(featureDefine.feature)) == 0)
+        {
+          defines += featureDefine.define;
+        }
+      }
+
+      // ...except for this one, which is compiled in when it IS in the permutation.
+      if ((permutation & uint32_t(CathodeRetro::RGBToCRTFeature::DistortionTexture)) != 0)
+      {
+        defines += "#define CRT_DISTORTION_TEXTURE\n";
+      }
+    }
+
     auto &info = k_shaderInfo[size_t(id)];
-    auto l = std::make_unique<GLShader>(vertexShaderHandle, info.path);
+    auto l = std::make_unique<GLShader>(vertexShaderHandle, info.path, defines.c_str());
 
     glUseProgram(l->ShaderProgramHandle());
     for (uint32_t i = 0; info.textureNames[i] != nullptr; i++)
@@ -511,5 +832,6 @@ private:
   GLuint vertexBufferObject = 0;
   GLuint vertexArrayObject = 0;
   GLuint vertexShaderHandle = 0;
-  std::unique_ptr<GLShader> shadersByID[16]; // This size needs to match the number of entries in ShaderID
+  std::unique_ptr<GLShader> shadersByID[21]; // This size needs to match the number of entries in ShaderID
+  std::unique_ptr<GLShader> rgbToCRTPermutations[CathodeRetro::k_rgbToCRTPermutationCount];
 };
\ No newline at end of file
@@ -42,11 +42,16 @@
 #endif
 
 
+#define GL_MAP_WRITE_BIT                  0x0002
+#define GL_MAP_INVALIDATE_BUFFER_BIT      0x0008
 #define GL_INVALID_FRAMEBUFFER_OPERATION  0x0506
+#define GL_HALF_FLOAT                     0x140B
 #define GL_TEXTURE_BASE_LEVEL             0x813C
 #define GL_TEXTURE_MAX_LEVEL              0x813D
 #define GL_RG                             0x8227
+#define GL_R16F                           0x822D
 #define GL_R32F                           0x822E
+#define GL_RG16F                          0x822F
 #define GL_RG32F                          0x8230
 #define GL_TEXTURE0                       0x84C0
 #define GL_TEXTURE1                       0x84C1
@@ -81,9 +86,12 @@
 #define GL_TEXTURE30                      0x84DE
 #define GL_TEXTURE31                      0x84DF
 #define GL_RGBA32F                        0x8814
+#define GL_RGBA16F                        0x881A
 #define GL_ARRAY_BUFFER                   0x8892
+#define GL_STREAM_DRAW                    0x88E0
 #define GL_STATIC_DRAW                    0x88E4
 #define GL_DYNAMIC_DRAW                   0x88E8
+#define GL_PIXEL_UNPACK_BUFFER            0x88EC
 #define GL_UNIFORM_BUFFER                 0x8A11
 #define GL_FRAGMENT_SHADER                0x8B30
 #define GL_VERTEX_SHADER                  0x8B31
@@ -100,6 +108,7 @@
 #define GL_FRAMEBUFFER                    0x8D40
 
 using GLsizeiptr = std::make_signed_t<size_t>;
+using GLintptr = std::make_signed_t<size_t>;
 using GLchar = char;
 
 #if TARGET_WINDOWS
@@ -110,6 +119,8 @@ void (*glGenBuffers) (GLsizei n, GLuint *arraysOut) = nullptr;
 void (*glBindBuffer) (GLenum target, GLuint buffer) = nullptr;
 void (*glBufferData) (GLenum target, GLsizeiptr size, const void *data, GLenum usage) = nullptr;
 void (*glDeleteBuffers) (GLsizei n, const GLuint * buffers);
+void *(*glMapBufferRange) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = nullptr;
+GLboolean (*glUnmapBuffer) (GLenum target) = nullptr;
 GLuint (*glCreateShader) (GLenum shaderType) = nullptr;
 void (*glShaderSource) (GLuint shader, GLsizei count, const GLchar **string, const GLint *length) = nullptr;
 void (*glCompileShader) (GLuint shader) = nullptr;
@@ -195,6 +206,8 @@ inline void InitializeGLHelpers()
     LOAD_GL_FUNCTION(glBindBuffer);
     LOAD_GL_FUNCTION(glBufferData);
     LOAD_GL_FUNCTION(glDeleteBuffers);
+    LOAD_GL_FUNCTION(glMapBufferRange);
+    LOAD_GL_FUNCTION(glUnmapBuffer);
     LOAD_GL_FUNCTION(wglCreateContextAttribsARB);
     LOAD_GL_FUNCTION(glCreateShader);
     LOAD_GL_FUNCTION(glShaderSource);
@@ -389,7 +402,8 @@ std::string GetShaderText(std::filesystem::path path, std::vector<std::filesyste
 
 
 
-GLuint CompileShaderFromFile(GLenum shaderType, const char *pathStr)
+// defines, if given, is a set of extra "#define" lines to compile the shader with.
+GLuint CompileShaderFromFile(GLenum shaderType, const char *pathStr, const char *defines = nullptr)
 {
   std::filesystem::path path = pathStr;
   if (!path.is_absolute())
@@ -404,6 +418,11 @@ GLuint CompileShaderFromFile(GLenum shaderType, const char *pathStr)
   // Get the text of the shader (and an ordered list of all of the paths involved)
   std::vector<std::filesystem::path> knownPaths;
   auto content = GetShaderText(path, knownPaths);
+  if (defines != nullptr)
+  {
+    // These need to go after the #version line (which has to come first)
+    content.insert(content.find('\n') + 1, defines);
+  }
 
   // Create and compile!
   GLuint shaderHandle = glCreateShader(shaderType);
@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This shader generates the Distortion Texture, which holds (for every pixel of the output) the distorted texture
+//  coordinate that the RGBToCRT shader samples the current frame at, along with that coordinate's derivative along y
+//  (which the RGBToCRT shader needs for its scanlines). These only depend on the screen settings and the output size,
+//  so rather than doing the distortion math for every pixel of every frame, RGBToCRT can be compiled with
+//  CRT_DISTORTION_TEXTURE to read them out of this texture instead.
+// This should be rendered into a 4-component 32-bit float texture with the same dimensions as the output, and sampled
+//  with nearest-neighbor filtering.
+
+
+#include "cathode-retro-util-language-helpers.hlsli"
+#include "cathode-retro-crt-distort-coordinates.hlsli"
+
+
+CBUFFER consts
+{
+  // $NOTE: These values are the same as the first four in RGBToCRT.hlsl, and are expected to match. See that shader
+  //  for details on each of them.
+  float2 g_viewScale;
+  float2 g_overscanScale;
+  float2 g_overscanOffset;
+  float2 g_distortion;
+};
+
+
+float4 Main(float2 inTexCoord)
+{
+  // This is exactly how the RGBToCRT shader calculates its texture coordinate (before the even/odd adjustment).
+  float2 t = DistortCRTCoordinates((inTexCoord * 2 - 1) * g_viewScale, g_distortion) * g_overscanScale
+    + g_overscanOffset * 2.0;
+
+  return float4(t, ddy(t));
+}
+
+
+PS_MAIN
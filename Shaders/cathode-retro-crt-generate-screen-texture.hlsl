@@ -146,7 +146,9 @@ float4 Main(float2 inTexCoord)
   // First thing we want to do is scale our input texture coordinate to be in [-1..1] instead of [0..1] and adjust for
   float2 scaledTexCoord = (inTexCoord * 2 - 1) * g_viewScale;
 
-  // Distort these coordinates to get the -1..1 screen area:
+  // Distort these coordinates to get the -1..1 screen area. (This doesn't read these out of the distortion texture,
+  //  even when there is one: this shader also needs ddx(t) and the mask coordinates below, neither of which that
+  //  texture holds, and it only runs when the settings change anyway.)
   float2 t = DistortCRTCoordinates(scaledTexCoord, g_distortion);
 
   // Calculate a separate set of distorted coordinates, this for the outer mask (which determines the masking off of
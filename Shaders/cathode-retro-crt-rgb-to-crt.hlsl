@@ -1,11 +1,16 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // This shader combines the current frame, the previous frame, screen mask, and diffusion into the final render.
-//  It's a relatively complex shader, and certainly if there are features that aren't needed for the current render it
-//  could be simplified.
-
-// $TODO: May want to do something like an ubershader version that does exactly the minimum amount of work based on how
-//  many features are actually in use (pulling out the distortion or, more importantly, the sampling of the previous/
-//  diffusion textures when they're unneeded).
+//  It's a relatively complex shader, so any feature that isn't needed for the current render can be compiled out of it
+//  by defining the matching value below (leaving out a feature that's set to 0 doesn't change the output, it only
+//  skips the work, including the sampling of the previous frame/diffusion textures). Each combination of these is a
+//  permutation of the shader that Cathode Retro can ask for (see RGBToCRTFeature in GraphicsDevice.h):
+//    CRT_NO_DISTORTION: g_distortion is (0, 0)
+//    CRT_NO_PHOSPHOR_PERSISTENCE: g_phosphorPersistence is 0
+//    CRT_NO_DIFFUSION: g_diffusionStrength is 0
+//    CRT_NO_MASK: g_maskStrength is 0
+//    CRT_NO_SCANLINES: g_scanlineStrength is 0
+//  Separately, defining CRT_DISTORTION_TEXTURE reads the distorted texture coordinates (and their derivatives) out of
+//  g_distortionTexture instead of calculating them.
 
 
 #include "cathode-retro-util-language-helpers.hlsli"
@@ -31,6 +36,12 @@ DECLARE_TEXTURE2D(g_screenMaskTexture, g_screenMaskSampler);
 // This sampler should be set up with linear texture sampling and should be set to clamp (no wrapping).
 DECLARE_TEXTURE2D(g_diffusionTexture, g_diffusionSampler);
 
+// This texture is the output of the GenerateDistortionTexture shader, containing the distorted texture coordinate in
+//  the rg channels and its derivative along y in the ba channels. It is only used if CRT_DISTORTION_TEXTURE is defined,
+//  and like g_screenMaskTexture, it is 1:1 pixels with our output render target.
+// This sampler should be set up with nearest-neighbor texture sampling and should be set to clamp (no wrapping).
+DECLARE_TEXTURE2D(g_distortionTexture, g_distortionSampler);
+
 
 CBUFFER consts
 {
@@ -120,23 +131,38 @@ float4 Main(float2 inTexCoord)
   float4 screenMask = SAMPLE_TEXTURE(g_screenMaskTexture, g_screenMaskSampler, inTexCoord);
 
   // Now distort the texture coordinates to get our texture into the correct space for display.
+#if defined(CRT_DISTORTION_TEXTURE)
+  float4 distortedCoordinates = SAMPLE_TEXTURE(g_distortionTexture, g_distortionSampler, inTexCoord);
+  float2 t = distortedCoordinates.xy;
+#elif defined(CRT_NO_DISTORTION)
+  float2 t = (inTexCoord * 2 - 1) * g_viewScale * g_overscanScale + g_overscanOffset * 2.0;
+#else
   float2 t = DistortCRTCoordinates((inTexCoord * 2 - 1) * g_viewScale, g_distortion) * g_overscanScale
     + g_overscanOffset * 2.0;
+#endif
 
+#ifndef CRT_NO_DIFFUSION
   // Use "t" (before we do the even/odd update or the scanline-sharpening) to load our diffusion texture, which is an
   //  approximation of the glass in front of the phosphors scattering light a little bit due to imperfections.
   float3 diffusionColor = SAMPLE_TEXTURE(g_diffusionTexture, g_diffusionSampler, t * 0.5 + 0.5).rgb;
+#endif
 
   // Offset based on whether we're an even or odd frame
   t.y += g_curEvenOddTexelOffset / g_scanlineCount;
 
+#ifndef CRT_NO_SCANLINES
   // Before we adjust the y coordinate to sharpen the scanline interpolation, grab our scanline-space y coordinate.
   float scanlineSpaceY = t.y * g_scanlineCount + g_scanlineCount;
 
   // Because t.y is currently in [-1, 1], this derivative multiplied by the scanline count ends up being the number of
   //  total scanlines involved (including the empty ones). So this is "how much along y does one output pixel move us
   //  relative to g_scanlineCount*2"
+#ifdef CRT_DISTORTION_TEXTURE
+  float pixelLengthInScanlineSpace = length(distortedCoordinates.zw) * g_scanlineCount;
+#else
   float pixelLengthInScanlineSpace = length(ddy(t)) * g_scanlineCount;
+#endif
+#endif
 
   // Do a little magic to sharpen up the interpolation between scanlines - a CRT (didn't really have any vertical
   //  smoothing, so we want to make the centers of our texels a little more solid and do less bilinear blending
@@ -160,6 +186,7 @@ float4 Main(float2 inTexCoord)
     t = t * 0.5 + 0.5; // t has been in -1..1 range this whole time, scale it to 0..1 for sampling.
     sourceColor = SAMPLE_TEXTURE(g_currentFrameTexture, g_currentFrameSampler, t).rgb;
 
+#ifndef CRT_NO_SCANLINES
     // Reduce the influence of the scanlines as we get small enough that aliasing is unavoidable (fully fading out at
     //  0.7x nyquist - early to ensure that we don't introduce any aliasing as we get too close).
     float scanlineStrength = lerp(
@@ -194,39 +221,56 @@ float4 Main(float2 inTexCoord)
       // Now multiply in the scanline-spacing darkening according to the scanline strength.
       sourceColor *= lerp(1 - scanlineStrength, 1.0, scanline);
     }
+#endif
 
+#ifndef CRT_NO_PHOSPHOR_PERSISTENCE
     float2 prevT = t;
+#ifndef CRT_NO_SCANLINES
     float prevScanline = scanline;
+#endif
     if (g_prevEvenOddTexelOffset != g_curEvenOddTexelOffset)
     {
       // We have a different scanline parity in the previous frame so we need to offset our texture coordinate (to put
       //  the prev frame's scanline center at the correct spot) and then invert our scanline multiplier (to darken the
       //  alternate scanlines)
       prevT.y += g_prevEvenOddTexelOffset / g_scanlineCount;
+#ifndef CRT_NO_SCANLINES
       prevScanline = 1 - prevScanline;
+#endif
     }
 
     // Sample the previous texture and darken the area between scanlines accordingly.
     float3 prevSourceColor = SAMPLE_TEXTURE(g_previousFrameTexture, g_previousFrameSampler, prevT).rgb;
+#ifndef CRT_NO_SCANLINES
     prevSourceColor *= lerp(1 - scanlineStrength, 1.0, prevScanline);
+#endif
 
     // Blend our previous frame into the current one based on how much phosphor persistence we have between frames.
     sourceColor = max(prevSourceColor * g_phosphorPersistence, sourceColor);
+#endif
 
+#ifndef CRT_NO_SCANLINES
     // We want to adjust the brightness to somewhat compensate for the darkening due to scanlines
     sourceColor /= 1.0 - scanlineStrength * 0.5;
+#endif
   }
 
+  float3 result = sourceColor;
+
+#ifndef CRT_NO_MASK
   // Time to put it all together: first, by applying the screen mask (i.e. the shadow mask/aperture grill, etc)...
   //  $TODO: Figure out a proper scaling factor here - the 3.0 is meant to adjust for the fact that the mask cuts out
   //  approximately 2/3rds of the brightness, but it's not exact, we could calculate this, I just haven't.
   screenMask.rgb = screenMask.rgb * (3.0 - g_maskDepth) + g_maskDepth;
-  float3 result = sourceColor * lerp(float3(1,1,1), screenMask.rgb, g_maskStrength);
+  result *= lerp(float3(1,1,1), screenMask.rgb, g_maskStrength);
+#endif
 
+#ifndef CRT_NO_DIFFUSION
   // ... then bringing in some diffusion on top (This isn't physically accurate (it should really be a lerp between res
   //  and diffusionColor) but doing it this way preserves the brightness and still looks reasonable, especially when
   //  displaying bright things on a dark background)
   result = max(diffusionColor * g_diffusionStrength, result);
+#endif
 
   // Finally, mask out everything outside of the edges to get our final output value.
   return lerp(g_backgroundColor, float4(result, 1), screenMask.a);
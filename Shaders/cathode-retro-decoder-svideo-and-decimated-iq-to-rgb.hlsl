@@ -0,0 +1,121 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This shader is the decimated-chroma version of cathode-retro-decoder-svideo-to-rgb: it takes an input S-Video signal
+//  plus the I and Q chroma channels that cathode-retro-decoder-svideo-to-decimated-iq decoded from it (once per color
+//  cycle), and converts them into an RGB color.
+//
+// Y comes straight from the luma channel of the input, just like the full-resolution decode. IQ, rather than being
+//  box filtered out of the modulated chroma here, is linearly interpolated between the two decimated values on either
+//  side of this texel - the box filter has already taken out everything that would change faster than that.
+//
+// As with the full-resolution decode, if we want temporal artifact reduction, we have two of everything (two phases'
+//  worth of luma and of IQ) and blend them together.
+//
+// The output of this shader is a texture that contains the decoded RGB color (plus 1.0 in alpha).
+
+
+#include "cathode-retro-util-language-helpers.hlsli"
+
+
+// This is a 2- or 4-component texture that contains either a single luma, chroma sample pair or two luma, chroma pairs
+//  of S-Video-like signal. It is 2 components if we have no temporal artifact reduction (we're not blending two
+//  versions of the same frame), 4 if we do. This sampler should be set up for linear filtering and clamped addressing.
+DECLARE_TEXTURE2D(g_sourceTexture, g_sourceSampler);
+
+// This is a 2- or 4-component texture that contains the decoded I and Q values, once per color cycle (see
+//  cathode-retro-decoder-svideo-to-decimated-iq): float4(IA, QA, IB, QB). It is g_iqWidth x (the signal's scanline
+//  count) in size.
+// This sampler should be set up for linear filtering and clamped addressing.
+DECLARE_TEXTURE2D(g_decimatedIQTexture, g_decimatedIQSampler);
+
+
+CBUFFER consts
+{
+  // How many samples (horizontal texels) there are per each color wave cycle.
+  uint g_samplesPerColorburstCycle;
+
+  // This is a value representing how saturated we want the output to be. 0 basically means we'll decode as a grayscale
+  //  image, 1 means fully saturated color (i.e. the intended input saturation), and you could even set values greater
+  //  than 1 to oversaturate.
+  // This corresponds to the saturation dial of a CRT TV.
+  // $NOTE: This value should be pre-scaled by the g_brightness value, so that if brightness is 0, saturation is always
+  //  0 - otherwise, you get weird output values where there should have been nothing visible but instead you get a
+  //  pure color instead.
+  float g_saturation;
+
+  // This is a value representing the brightness of the output. a value of 0 means we'll output pure black, and 1 means
+  //  "the intended brightness based on the input signal". Values above 1 will over-brighten the output.
+  //  This corresponds to the brightness dial of a CRT TV.
+  float g_brightness;
+
+  // This is the luma value of the input signal that represents black. For our synthetic signals it's typically 0.0,
+  //  but from a real NTSC signal this can be some other voltage level, since a voltage of 0 typically indicates a
+  //  horizontal or vertical blank instead. This is calculated from/generated with the composite or S-Video signal we
+  //  were given.
+  float g_blackLevel;
+
+  // This is the luma value of the input signal that represents brightest white.  For our synthetic signals it's
+  //  typically 1.0, but from a real NTSC signal (or if we've applied some signal artifacts like ghosting) it could be
+  //  some other value. This is calculated from/generated with the composite or S-Video signal we were given.
+  float g_whiteLevel;
+
+  // A [0..1] value indicating how much we want to blend in an alternate version of the generated signal to adjust for
+  //  any artifacting between successive frames. 0 means we only have (or want to use) a single input luma/chroma pair.
+  //  A value > 0 means we are going to blend the results of two parallel-computed versions of our YIQ values, with a
+  //  value of 1.0 being a pure average of the two.
+  float g_temporalArtifactReduction;
+
+  // The width of the input signal (including any side padding)
+  uint g_inputWidth;
+
+  // The width of the output RGB image (should be the width of the input signal minus the side padding)
+  uint g_outputWidth;
+
+  // The width of the decimated IQ texture.
+  uint g_iqWidth;
+};
+
+
+float4 Main(float2 inTexCoord)
+{
+  inTexCoord.x = (inTexCoord.x - 0.5) * float(g_outputWidth) / float(g_inputWidth) + 0.5;
+
+  float2 Y = SAMPLE_TEXTURE(g_sourceTexture, g_sourceSampler, inTexCoord).xz;
+
+  // With N being g_samplesPerColorburstCycle, decimated IQ texel x holds the chroma for signal texel x * N + N / 2,
+  //  whose center is at (x + 0.5) * N + 0.5 in signal texels. So position p in the signal (in texels) lines up with
+  //  position (p - 0.5) / N in the decimated texture, and a linear sample there interpolates between the decimated
+  //  values on either side.
+  float iqX = (inTexCoord.x * float(g_inputWidth) - 0.5) / float(g_samplesPerColorburstCycle);
+  float4 IQ = SAMPLE_TEXTURE(
+    g_decimatedIQTexture,
+    g_decimatedIQSampler,
+    float2(iqX / float(g_iqWidth), inTexCoord.y));
+
+  // Adjust our components, first Y to account for the signal's black/white level (and user-chosen brightness), then IQ
+  //  for saturation (Which should also include the signal's brightness scale)
+  Y = (Y - g_blackLevel) / (g_whiteLevel - g_blackLevel) * g_brightness;
+  IQ *= float4(g_saturation, g_saturation, g_saturation, g_saturation);
+
+  // we have 1 or 2 components of Y, and 2 or 4 of IQ. Blend them together based on our temporal aliasing reduction to
+  //  get our final decoded YIQ values.
+  Y.x = lerp(Y.x, Y.y, g_temporalArtifactReduction * 0.5);
+  IQ.xy = lerp(IQ.xy, IQ.zw, g_temporalArtifactReduction * 0.5);
+
+  // Do some gamma adjustments (values effectively based on eyeballing the results of NTSC signals from NES, SNES, and
+  //  Genesis consoles)
+  Y.x = pow(saturate(Y.x), 2.0 / 2.2);
+  float iqSat = saturate(length(IQ.xy));
+  IQ.xy *= pow(iqSat, 2.0 / 2.2) / max(0.00001, iqSat);
+
+  // Finally, run the YIQ values through the standard (SMPTE C) YIQ to RGB conversion matrix
+  //  (from https://en.wikipedia.org/wiki/YIQ)
+  float3 yiq = float3(Y.x, IQ.xy);
+  return float4(
+    dot(yiq, float3(1.0, 0.946882, 0.623557)),
+    dot(yiq, float3(1.0, -0.274788, -0.635691)),
+    dot(yiq, float3(1.0, -1.108545, 1.7090047)),
+    1.0);
+}
+
+
+PS_MAIN
\ No newline at end of file
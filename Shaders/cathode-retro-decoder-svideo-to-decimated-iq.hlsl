@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This shader takes an input S-Video signal and decodes the I and Q chroma channels (of the YIQ color space) from it,
+//  but only once per color cycle rather than for every texel of the signal. It is the decimated-chroma replacement for
+//  cathode-retro-decoder-svideo-to-modulated-chroma plus the chroma half of cathode-retro-decoder-svideo-to-rgb, and
+//  is followed by cathode-retro-decoder-svideo-and-decimated-iq-to-rgb.
+//
+// The chroma decode is a QAM demodulation: multiply the chroma by a reference waveform and its quadrature and then
+//  average over two color cycles to filter out the carrier. That average is a heavy low-pass filter, so the I and Q
+//  values that come out of it barely change from one texel to the next - which means they can be calculated once
+//  every color cycle and linearly interpolated in between with very little difference in the result.
+//
+// Output texel x is exactly what the full-resolution decode would calculate for the signal texel at
+//  x * g_samplesPerColorburstCycle + g_samplesPerColorburstCycle / 2. The output texture is expected to be
+//  (g_inputWidth / g_samplesPerColorburstCycle + 1) x g_scanlineCount, so that the texels on either side of every
+//  signal texel are in it.
+
+
+#include "cathode-retro-util-language-helpers.hlsli"
+
+
+// This is a 2- or 4-component texture that contains either a single luma, chroma sample pair or two luma, chroma pairs
+//  of S-Video-like signal. It is 2 components if we have no temporal artifact reduction (we're not blending two
+//  versions of the same frame), 4 if we do.
+// This sampler should be set up for nearest filtering and clamped addressing (no wrapping).
+DECLARE_TEXTURE2D(g_sourceTexture, g_sourceSampler);
+
+// This is a 1- or 2-component texture that contains the colorburst phase offsets for each scanline. It's 1 component
+//  if we have no temporal artifact reduction, and 2 if we do.
+// Each phase value in this texture is the phase in (fractional) multiples of the colorburst wavelength.
+// This sampler should be set up for nearest filtering and clamped addressing (no wrapping).
+DECLARE_TEXTURE2D(g_scanlinePhases, g_scanlinePhasesSampler);
+
+
+CBUFFER consts
+{
+  // How many samples (horizontal texels) there are per each color wave cycle.
+  uint g_samplesPerColorburstCycle;
+
+  // A value representing the tint offset (in colorburst wavelengths) from baseline that we want to use. Mostly used
+  //  for fun to emulate the tint dial of a CRT TV.
+  float g_tint;
+
+  // The width of the input signal (including any side padding)
+  uint g_inputWidth;
+
+  // The width of the output texture (one texel per color cycle of the input signal, plus one)
+  uint g_outputWidth;
+};
+
+
+CONST float k_pi = 3.141592653;
+
+
+float4 Main(float2 inTexCoord)
+{
+  uint outputXIndex = uint(floor(inTexCoord.x * g_outputWidth));
+  int centerXIndex = int(outputXIndex * g_samplesPerColorburstCycle + g_samplesPerColorburstCycle / 2U);
+
+  // Get the reference phase for our scanline
+  float2 relativePhase = SAMPLE_TEXTURE(g_scanlinePhases, g_scanlinePhasesSampler, inTexCoord.yy).xy + g_tint;
+
+  // Average the modulated chroma over two color cycles centered on centerXIndex, the same as the box filter in the
+  //  full-resolution decode does: a full sample for every texel within a color cycle of the center, and a half sample
+  //  for the texels exactly a color cycle away on either side.
+  int filterRadius = int(g_samplesPerColorburstCycle);
+
+  // Rather than a sincos per sample, start with the carrier at the first sample and rotate it by one sample's worth of
+  //  phase each step.
+  float2 s, c;
+  sincos(2.0 * k_pi * (float(centerXIndex - filterRadius) / g_samplesPerColorburstCycle + relativePhase), s, c);
+
+  float stepS, stepC;
+  sincos(2.0 * k_pi / g_samplesPerColorburstCycle, stepS, stepC);
+
+  float4 IQ = float4(0, 0, 0, 0);
+  for (int i = -filterRadius; i <= filterRadius; i++)
+  {
+    // Off the ends of the scanline this repeats the edge texel (and its carrier phase), the same as sampling the
+    //  full-resolution modulated chroma texture with clamped addressing would.
+    int sampleXIndex = clamp(centerXIndex + i, 0, int(g_inputWidth) - 1);
+    float2 sampleS = s;
+    float2 sampleC = c;
+    if (sampleXIndex != centerXIndex + i)
+    {
+      sincos(2.0 * k_pi * (float(sampleXIndex) / g_samplesPerColorburstCycle + relativePhase), sampleS, sampleC);
+    }
+
+    float4 chroma = SAMPLE_TEXTURE(
+      g_sourceTexture,
+      g_sourceSampler,
+      float2((float(sampleXIndex) + 0.5) / g_inputWidth, inTexCoord.y)).yyww;
+
+    float weight = (i == -filterRadius || i == filterRadius) ? 0.5 : 1.0;
+    IQ += weight * chroma * float4(sampleS, -sampleC).xzyw;
+
+    float2 nextS = s * stepC + c * stepS;
+    c = c * stepC - s * stepS;
+    s = nextS;
+  }
+
+  return IQ / float(2U * g_samplesPerColorburstCycle);
+}
+
+
+PS_MAIN
\ No newline at end of file
@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This shader generates the palette signal table used by cathode-retro-generator-indexed-to-svideo-or-composite: for
+//  every color in the palette (one per row) it has the luma and the modulated chroma of that color at each of a set of
+//  evenly-spaced phases along the color cycle (one per column). The conversion from RGB is the same one that
+//  cathode-retro-generator-rgb-to-svideo-or-composite does, it just happens once per palette change instead of once
+//  per texel per frame.
+
+
+#include "cathode-retro-util-language-helpers.hlsli"
+
+
+CBUFFER consts
+{
+  // The number of phase steps to generate the signal at (the width of the output texture).
+  uint g_phaseStepCount;
+
+  // The number of colors in the palette (the height of the output texture).
+  uint g_paletteColorCount;
+
+  // The palette colors, as RGB (the alpha is ignored). Only the first g_paletteColorCount are used.
+  float4 g_paletteColors[256];
+};
+
+
+CONST float pi = 3.141592653;
+
+
+float4 Main(float2 texCoord)
+{
+  uint2 tableTexelIndex = uint2(floor(texCoord * float2(g_phaseStepCount, g_paletteColorCount)));
+  float3 rgb = g_paletteColors[tableTexelIndex.y].rgb;
+
+  // Convert RGB to YIQ, with the same gamma adjustments, exactly as RGBToSVideoOrComposite does.
+  float3 yiq;
+
+  yiq.r = dot(rgb, float3(0.3000,  0.5900,  0.1100));
+  yiq.g = dot(rgb, float3(0.5990, -0.2773, -0.3217));
+  yiq.b = dot(rgb, float3(0.2130, -0.5251,  0.3121));
+
+  yiq.x = pow(saturate(yiq.x), 2.2 / 2.0);
+  float iqSat = saturate(length(yiq.yz));
+  yiq.yz *= pow(iqSat, 2.2 / 2.0) / max(0.00001, iqSat);
+
+  // Modulate the chroma at this column's phase.
+  float s, c;
+  sincos(2.0 * pi * float(tableTexelIndex.x) / float(g_phaseStepCount), s, c);
+
+  return float4(yiq.x, s * yiq.y - c * yiq.z, 0, 0);
+}
+
+PS_MAIN
\ No newline at end of file
@@ -0,0 +1,139 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// This shader is the palette-indexed version of cathode-retro-generator-rgb-to-svideo-or-composite: it takes an image
+//  of palette indices and turns it into either an S-Video or Composite signal (Based on whether g_compositeBlend is 0
+//  or 1), again possibly as a PAIR of signals with two different sets of phase inputs (if g_scanlinePhases is a
+//  two-component input), for purposes of temporal aliasing reduction.
+//
+// Rather than converting every texel from RGB to YIQ and modulating the chroma, this looks the signal up in a table
+//  that has, for every palette color, the luma and the modulated chroma at each of a set of evenly-spaced phases along
+//  the color cycle. That table only changes when the palette does, so generating the signal is just a table lookup.
+//  Since indices can't be blended, the index texture is point sampled (so there is no blending between neighboring
+//  input pixels the way that there is with RGB input).
+
+
+#include "cathode-retro-util-language-helpers.hlsli"
+#include "cathode-retro-util-tracking-instability.hlsli"
+
+
+// This is the index input texture (a single-channel unorm texture where index i is stored as i/255). It is expected
+//  to be g_inputWidth x g_scanlineCount in size. Indices of g_paletteColorCount or more use the last palette color.
+// This sampler should be set up with nearest filtering, and either clamp or border addressing.
+DECLARE_TEXTURE2D(g_sourceTexture, g_sourceSampler);
+
+// This is the scanline phases texture, generated by GeneratePhaseTexture. It is g_scanlineCount x 1 in size, and each
+//  texel component in it represents the phase offset of the NTSC colorburst for the corresponding scanline, in
+//  multiples of the colorburst wavelength.
+// This sampler should be set up with nearest filtering, and either clamp or border addressing.
+DECLARE_TEXTURE2D(g_scanlinePhases, g_scanlinePhasesSampler);
+
+// This is the palette signal table. It is g_phaseStepCount x g_paletteColorCount in size, and texel (x, y) is the
+//  luma (in the first component) and modulated chroma (in the second) of palette color y at a phase of
+//  x / g_phaseStepCount of the color cycle.
+// This sampler should be set up with linear filtering and wrap addressing (so that a phase between two of the table's
+//  steps, which only happens with picture instability, gets blended between them).
+DECLARE_TEXTURE2D(g_paletteSignalTable, g_paletteSignalTableSampler);
+
+
+CBUFFER consts
+{
+  // The number of texels that the output texture will contain for each color cycle wave (i.e. the wavelength in output
+  //  samples of the color carrier wave).
+  uint g_outputTexelsPerColorburstCycle;
+
+  // The width of the input texture.
+  uint g_inputWidth;
+
+  // The width of the output render target.
+  uint g_outputWidth;
+
+  // The number of scanlines in the current field of video (the height of the input texture).
+  uint g_scanlineCount;
+
+  // This is whether we're blending the generated luma/chroma into a single output channel or not. It is expected to
+  //  be 0 or 1 (no intermediate values), where "0" means "keep luma and chroma separate, like an S-Video signal" and
+  //  "1" means "add the two together, like a composite signal".
+  float g_compositeBlend;
+
+  // The scale of any picture instability (horizontal scanline-by-scanline tracking issues). This is used to offset our
+  //  texture sampling when generating the output so the picture tracking is imperfect.  Must match the similarly-named
+  //  value in GeneratePhaseTexture.
+  float g_instabilityScale;
+
+  // A seed for the noise used to generate the scanline-by-scanline picture instability. Must match the simiarly-named
+  //  value in GeneratePhaseTexture.
+  uint g_noiseSeed;
+
+  // the number of output texels to pad on either side of the signal texture (so that filtering won't have visible
+  //  artifacts on the left and right sides).
+  uint g_sidePaddingTexelCount;
+
+  // The number of colors in the palette (the height of the palette signal table).
+  uint g_paletteColorCount;
+
+  // The number of phase steps in the palette signal table (its width).
+  uint g_phaseStepCount;
+};
+
+
+float4 Main(float2 signalTexCoord)
+{
+  uint2 signalTexelIndex = uint2(floor(signalTexCoord * float2(g_outputWidth, g_scanlineCount)));
+
+  // This is the same input texture coordinate that the RGB version of this shader uses.
+  float2 texCoord =
+    (float2(signalTexelIndex) * float2(float(g_inputWidth) / float(g_outputWidth), 1)
+      + float2(0.25, 0.5))
+    / float2(g_inputWidth, g_scanlineCount);
+
+  uint effectiveOutputWidth = g_outputWidth - g_sidePaddingTexelCount;
+  texCoord.x = (texCoord.x - 0.5) * float(g_outputWidth) / float(effectiveOutputWidth) + 0.5;
+
+  float instability = CalculateTrackingInstabilityOffset(
+    signalTexelIndex.y,
+    g_noiseSeed,
+    g_instabilityScale,
+    g_outputWidth);
+  texCoord.x += instability;
+
+  // Any index past the end of the palette is clamped to its last color (the table's sampler wraps, so otherwise it
+  //  would wrap around to some other color).
+  float index = min(
+    round(SAMPLE_TEXTURE(g_sourceTexture, g_sourceSampler, texCoord).r * 255.0),
+    float(g_paletteColorCount - 1));
+
+  // Calculate the phase for our current x position on the current scanline.
+  float2 scanlinePhase = SAMPLE_TEXTURE(
+    g_scanlinePhases,
+    g_scanlinePhasesSampler,
+    (float2(0.0, signalTexelIndex.y + 0.5) / g_scanlineCount)).xy;
+  float2 phase = frac(scanlinePhase + signalTexelIndex.x / float(g_outputTexelsPerColorburstCycle));
+
+  // The half-texel offset puts a phase that's exactly on one of the table's steps exactly on that texel's center.
+  float tableV = (index + 0.5) / float(g_paletteColorCount);
+  float2 signal0 = SAMPLE_TEXTURE(
+    g_paletteSignalTable,
+    g_paletteSignalTableSampler,
+    float2(phase.x + 0.5 / float(g_phaseStepCount), tableV)).xy;
+  float2 signal1 = SAMPLE_TEXTURE(
+    g_paletteSignalTable,
+    g_paletteSignalTableSampler,
+    float2(phase.y + 0.5 / float(g_phaseStepCount), tableV)).xy;
+
+  float2 luma = float2(signal0.x, signal1.x);
+  float2 chroma = float2(signal0.y, signal1.y);
+
+  if (g_compositeBlend > 0)
+  {
+    // We are outputting a composite signal so combine luma and chroma and output it into our expected 1- or 2-channel
+    //  texture.
+    return (luma + chroma).xyxy;
+  }
+  else
+  {
+    // Outputting svideo, so don't combine luma and chroma, and write them out into our expected 2- or 4-channel
+    //  texture.
+    return float4(luma, chroma).xzyw;
+  }
+}
+
+PS_MAIN
\ No newline at end of file
@@ -42,11 +42,12 @@ const crTypes =
 [
   "CathodeRetro", "Internal", "RGBToCRT", "SignalDecoder", "SignalGenerator", "MaskType", "SamplerType", "ScanlineType", "ShaderID",
   "SignalType", "TextureFormat", "IConstantBuffer", "IGraphicsDevice", "IRenderTarget", "ITexture", "ArtifactSettings", "Color",
-  "SignalLevels", "SignalProperties", "OverscanSettings", "Preset", "RenderTargetView", "ScreenSettings", "ShaderResourceView", "SourceSettings", "TVKnobSettings",
-  "Vec2",
+  "SignalLevels", "SignalProperties", "OverscanSettings", "Preset", "RenderTargetView", "ScreenSettings", "ShaderResourceView", "SourceSettings", "TexelRect",
+  "TVKnobSettings", "Vec2",
 
   "AspectData", "CommonConstants", "ScreenTextureConstants", "RGBToScreenConstants", "GaussianBlurConstants", "ToneMapConstants",
   "CompositeToSVideoConstantData", "SVideoToModulatedChromaConstantData", "SVideoToRGBConstantData", "FilterRGBConstantData",
+  "SVideoToDecimatedIQConstantData", "SVideoAndDecimatedIQToRGBConstantData",
 ];
 
 function SyntaxHighlight(element, keywords)